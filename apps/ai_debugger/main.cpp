@@ -52,7 +52,7 @@ void PrepareScene()
 	// the Recast test scene
 	string materialFile = string( "data/nav_test_materials.xml" );
 	int meshID = renderer->AddMesh( "nav_test.obj", "data/", 1.0f, true );
-	HostScene::meshPool[meshID]->name = "Input Mesh";
+	renderer->GetScene()->meshPool[meshID]->name = "Input Mesh";
 	int instID = renderer->AddInstance( meshID, mat4::Identity() );
 	int instID2 = renderer->AddInstance( meshID, mat4::Translate( 0, 0, 50 ) );
 	int rootNode = renderer->FindNode( "RootNode (gltf orientation matrix)" );
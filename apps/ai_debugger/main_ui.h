@@ -172,7 +172,7 @@ static void PostRenderUpdate( float deltaTime )
 	mraysexcl = coreStats.totalRays / (coreStats.traceTime0 * 1000);
 
 	// saving mesh exclusion bool
-	if (probeMeshID > 0) HostScene::meshPool[probeMeshID]->excludeFromNavmesh = excludeMeshRO;
+	if (probeMeshID > 0) renderer->GetScene()->meshPool[probeMeshID]->excludeFromNavmesh = excludeMeshRO;
 }
 
 //  +-----------------------------------------------------------------------------+
@@ -370,8 +370,8 @@ static bool HandleInput( float frameTime )
 			else if (navMeshShader->isAgent( probeMeshID )) probeType = SELECTION_AGENT;
 			else if (navMeshShader->isVert( probeMeshID )) probeType = SELECTION_VERT;
 			else if (navMeshShader->isEdge( probeMeshID )) probeType = SELECTION_EDGE;
-			meshName = HostScene::meshPool[probeMeshID]->name;
-			excludeMeshRO = HostScene::meshPool[probeMeshID]->excludeFromNavmesh;
+			meshName = renderer->GetScene()->meshPool[probeMeshID]->name;
+			excludeMeshRO = renderer->GetScene()->meshPool[probeMeshID]->excludeFromNavmesh;
 
 			// Get 3D probe position
 			ViewPyramid p = camera->GetView();
@@ -427,7 +427,7 @@ void TW_CALL BuildNavMesh( void *data )
 	ClearNavMesh();
 	ConvertConfigToVoxels();
 	ConvertConfigToWorld();
-	navMeshBuilder->Build();
+	navMeshBuilder->Build( renderer->GetScene() );
 	builderErrorStatus = navMeshBuilder->GetStatus().Failed();
 	if (builderErrorStatus) return;
 	RefreshNavigator();
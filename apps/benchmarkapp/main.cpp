@@ -118,22 +118,28 @@ void PrepareScene()
 	scene->SetSkyDome( sky );
 	// book scene
 	materialFile = string( "data/materials.xml" );
-	renderer->AddScene( "../_shareddata/book/scene.gltf" );
+	renderer->AddSceneAsync( "../_shareddata/book/scene.gltf" );
 	// dragon statue
-	renderer->AddScene( "../_shareddata/statue/scene.gltf", mat4::Translate( -14, -0.5f, 25 ) );
+	renderer->AddSceneAsync( "../_shareddata/statue/scene.gltf", mat4::Translate( -14, -0.5f, 25 ) );
 	// gems
-	renderer->AddScene( "../_shareddata/crystal/scene.gltf", mat4::Translate( 27, -4, 6 ) * mat4::RotateZ( -0.25f ) * mat4::Scale( 0.5f ) );
-	renderer->AddScene( "../_shareddata/crystal/scene.gltf", mat4::Translate( 31.5f, -4.75f, 6 ) * mat4::Scale( 0.5f ) );
+	renderer->AddSceneAsync( "../_shareddata/crystal/scene.gltf", mat4::Translate( 27, -4, 6 ) * mat4::RotateZ( -0.25f ) * mat4::Scale( 0.5f ) );
+	renderer->AddSceneAsync( "../_shareddata/crystal/scene.gltf", mat4::Translate( 31.5f, -4.75f, 6 ) * mat4::Scale( 0.5f ) );
 	// knights
-	renderer->AddScene( "../_shareddata/knight/scene.gltf", mat4::Translate( -16, 0.75f, -10 ) * mat4::RotateY( -1.2f ) );
-	renderer->AddScene( "../_shareddata/knight/scene.gltf", mat4::Translate( -17, 0.75f, -18.5f ) * mat4::RotateY( PI / 2 ) );
-	renderer->AddScene( "../_shareddata/knight/scene.gltf", mat4::Translate( -15, 0.75f, -18.5f ) * mat4::RotateY( PI / 2 ) );
+	renderer->AddSceneAsync( "../_shareddata/knight/scene.gltf", mat4::Translate( -16, 0.75f, -10 ) * mat4::RotateY( -1.2f ) );
+	renderer->AddSceneAsync( "../_shareddata/knight/scene.gltf", mat4::Translate( -17, 0.75f, -18.5f ) * mat4::RotateY( PI / 2 ) );
+	renderer->AddSceneAsync( "../_shareddata/knight/scene.gltf", mat4::Translate( -15, 0.75f, -18.5f ) * mat4::RotateY( PI / 2 ) );
 	// bird
-	birb = renderer->AddScene( "../_shareddata/bird/scene.gltf", mat4::Translate( 0, 14, 0 ) * mat4::Scale( 0.005f ) );
+	const int birbLoad = renderer->AddSceneAsync( "../_shareddata/bird/scene.gltf", mat4::Translate( 0, 14, 0 ) * mat4::Scale( 0.005f ) );
 	// clouds
-	cloud1 = renderer->AddScene( "../_shareddata/cloud1/scene.gltf", mat4::Translate( 0, 34, 0 ) * mat4::Scale( 4.0f ) );
-	cloud2 = renderer->AddScene( "../_shareddata/cloud2/scene.gltf", mat4::Translate( 0, 34, 0 ) * mat4::Scale( 4.0f ) );
-	cloud3 = renderer->AddScene( "../_shareddata/cloud3/scene.gltf", mat4::Translate( 0, 34, 0 ) * mat4::Scale( 4.0f ) );
+	const int cloud1Load = renderer->AddSceneAsync( "../_shareddata/cloud1/scene.gltf", mat4::Translate( 0, 34, 0 ) * mat4::Scale( 4.0f ) );
+	const int cloud2Load = renderer->AddSceneAsync( "../_shareddata/cloud2/scene.gltf", mat4::Translate( 0, 34, 0 ) * mat4::Scale( 4.0f ) );
+	const int cloud3Load = renderer->AddSceneAsync( "../_shareddata/cloud3/scene.gltf", mat4::Translate( 0, 34, 0 ) * mat4::Scale( 4.0f ) );
+	// wait for the loads; these are committed in the order of the requests above
+	renderer->WaitForSceneLoads();
+	birb = renderer->GetSceneLoadResult( birbLoad );
+	cloud1 = renderer->GetSceneLoadResult( cloud1Load );
+	cloud2 = renderer->GetSceneLoadResult( cloud2Load );
+	cloud3 = renderer->GetSceneLoadResult( cloud3Load );
 	// light
 	int whiteMat = renderer->AddMaterial( make_float3( 30 ) );
 	int lightQuad = renderer->AddQuad( normalize( make_float3( -183.9f, -44.6f, -60.9f ) ),
@@ -0,0 +1,104 @@
+/* main.cpp - Copyright 2019/2021 Utrecht University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Accuracy check for the compact triangle layout: random triangles are
+   converted to CoreTriCompact and back with PackTriangle / UnpackTriangle,
+   and the result is compared against the original CoreTri. Returns 0 if
+   all fields are within the documented bounds.
+*/
+
+#include "platform.h"
+#include "rendersystem.h"
+
+static float RandRange( const float lo, const float hi ) { return lo + Rand( hi - lo ); }
+static float3 RandomUnit()
+{
+	const float3 v = make_float3( RandRange( -1, 1 ), RandRange( -1, 1 ), RandRange( -1, 1 ) );
+	return dot( v, v ) > 1e-4f ? normalize( v ) : make_float3( 0, 0, 1 );
+}
+
+// largest error seen per field, and the bound it must stay below
+struct Check
+{
+	const char* name;
+	float bound, worst = 0;
+	void Add( const float error ) { worst = max( worst, error ); }
+	bool Passed() const { printf( "%-24s worst %.3e, bound %.3e%s\n", name, worst, bound, worst <= bound ? "" : "  FAILED" ); return worst <= bound; }
+};
+
+// error of a half float round trip, relative to half an ulp of the original value
+static float HalfError( const float original, const float restored )
+{
+	const float ulp = max( fabsf( original ), 6.103515625e-5f /* smallest normal half */ ) * (1.0f / 1024);
+	return fabsf( original - restored ) / (0.5f * ulp);
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  main                                                                       |
+//  |  Round-trip random triangles and report the worst error per field.    LH2'21|
+//  +-----------------------------------------------------------------------------+
+int main()
+{
+	Check position = { "positions (exact)", 0 };
+	Check shading = { "vertex normals", 7e-5f };
+	Check frame = { "tangent, bitangent", 7e-5f };
+	Check face = { "face normal", 1e-6f };
+	Check uv = { "uvs, alpha (half ulps)", 1 };
+	Check area = { "area (relative)", 1e-5f };
+	Check ints = { "material, light index", 0 };
+	for (int i = 0; i < 1000000; i++)
+	{
+		CoreTri tri;
+		memset( &tri, 0, sizeof( CoreTri ) );
+		const float scale = powf( 10, RandRange( -3, 3 ) );
+		tri.vertex0 = make_float3( RandRange( -1, 1 ), RandRange( -1, 1 ), RandRange( -1, 1 ) ) * scale;
+		tri.vertex1 = tri.vertex0 + RandomUnit() * Rand( scale );
+		tri.vertex2 = tri.vertex0 + RandomUnit() * Rand( scale );
+		const float3 C = cross( tri.vertex1 - tri.vertex0, tri.vertex2 - tri.vertex0 );
+		if (length( C ) < 1e-6f * scale * scale) continue; // degenerate; the face normal is undefined
+		const float3 N = normalize( C ) * (i & 1 ? -1.0f : 1.0f);
+		tri.Nx = N.x, tri.Ny = N.y, tri.Nz = N.z;
+		tri.vN0 = RandomUnit(), tri.vN1 = RandomUnit(), tri.vN2 = RandomUnit();
+		if (i % 7 == 0) tri.vN2 = make_float3( 0 ); // zero normal: use the face normal
+		tri.T = RandomUnit(), tri.B = normalize( cross( tri.T, N ) );
+		tri.u0 = RandRange( -4, 4 ), tri.u1 = RandRange( -4, 4 ), tri.u2 = RandRange( -4, 4 );
+		tri.v0 = RandRange( -4, 4 ), tri.v1 = RandRange( -4, 4 ), tri.v2 = RandRange( -4, 4 );
+		tri.u1_0 = Rand( 1 ), tri.u1_1 = Rand( 1 ), tri.u1_2 = Rand( 1 );
+		tri.v1_0 = Rand( 1 ), tri.v1_1 = Rand( 1 ), tri.v1_2 = Rand( 1 );
+		tri.alpha = make_float3( Rand( 2 ), Rand( 2 ), Rand( 2 ) );
+		tri.material = i & 1023, tri.ltriIdx = (i % 3 == 0) ? i : -1;
+		tri.UpdateArea();
+		// round trip
+		CoreTriCompact packed;
+		CoreTri restored;
+		PackTriangle( tri, packed );
+		UnpackTriangle( packed, restored );
+		position.Add( length( tri.vertex0 - restored.vertex0 ) + length( tri.vertex1 - restored.vertex1 ) + length( tri.vertex2 - restored.vertex2 ) );
+		shading.Add( max( length( tri.vN0 - restored.vN0 ), max( length( tri.vN1 - restored.vN1 ), length( tri.vN2 - restored.vN2 ) ) ) );
+		frame.Add( max( length( tri.T - restored.T ), length( tri.B - restored.B ) ) );
+		face.Add( length( N - make_float3( restored.Nx, restored.Ny, restored.Nz ) ) );
+		const float original[15] = { tri.u0, tri.u1, tri.u2, tri.v0, tri.v1, tri.v2, tri.u1_0, tri.u1_1, tri.u1_2, tri.v1_0, tri.v1_1, tri.v1_2, tri.alpha.x, tri.alpha.y, tri.alpha.z };
+		const float result[15] = { restored.u0, restored.u1, restored.u2, restored.v0, restored.v1, restored.v2, restored.u1_0, restored.u1_1, restored.u1_2,
+			restored.v1_0, restored.v1_1, restored.v1_2, restored.alpha.x, restored.alpha.y, restored.alpha.z };
+		for (int j = 0; j < 15; j++) uv.Add( HalfError( original[j], result[j] ) );
+		area.Add( fabsf( tri.area - restored.area ) / tri.area );
+		ints.Add( (float)((tri.material != restored.material) + (tri.ltriIdx != restored.ltriIdx)) );
+	}
+	bool passed = true;
+	for (const Check* check : { &position, &shading, &frame, &face, &uv, &area, &ints }) passed &= check->Passed();
+	printf( passed ? "all checks passed\n" : "accuracy check failed\n" );
+	return passed ? 0 : 1;
+}
+
+// EOF
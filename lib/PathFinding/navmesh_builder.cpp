@@ -68,27 +68,38 @@ NavMeshBuilder::NavMeshBuilder( const char* dir ) : m_dir( dir )
 //  |  NavMeshBuilder::Build                                                      |
 //  |  Builds a navmesh for the given scene.                                LH2'19|
 //  +-----------------------------------------------------------------------------+
-NavMeshStatus NavMeshBuilder::Build()
+NavMeshStatus NavMeshBuilder::Build( HostScene* scene )
 {
 	m_status = NavMeshStatus::SUCCESS;
-	if (HostScene::rootNodes.empty())
+	if (!scene || scene->rootNodes.empty())
 		RECAST_ERROR( NavMeshStatus::RC | NavMeshStatus::INPUT, "HostScene is nullptr\n" );
 
 	// Extracting triangle soup
-	const std::vector<HostMesh*> meshes = HostScene::meshPool;
+	const std::vector<HostMesh*> meshes = scene->meshPool;
 	std::vector<HostTri> hostTris;
 	std::vector<float3> vertices;
 	std::vector<int3> triangles;
 	int nTri = 0, instancesExcluded = 0;
-	for (const HostNode* node : HostScene::nodePool) if (node && node->meshID >= 0) // for every instance
+	for (const HostNode* node : scene->nodePool) if (node && node->meshID >= 0) // for every instance
 	{
 		if (meshes[node->meshID]->excludeFromNavmesh) // skip if excluded
 		{
 			instancesExcluded++;
 			continue;
 		}
-		hostTris = meshes[node->meshID]->triangles;
+		const HostMesh* mesh = meshes[node->meshID];
 		mat4 transform = node->combinedTransform;
+		if (mesh->hostDataReleased) // static mesh: only the indexed data is kept
+		{
+			for (size_t j = 0; j < mesh->indices.size(); j += 3) // for every triangle
+			{
+				for (int k = 0; k < 3; k++) vertices.push_back( make_float3( transform * mesh->vertexPos[mesh->indices[j + k]] ) );
+				triangles.push_back( int3{ nTri * 3 + 0, nTri * 3 + 1, nTri * 3 + 2 } );
+				nTri++;
+			}
+			continue;
+		}
+		hostTris = mesh->triangles;
 		for (size_t j = 0; j < hostTris.size(); j++) // for every triangle
 		{
 			vertices.push_back( make_float3( transform * make_float4( hostTris[j].vertex0, 1 ) ) );
@@ -35,7 +35,7 @@ public:
 	NavMeshBuilder(const char* dir);
 	~NavMeshBuilder() { Cleanup(); };
 
-	NavMeshStatus Build();
+	NavMeshStatus Build(HostScene* scene);
 	NavMeshStatus Serialize() { return Serialize(m_dir, m_config.m_id.c_str()); };
 	NavMeshStatus Deserialize() { return Deserialize(m_dir, m_config.m_id.c_str()); };
 	void Cleanup();
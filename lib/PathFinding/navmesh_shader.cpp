@@ -260,7 +260,7 @@ void NavMeshShader::RemoveNavMeshFromScene()
 void NavMeshShader::AddPolysToScene()
 {
 	m_polyMeshID = m_renderer->AddMesh(m_meshFileName.c_str(), m_dir, 1.0f);
-	HostScene::meshPool[m_polyMeshID]->name = "NavMesh";
+	m_renderer->GetScene()->meshPool[m_polyMeshID]->name = "NavMesh";
 	m_polyInstID = m_renderer->AddInstance(m_polyMeshID, mat4::Identity());
 }
 
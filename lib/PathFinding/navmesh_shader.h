@@ -61,10 +61,10 @@ public:
 		m_edgeMeshID = m_renderer->AddMesh(NAVMESH_EDGE_MESH_FILE, m_dir, 1.0f);
 		m_arrowMeshID = m_renderer->AddMesh(NAVMESH_ARROW_MESH_FILE, m_dir, 1.0f);
 		m_agentMeshID = m_renderer->AddMesh(NAVMESH_AGENT_MESH_FILE, m_dir, 1.0f);
-		HostScene::meshPool[m_vertMeshID]->name = "navmesh_vertex";
-		HostScene::meshPool[m_edgeMeshID]->name = "navmesh_edge";
-		HostScene::meshPool[m_arrowMeshID]->name = "navmesh_arrowcone";
-		HostScene::meshPool[m_agentMeshID]->name = "navmesh_agent";
+		m_renderer->GetScene()->meshPool[m_vertMeshID]->name = "navmesh_vertex";
+		m_renderer->GetScene()->meshPool[m_edgeMeshID]->name = "navmesh_edge";
+		m_renderer->GetScene()->meshPool[m_arrowMeshID]->name = "navmesh_arrowcone";
+		m_renderer->GetScene()->meshPool[m_agentMeshID]->name = "navmesh_agent";
 	};
 	~NavMeshShader() {};
 
@@ -45,16 +45,48 @@ void RenderCore::SetTarget( GLTexture* target, const uint )
 //  +-----------------------------------------------------------------------------+
 void RenderCore::SetGeometry( const int meshIdx, const float4* vertexData, const int vertexCount, const int triangleCount, const CoreTri* triangleData )
 {
-	Mesh newMesh;
+	Mesh& newMesh = ReplaceMesh( meshIdx );
 	// copy the supplied vertices; we cannot assume that the render system does not modify
 	// the original data after we leave this function.
 	newMesh.vertices = new float4[vertexCount];
 	newMesh.vcount = vertexCount;
 	memcpy( newMesh.vertices, vertexData, vertexCount * sizeof( float4 ) );
-	// copy the supplied 'fat triangles'
-	newMesh.triangles = new CoreTri[vertexCount / 3];
-	memcpy( newMesh.triangles, triangleData, (vertexCount / 3) * sizeof( CoreTri ) );
-	meshes.push_back( newMesh );
+	// store the supplied 'fat triangles' in the compact layout, at less than half the size
+	newMesh.triangles = new CoreTriCompact[vertexCount / 3];
+	for (int i = 0; i < vertexCount / 3; i++) PackTriangle( triangleData[i], newMesh.triangles[i] );
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  RenderCore::SetGeometry                                                    |
+//  |  Set the geometry data for a model, using indexed data. We only plot the    |
+//  |  vertices, so the unique positions and the index buffer are stored; the     |
+//  |  'fat' triangles are never built.                                     LH2'21|
+//  +-----------------------------------------------------------------------------+
+void RenderCore::SetGeometry( const int meshIdx, const CoreIndexedMesh& mesh )
+{
+	Mesh& newMesh = ReplaceMesh( meshIdx );
+	newMesh.vertices = new float4[mesh.vertexCount];
+	newMesh.vcount = mesh.vertexCount;
+	memcpy( newMesh.vertices, mesh.positions, mesh.vertexCount * sizeof( float4 ) );
+	newMesh.indices = new uint[mesh.triangleCount * 3];
+	newMesh.tcount = mesh.triangleCount;
+	memcpy( newMesh.indices, mesh.indices, mesh.triangleCount * 3 * sizeof( uint ) );
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  RenderCore::ReplaceMesh                                                    |
+//  |  Free the data of a mesh that is sent again, or add a slot for a new one.   |
+//  |                                                                       LH2'21|
+//  +-----------------------------------------------------------------------------+
+Mesh& RenderCore::ReplaceMesh( const int meshIdx )
+{
+	if (meshIdx >= (int)meshes.size()) meshes.resize( meshIdx + 1 );
+	Mesh& mesh = meshes[meshIdx];
+	delete[] mesh.vertices;
+	delete[] mesh.triangles;
+	delete[] mesh.indices;
+	mesh = Mesh();
+	return mesh;
 }
 
 //  +-----------------------------------------------------------------------------+
@@ -92,6 +124,8 @@ CoreStats RenderCore::GetCoreStats() const
 //  +-----------------------------------------------------------------------------+
 void RenderCore::Shutdown()
 {
+	for (Mesh& mesh : meshes) delete[] mesh.vertices, delete[] mesh.triangles, delete[] mesh.indices;
+	meshes.clear();
 	delete screen;
 }
 
@@ -27,7 +27,9 @@ class Mesh
 public:
 	float4* vertices = 0;							// vertex data received via SetGeometry
 	int vcount = 0;									// vertex count
-	CoreTri* triangles = 0;							// 'fat' triangle data
+	CoreTriCompact* triangles = 0;					// 'fat' triangle data, quantized; see PackTriangle
+	uint* indices = 0;								// indexed geometry: three vertex indices per triangle
+	int tcount = 0;									// indexed geometry: triangle count
 };
 
 //  +-----------------------------------------------------------------------------+
@@ -41,9 +43,12 @@ public:
 	void Init();
 	void SetTarget( GLTexture* target, const uint spp );
 	void SetGeometry( const int meshIdx, const float4* vertexData, const int vertexCount, const int triangleCount, const CoreTri* triangles );
+	void SetGeometry( const int meshIdx, const CoreIndexedMesh& mesh ) override;
+	bool AcceptsIndexedGeometry() const override { return true; } // only vertex positions are used
 	void Render( const ViewPyramid& view, const Convergence converge, bool async );
 	void WaitForRender() { /* this core does not support asynchronous rendering yet */ }
 	CoreStats GetCoreStats() const override;
+	bool SupportsMultipleInstances() const override { return true; } // all state is in the RenderCore object
 	void Shutdown();
 
 	// unimplemented for the minimal core
@@ -57,12 +62,14 @@ public:
 		const CoreDirectionalLight* directionalLights, const int directionalLightCount ) override
 	{
 	}
+	inline bool UpdateTriLights( const CoreLightTri* triLights, const int* triLightIdx, const int count ) override { return true; } // nothing to resend
 	inline void SetSkyData( const float3* pixels, const uint width, const uint height, const mat4& worldToLight ) override {}
 	inline void SetInstance( const int instanceIdx, const int modelIdx, const mat4& transform ) override {}
 	inline void FinalizeInstances() override {}
 
 	// internal methods
 private:
+	Mesh& ReplaceMesh( const int meshIdx );
 
 	// data members
 	Bitmap* screen = 0;								// temporary storage of RenderCore output; will be copied to render target
@@ -54,6 +54,7 @@ public:
 		const CorePointLight* pointLights, const int pointLightCount,
 		const CoreSpotLight* spotLights, const int spotLightCount,
 		const CoreDirectionalLight* directionalLights, const int directionalLightCount );
+	bool UpdateTriLights( const CoreLightTri* triLights, const int* triLightIdx, const int count );
 	void SetSkyData( const float3* pixels, const uint width, const uint height, const mat4& worldToLight );
 	// geometry and instances:
 	// a scene is setup by first passing a number of meshes (geometry), then a number of instances.
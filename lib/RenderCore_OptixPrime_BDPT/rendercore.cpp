@@ -504,6 +504,29 @@ void RenderCore::SetLights( const CoreLightTri* triLights, const int triLightCou
 	noDirectLightsInScene = (triLightCount + pointLightCount + spotLightCount + directionalLightCount) == 0;
 }
 
+//  +-----------------------------------------------------------------------------+
+//  |  RenderCore::UpdateTriLights                                                |
+//  |  Replace light triangles at the specified positions in the array passed to  |
+//  |  the last SetLights call. Only the range that holds the modified lights is  |
+//  |  copied to the device.                                                LH2'21|
+//  +-----------------------------------------------------------------------------+
+bool RenderCore::UpdateTriLights( const CoreLightTri* triLights, const int* triLightIdx, const int count )
+{
+	if (count == 0) return true;
+	if (triLightBuffer == 0) return false;
+	const int size = (int)triLightBuffer->GetSize();
+	int first = size, last = -1;
+	for (int i = 0; i < count; i++)
+	{
+		const int idx = triLightIdx[i];
+		if (idx < 0 || idx >= size) return false; // the caller sends all lights instead
+		triLightBuffer->HostPtr()[idx] = triLights[i];
+		first = min( first, idx ), last = max( last, idx );
+	}
+	stageMemcpy( triLightBuffer->DevPtr() + first, triLightBuffer->HostPtr() + first, (last - first + 1) * (int)sizeof( CoreLightTri ) );
+	return true;
+}
+
 //  +-----------------------------------------------------------------------------+
 //  |  RenderCore::SetSkyData                                                     |
 //  |  Set the sky dome data.                                               LH2'19|
@@ -28,12 +28,6 @@ uint ScaleColor( uint c, int scale )
 // -----------------------------------------------------------
 // static data for the rasterizer
 // -----------------------------------------------------------
-Surface* Mesh::screen = 0;
-float* Mesh::xleft, *Mesh::xright, *Mesh::uleft, *Mesh::uright;
-float* Mesh::vleft, *Mesh::vright, *Mesh::zleft, *Mesh::zright;
-Scene Rasterizer::scene;
-float* Rasterizer::zbuffer;
-float4 Rasterizer::frustum[5];
 static float3 raxis[3] = { make_float3( 1, 0, 0 ), make_float3( 0, 1, 0 ), make_float3( 0, 0, 1 ) };
 
 // -----------------------------------------------------------
@@ -41,7 +35,6 @@ static float3 raxis[3] = { make_float3( 1, 0, 0 ), make_float3( 0, 1, 0 ), make_
 // input: vertex count & face count
 // allocates room for mesh data:
 // - pos:  vertex positions
-// - tpos: transformed vertex positions
 // - norm: vertex normals
 // - spos: vertex screen space positions
 // - uv:   vertex uv coordinates
@@ -50,7 +43,7 @@ static float3 raxis[3] = { make_float3( 1, 0, 0 ), make_float3( 0, 1, 0 ), make_
 // -----------------------------------------------------------
 Mesh::Mesh( int vcount, int tcount ) : verts( vcount ), tris( tcount )
 {
-	pos = new float3[vcount * 3], tpos = pos + vcount, norm = pos + 2 * vcount;
+	pos = new float3[vcount * 2], norm = pos + vcount;
 	spos = new float2[vcount * 2], uv = spos + vcount, N = new float3[tcount];
 	tri = new int[tcount * 3];
 	material = new int[tcount];
@@ -58,8 +51,9 @@ Mesh::Mesh( int vcount, int tcount ) : verts( vcount ), tris( tcount )
 
 // -----------------------------------------------------------
 // Mesh render function
-// input: final matrix for scene graph node
-// renders a mesh using software rasterization.
+// input: final matrix for scene graph node, view to draw to
+// renders a mesh using software rasterization. The mesh is
+// not modified, so multiple views may draw it concurrently.
 // stages:
 // 1. mesh culling: checks the mesh against the view frustum
 // 2. vertex transform: calculates world space coordinates
@@ -71,26 +65,30 @@ Mesh::Mesh( int vcount, int tcount ) : verts( vcount ), tris( tcount )
 //    e) span construction
 //    f) span filling
 // -----------------------------------------------------------
-void Mesh::Render( const mat4& T )
+void Mesh::Render( const mat4& T, RenderContext& context ) const
 {
+	const Surface* screen = context.screen;
+	float* xleft = context.xleft, *xright = context.xright, *uleft = context.uleft, *uright = context.uright;
+	float* vleft = context.vleft, *vright = context.vright, *zleft = context.zleft, *zright = context.zright;
 	// cull mesh
 	float3 c[8];
 	for (int i = 0; i < 8; i++) c[i] = make_float3( T * make_float4( bounds[i & 1].x, bounds[(i >> 1) & 1].y, bounds[i >> 2].z, 1 ) );
 	for (int i, p = 0; p < 5; p++)
 	{
-		for (i = 0; i < 8; i++) if ((dot( make_float3( Rasterizer::frustum[p] ), c[i] ) - Rasterizer::frustum[p].w) > 0) break;
+		for (i = 0; i < 8; i++) if ((dot( make_float3( context.frustum[p] ), c[i] ) - context.frustum[p].w) > 0) break;
 		if (i == 8) return;
 	}
 	// transform vertices
+	if (context.tpos.size() < (size_t)verts) context.tpos.resize( verts );
+	float3* tpos = context.tpos.data();
 	for (int i = 0; i < verts; i++) tpos[i] = make_float3( make_float4( pos[i], 1 ) * T );
 	// draw triangles
 	for (int i = 0; i < tris; i++)
 	{
-		Material* mat = Rasterizer::scene.matList[material[i]];
-		static uint p;
-		uint* src = mat->texture ? mat->texture->pixels : &p;
-		if (!mat->texture) p = mat->diffuse;
-		float* zbuffer = Rasterizer::zbuffer, f;
+		Material* mat = context.scene->matList[material[i]];
+		uint p = mat->diffuse;
+		const uint* src = mat->texture ? mat->texture->pixels : &p;
+		float* zbuffer = context.zbuffer, f;
 		const float tw = mat->texture ? (float)mat->texture->width : 1;
 		const float th = mat->texture ? (float)mat->texture->height : 1;
 		const int umask = (int)tw, vmask = (int)th;
@@ -106,7 +104,7 @@ void Mesh::Render( const mat4& T )
 		{
 			const float3 A = cpos[from][v], B = cpos[from][(v + 1) % nin];
 			const float2 Auv = cuv[from][v], Buv = cuv[from][(v + 1) % nin];
-			const float4 plane = Rasterizer::frustum[p];
+			const float4 plane = context.frustum[p];
 			const float t1 = dot( make_float3( plane ), A ) - plane.w, t2 = dot( make_float3( plane ), B ) - plane.w;
 			if ((t1 < 0) && (t2 >= 0))
 				f = t1 / (t1 - t2),
@@ -181,34 +179,37 @@ Scene::~Scene()
 // -----------------------------------------------------------
 // SGNode::Render
 // recursive rendering of a scene graph node and its child nodes
-// input: (inverse) camera transform
+// input: (inverse) camera transform, view to draw to
 // -----------------------------------------------------------
-void SGNode::Render( const mat4& transform )
+void SGNode::Render( const mat4& transform, RenderContext& context )
 {
 	mat4 M = transform * localTransform;
-	if (GetType() == SG_MESH) ((Mesh*)this)->Render( M );
-	for (uint s = (uint)child.size(), i = 0; i < s; i++) child[i]->Render( M );
+	if (GetType() == SG_MESH) ((Mesh*)this)->Render( M, context );
+	for (uint s = (uint)child.size(), i = 0; i < s; i++) child[i]->Render( M, context );
 }
 
 // -----------------------------------------------------------
-// Rasterizer::Init
-// initialization of the rasterizer
-// input: surface to draw to
+// RenderContext constructor
+// allocates the outline tables for a view
 // -----------------------------------------------------------
-void Rasterizer::Init()
+RenderContext::RenderContext()
 {
-	// setup outline tables & zbuffer
-	Mesh::xleft = new float[8192], Mesh::xright = new float[8192]; // that should do for pretty much any resolution
-	Mesh::uleft = new float[8192], Mesh::uright = new float[8192];
-	Mesh::vleft = new float[8192], Mesh::vright = new float[8192];
-	Mesh::zleft = new float[8192], Mesh::zright = new float[8192];
+	// one block for all tables; 8192 lines should do for pretty much any resolution
+	xleft = new float[8192 * 8], xright = xleft + 8192;
+	uleft = xleft + 8192 * 2, uright = xleft + 8192 * 3;
+	vleft = xleft + 8192 * 4, vright = xleft + 8192 * 5;
+	zleft = xleft + 8192 * 6, zright = xleft + 8192 * 7;
 }
 
-void Rasterizer::Reinit( int w, int h, Surface* screen )
+// -----------------------------------------------------------
+// RenderContext::Reinit
+// initialization that depends on screen size
+// input: surface to draw to
+// -----------------------------------------------------------
+void RenderContext::Reinit( int w, int h, Surface* target )
 {
-	// initialization that depends on screen size
-	for (int y = 0; y < h; y++) Mesh::xleft[y] = w - 1, Mesh::xright[y] = 0;
-	delete zbuffer;
+	for (int y = 0; y < h; y++) xleft[y] = w - 1, xright[y] = 0;
+	delete[] zbuffer;
 	zbuffer = new float[w * h];
 	// calculate view frustum planes
 	float C = -1.0f, x1 = 0.5f, x2 = w - 1.5f, y1 = 0.5f, y2 = h - 1.5f;
@@ -223,19 +224,30 @@ void Rasterizer::Reinit( int w, int h, Surface* screen )
 	float3 c( normalize( cross( p3 - p0, p2 - p3 ) ) ); frustum[3] = make_float4( c, 0 ); // right plane
 	float3 d( normalize( cross( p4 - p0, p3 - p4 ) ) ); frustum[4] = make_float4( d, 0 ); // bottom plane
 	// store screen pointer
-	Mesh::screen = screen;
+	screen = target;
+}
+
+// -----------------------------------------------------------
+// Rasterizer::Init
+// initialization of the rasterizer
+// -----------------------------------------------------------
+void Rasterizer::Init()
+{
+	// per-view state is allocated by the RenderContext
 }
 
 // -----------------------------------------------------------
 // Rasterizer::Render
 // render the scene
-// input: camera to render with
+// input: camera to render with, view to draw to
 // -----------------------------------------------------------
-void Rasterizer::Render( const mat4& transform )
+void Rasterizer::Render( const mat4& transform, RenderContext& context ) const
 {
-	memset( Mesh::screen->pixels, 0, Mesh::screen->width * Mesh::screen->height * sizeof( uint ) );
-	memset( zbuffer, 0, Mesh::screen->width * Mesh::screen->height * sizeof( float ) );
-	scene.root->Render( transform.Inverted() );
+	context.scene = &scene;
+	const Surface* screen = context.screen;
+	memset( screen->pixels, 0, screen->width * screen->height * sizeof( uint ) );
+	memset( context.zbuffer, 0, screen->width * screen->height * sizeof( float ) );
+	scene.root->Render( transform.Inverted(), context );
 }
 
 // EOF
\ No newline at end of file
@@ -65,6 +65,35 @@ public:
 	Texture* texture = 0;			// texture
 };
 
+// -----------------------------------------------------------
+// RenderContext class
+// per-view rasterization state: target surface, depth buffer,
+// frustum and scratch buffers. Views that each have their own
+// context can be rendered concurrently.
+// -----------------------------------------------------------
+class Scene;
+class RenderContext
+{
+public:
+	// constructor / destructor
+	RenderContext();
+	~RenderContext() { delete[] zbuffer; delete[] xleft; }
+	RenderContext( const RenderContext& ) = delete; // owns its buffers
+	RenderContext& operator = ( const RenderContext& ) = delete;
+	// methods
+	void Reinit( int w, int h, Surface* target );
+	// data members
+	Surface* screen = 0;			// surface to draw to; not owned
+	const Scene* scene = 0;			// scene being drawn; not owned
+	float* zbuffer = 0;				// 1/z per pixel
+	float4 frustum[5];				// view frustum planes, camera space
+	float* xleft, *xright;			// outline tables for rasterization
+	float* uleft, *uright;
+	float* vleft, *vright;
+	float* zleft, *zright;
+	vector<float3> tpos;			// camera-space positions of the mesh being drawn
+};
+
 // -----------------------------------------------------------
 // SGNode class
 // scene graph node, with convenience functions for translate
@@ -86,7 +115,7 @@ public:
 	// methods
 	void SetPosition( float3& pos ) { mat4& M = localTransform; M[3] = pos.x, M[7] = pos.y, M[11] = pos.z; }
 	float3 GetPosition() { mat4& M = localTransform; return make_float3( M[3], M[7], M[11] ); }
-	void Render( const mat4& transform );
+	void Render( const mat4& transform, RenderContext& context );
 	virtual int GetType() { return SG_TRANSFORM; }
 	// data members
 	mat4 localTransform;
@@ -105,11 +134,10 @@ public:
 	Mesh( int vcount, int tcount );
 	~Mesh() { delete pos; delete N; delete spos; delete tri; }
 	// methods
-	void Render( const mat4& transform );
+	void Render( const mat4& transform, RenderContext& context ) const;
 	virtual int GetType() { return SG_MESH; }
 	// data members
 	float3* pos = 0;				// object-space vertex positions
-	float3* tpos = 0;				// world-space positions
 	float2* uv = 0;					// vertex uv coordinates
 	float2* spos = 0;				// screen positions
 	float3* norm = 0;				// vertex normals
@@ -118,11 +146,6 @@ public:
 	int verts = 0, tris = 0;		// vertex & triangle count
 	int* material = 0;				// per-face material ID
 	float3 bounds[2];				// mesh bounds
-	static Surface* screen;
-	static float* xleft, *xright;	// outline tables for rasterization
-	static float* uleft, *uright;
-	static float* vleft, *vright;
-	static float* zleft, *zright;
 };
 
 // -----------------------------------------------------------
@@ -155,12 +178,12 @@ public:
 	Rasterizer() = default;
 	// methods
 	void Init();
-	void Reinit( int w, int h, Surface* screen );
-	void Render( const mat4& transform );
+	void Reinit( int w, int h, Surface* screen ) { context.Reinit( w, h, screen ); }
+	void Render( const mat4& transform ) { Render( transform, context ); }
+	void Render( const mat4& transform, RenderContext& context ) const;
 	// data members
-	static Scene scene;
-	static float* zbuffer;
-	static float4 frustum[5];
+	Scene scene;
+	RenderContext context;			// state for the default view
 };
 
 } // namespace lh2core
@@ -40,6 +40,8 @@ void RenderCore::Init()
 	// initialize scene
 	rasterizer.Init();
 	rasterizer.scene.root = new SGNode();
+	// prepare the task for asynchronous rendering
+	renderFlow.emplace( [this]() { rasterizer.Render( renderTransform ); } );
 }
 
 //  +-----------------------------------------------------------------------------+
@@ -48,6 +50,7 @@ void RenderCore::Init()
 //  +-----------------------------------------------------------------------------+
 void RenderCore::SetTarget( GLTexture* target, const uint spp )
 {
+	WaitForRender();
 	// synchronize OpenGL viewport
 	scrwidth = target->width;
 	scrheight = target->height;
@@ -205,30 +208,107 @@ void RenderCore::Setting( const char* name, const float value )
 
 //  +-----------------------------------------------------------------------------+
 //  |  RenderCore::Render                                                         |
-//  |  Produce one image.                                                   LH2'19|
+//  |  Produce one image. An asynchronous render rasterizes on a worker thread;   |
+//  |  WaitForRender copies the result to the render target, as OpenGL calls      |
+//  |  must be made on the thread that owns the context. The RenderSystem holds   |
+//  |  back scene updates until the render completes.                       LH2'19|
 //  +-----------------------------------------------------------------------------+
-void RenderCore::Render( const ViewPyramid& view, const Convergence converge, bool async )
+static mat4 CameraTransform( const ViewPyramid& view )
 {
-	// render
 	mat4 transform;
 	const float3 X = normalize( view.p2 - view.p1 ), Y = normalize( view.p1 - view.p3 );
 	const float3 Z = normalize( view.pos - 0.5f * (view.p2 + view.p3) );
 	transform[0] = X.x, transform[4] = X.y, transform[8] = X.z;
 	transform[1] = Y.x, transform[5] = Y.y, transform[9] = Y.z;
 	transform[2] = Z.x, transform[6] = Z.y, transform[10] = Z.z;
-	rasterizer.Render( mat4::Translate( view.pos ) * transform );
-	// copy cpu surface to OpenGL render target texture
+	return mat4::Translate( view.pos ) * transform;
+}
+void RenderCore::Render( const ViewPyramid& view, const Convergence converge, bool async )
+{
+	WaitForRender();
+	// render
+	renderTransform = CameraTransform( view );
+	if (async)
+	{
+		renderDone = executor.run( renderFlow );
+		asyncRenderInProgress = true;
+		return;
+	}
+	rasterizer.Render( renderTransform );
+	FinalizeRender();
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  RenderCore::WaitForRender                                                  |
+//  |  Wait for the asynchronous render to complete.                        LH2'21|
+//  +-----------------------------------------------------------------------------+
+void RenderCore::WaitForRender()
+{
+	if (!asyncRenderInProgress) return;
+	renderDone.wait();
+	asyncRenderInProgress = false;
+	FinalizeRender();
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  RenderCore::FinalizeRender                                                 |
+//  |  Copy the cpu surface to the OpenGL render target texture.            LH2'21|
+//  +-----------------------------------------------------------------------------+
+void RenderCore::FinalizeRender()
+{
 	glBindTexture( GL_TEXTURE_2D, targetTextureID );
 	glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, scrwidth, scrheight, 0, GL_RGBA, GL_UNSIGNED_BYTE, renderTarget->pixels );
 }
 
+//  +-----------------------------------------------------------------------------+
+//  |  RenderCore::RenderViews                                                    |
+//  |  Produce one image per view. Each view has its own surface and rasterizer   |
+//  |  state, and the scene is only read, so all views are rasterized in a        |
+//  |  single parallel pass. Results are copied to the OpenGL targets on the      |
+//  |  calling thread, which owns the GL context.                           LH2'21|
+//  +-----------------------------------------------------------------------------+
+void RenderCore::RenderViews( const ViewPyramid* views, GLTexture* const* targets, const int viewCount, const uint spp, const Convergence converge )
+{
+	WaitForRender();
+	// prepare the per-view state
+	while ((int)viewTargets.size() < viewCount) viewTargets.push_back( new ViewTarget() );
+	for (int i = 0; i < viewCount; i++)
+	{
+		ViewTarget* view = viewTargets[i];
+		const GLTexture* target = targets[i];
+		if (view->surface.width != (int)target->width || view->surface.height != (int)target->height)
+		{
+			FREE64( view->surface.pixels );
+			view->surface.pixels = (uint*)MALLOC64( target->width * target->height * sizeof( uint ) );
+			view->surface.width = target->width, view->surface.height = target->height;
+			view->context.Reinit( target->width, target->height, &view->surface );
+		}
+		view->textureID = target->ID;
+	}
+	// rasterize
+	tf::Taskflow taskflow;
+	for (int i = 0; i < viewCount; i++)
+		taskflow.emplace( [this, views, i]() { rasterizer.Render( CameraTransform( views[i] ), viewTargets[i]->context ); } );
+	executor.run( taskflow ).wait();
+	// copy cpu surfaces to OpenGL render target textures
+	for (int i = 0; i < viewCount; i++)
+	{
+		const Surface& surface = viewTargets[i]->surface;
+		glBindTexture( GL_TEXTURE_2D, viewTargets[i]->textureID );
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, surface.width, surface.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, surface.pixels );
+	}
+}
+
 //  +-----------------------------------------------------------------------------+
 //  |  RenderCore::Shutdown                                                       |
 //  |  Free all resources.                                                  LH2'19|
 //  +-----------------------------------------------------------------------------+
 void RenderCore::Shutdown()
 {
+	WaitForRender();
 	delete renderTarget;
+	for (ViewTarget* view : viewTargets) delete view;
+	viewTargets.clear();
 }
 
 //  +-----------------------------------------------------------------------------+
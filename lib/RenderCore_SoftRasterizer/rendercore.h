@@ -29,6 +29,17 @@ struct DeviceVars
 	float geometryEpsilon = 1e34f;
 };
 
+//  +-----------------------------------------------------------------------------+
+//  |  ViewTarget                                                                 |
+//  |  Render target and rasterizer state for one view of RenderViews.      LH2'21|
+//  +-----------------------------------------------------------------------------+
+struct ViewTarget
+{
+	Surface surface;								// pixels for this view
+	RenderContext context;							// zbuffer, frustum and outline tables for this view
+	int textureID = 0;								// ID of the target OpenGL texture
+};
+
 //  +-----------------------------------------------------------------------------+
 //  |  RenderCore                                                                 |
 //  |  Encapsulates device code.                                            LH2'19|
@@ -39,7 +50,8 @@ public:
 	// methods
 	void Init();
 	void Render( const ViewPyramid& view, const Convergence converge, bool async );
-	void WaitForRender() { /* this core does not support asynchronous rendering yet */ }
+	void RenderViews( const ViewPyramid* views, GLTexture* const* targets, const int viewCount, const uint spp, const Convergence converge ) override;
+	void WaitForRender();
 	void Setting( const char* name, const float value );
 	void SetTarget( GLTexture* target, const uint spp );
 	void Shutdown();
@@ -51,6 +63,7 @@ public:
 		const CorePointLight* pointLights, const int pointLightCount,
 		const CoreSpotLight* spotLights, const int spotLightCount,
 		const CoreDirectionalLight* directionalLights, const int directionalLightCount );
+	inline bool UpdateTriLights( const CoreLightTri* triLights, const int* triLightIdx, const int count ) override { return true; } // lights are not used yet
 	void SetSkyData( const float3* pixels, const uint width, const uint height, const mat4& worldToLight );
 	// geometry and instances:
 	// a scene is setup by first passing a number of meshes (geometry), then a number of instances.
@@ -61,8 +74,10 @@ public:
 	void FinalizeInstances() { /* not needed for the software rasterizer */ }
 	void SetProbePos( const int2 pos );
 	CoreStats GetCoreStats() const override;
+	bool SupportsMultipleInstances() const override { return true; } // all state is in the RenderCore object
 	// internal methods
 private:
+	void FinalizeRender();
 	// data members
 	int scrwidth = 0, scrheight = 0;				// current screen width and height
 	Surface* renderTarget = 0;						// screen pixels
@@ -73,6 +88,12 @@ private:
 	int textureCount = 0;							// size of texture descriptor array
 	Rasterizer rasterizer;							// rasterization functionality
 	vector<Mesh*> meshes;							// list of meshes, for easy access in SetGeometry
+	vector<ViewTarget*> viewTargets;				// per-view state for RenderViews
+	tf::Executor executor;							// worker threads for RenderViews and asynchronous rendering
+	tf::Taskflow renderFlow;						// asynchronous rendering: rasterizes the default view
+	mat4 renderTransform;							// asynchronous rendering: camera transform for renderFlow
+	std::future<void> renderDone;					// asynchronous rendering: completion of renderFlow
+	bool asyncRenderInProgress = false;				// asynchronous rendering: renderFlow was started
 public:
 	CoreStats coreStats;							// rendering statistics
 };
@@ -162,6 +162,43 @@ struct CoreTri4
 #define TRI_LOD			vertexAlpha.w
 };
 
+//  +-----------------------------------------------------------------------------+
+//  |  CoreTriCompact                                                             |
+//  |  Quantized alternative to CoreTri: 96 instead of 208 bytes per triangle.    |
+//  |  - vertex positions, material and light index at full precision             |
+//  |  - vertex normals, tangent and bitangent octahedral-encoded in 32 bits;     |
+//  |    these unpack as unit vectors, so the lengths of non-unit T and B (e.g.   |
+//  |    the half extents stored by AddQuad) are lost                             |
+//  |  - uvs and consistent normal alphas as half floats.                         |
+//  |  The face normal, area, inverse area and LOD are not stored; these are      |
+//  |  recomputed on demand. Cores opt in by converting with PackTriangle /       |
+//  |  UnpackTriangle (common_functions.h), as the Minimal core does for the      |
+//  |  triangles it stores; apps/packcheck checks the round trip against the      |
+//  |  full layout.                                                         LH2'21|
+//  +-----------------------------------------------------------------------------+
+#ifndef __OPENCLCC__
+#define TRICOMPACT_FLIPPED	1	// face normal opposes cross( vertex1 - vertex0, vertex2 - vertex0 )
+struct CoreTriCompact
+{
+	float3 vertex0;			// 12
+	uint material;			// 4
+	float3 vertex1;			// 12
+	int ltriIdx;			// 4, set only for emissive triangles, used for MIS
+	float3 vertex2;			// 12
+	uint T;					// 4, octahedral
+	uint vN0, vN1, vN2, B;	// 16, octahedral
+	ushort u0, u1, u2;		// 6, half
+	ushort v0, v1, v2;		// 6, half
+	ushort alpha0, alpha1;	// 4, half
+	ushort u1_0, u1_1, u1_2;	// 6, half; 2nd set of uv coordinates
+	ushort v1_0, v1_1, v1_2;	// 6, half
+	ushort alpha2;			// 2, half
+	ushort flags;			// 2, TRICOMPACT_FLIPPED
+	// total 6 * 16 = 96 bytes.
+};
+static_assert(sizeof( CoreTriCompact ) == 96, "CoreTriCompact must stay 6 x 16 bytes");
+#endif
+
 //  +-----------------------------------------------------------------------------+
 //  |  CoreInstanceDesc                                                           |
 //  |  Instance descriptor. We will pass an array of these to the shading code,   |
@@ -159,4 +159,120 @@ FUNCTYPE float3 CatmullRom( const float3& p0, const float3& p1, const float3& p2
 	return 0.5f * (a + (b * t) + (c * t * t) + (d * t * t * t));
 }
 
+// compact triangle encoding: see CoreTriCompact in common_classes.h
+#ifndef __OPENCLCC__
+
+FUNCTYPE ushort FloatToHalf( const float f )
+{
+#ifdef __CUDACC__
+	return __half_as_ushort( __float2half_rn( f ) );
+#else
+	uint x;
+	memcpy( &x, &f, 4 );
+	const uint sign = (x >> 16) & 0x8000;
+	x &= 0x7fffffff;
+	if (x >= 0x7f800000) return (ushort)(sign | 0x7c00 | (x > 0x7f800000 ? 0x200 : 0)); // inf, nan
+	if (x >= 0x47800000) return (ushort)(sign | 0x7c00); // overflow
+	if (x < 0x33000000) return (ushort)sign; // underflow
+	uint h, shift;
+	if (x < 0x38800000) shift = 126 - (x >> 23), x = (x & 0x7fffff) | 0x800000, h = x >> shift; // denormal
+	else shift = 13, h = (x >> 13) - (112 << 10);
+	const uint rest = x & ((1 << shift) - 1), halfway = 1 << (shift - 1);
+	if (rest > halfway || (rest == halfway && (h & 1))) h++; // round to nearest even
+	return (ushort)(sign | h);
+#endif
+}
+
+FUNCTYPE float HalfToFloat( const ushort h )
+{
+#ifdef __CUDACC__
+	return __half2float( __ushort_as_half( h ) );
+#else
+	uint e = (h >> 10) & 0x1f, m = h & 0x3ff, x = (uint)(h & 0x8000) << 16;
+	if (e == 0x1f) x |= 0x7f800000 | (m << 13); // inf, nan
+	else if (e > 0) x |= ((e + 112) << 23) | (m << 13);
+	else if (m > 0) // denormal
+	{
+		e = 113;
+		while (!(m & 0x400)) m <<= 1, e--;
+		x |= (e << 23) | ((m & 0x3ff) << 13);
+	}
+	float f;
+	memcpy( &f, &x, 4 );
+	return f;
+#endif
+}
+
+// octahedral unit vector, 2x16 bit snorm; the zero vector is stored as 0x80008000.
+// Only the direction is stored: other vectors are normalized, dropping their length.
+FUNCTYPE uint PackOctahedral( const float3& N )
+{
+	const float l1 = fabsf( N.x ) + fabsf( N.y ) + fabsf( N.z );
+	if (!(l1 > 0)) return 0x80008000;
+	float x = N.x / l1, y = N.y / l1;
+	if (N.z < 0)
+	{
+		const float px = x;
+		x = (1 - fabsf( y )) * (px >= 0 ? 1 : -1);
+		y = (1 - fabsf( px )) * (y >= 0 ? 1 : -1);
+	}
+	const int qx = (int)roundf( fmaxf( -1.0f, fminf( 1.0f, x ) ) * 32767 );
+	const int qy = (int)roundf( fmaxf( -1.0f, fminf( 1.0f, y ) ) * 32767 );
+	return (uint)(qx & 0xffff) + ((uint)(qy & 0xffff) << 16);
+}
+
+FUNCTYPE float3 UnpackOctahedral( const uint p )
+{
+	if (p == 0x80008000) return make_float3( 0, 0, 0 );
+	float x = (float)(short)(p & 0xffff) * (1.0f / 32767), y = (float)(short)(p >> 16) * (1.0f / 32767);
+	const float z = 1 - fabsf( x ) - fabsf( y );
+	if (z < 0)
+	{
+		const float px = x;
+		x = (1 - fabsf( y )) * (px >= 0 ? 1 : -1);
+		y = (1 - fabsf( px )) * (y >= 0 ? 1 : -1);
+	}
+	return normalize( make_float3( x, y, z ) );
+}
+
+FUNCTYPE void PackTriangle( const CoreTri& tri, CoreTriCompact& packed )
+{
+	packed.vertex0 = tri.vertex0, packed.vertex1 = tri.vertex1, packed.vertex2 = tri.vertex2;
+	packed.material = tri.material, packed.ltriIdx = tri.ltriIdx;
+	packed.vN0 = PackOctahedral( tri.vN0 ), packed.vN1 = PackOctahedral( tri.vN1 ), packed.vN2 = PackOctahedral( tri.vN2 );
+	packed.T = PackOctahedral( tri.T ), packed.B = PackOctahedral( tri.B );
+	packed.u0 = FloatToHalf( tri.u0 ), packed.u1 = FloatToHalf( tri.u1 ), packed.u2 = FloatToHalf( tri.u2 );
+	packed.v0 = FloatToHalf( tri.v0 ), packed.v1 = FloatToHalf( tri.v1 ), packed.v2 = FloatToHalf( tri.v2 );
+	packed.u1_0 = FloatToHalf( tri.u1_0 ), packed.u1_1 = FloatToHalf( tri.u1_1 ), packed.u1_2 = FloatToHalf( tri.u1_2 );
+	packed.v1_0 = FloatToHalf( tri.v1_0 ), packed.v1_1 = FloatToHalf( tri.v1_1 ), packed.v1_2 = FloatToHalf( tri.v1_2 );
+	packed.alpha0 = FloatToHalf( tri.alpha.x ), packed.alpha1 = FloatToHalf( tri.alpha.y ), packed.alpha2 = FloatToHalf( tri.alpha.z );
+	// the face normal is reconstructed from the vertices; only its orientation is stored
+	const float3 C = cross( tri.vertex1 - tri.vertex0, tri.vertex2 - tri.vertex0 );
+	packed.flags = (C.x * tri.Nx + C.y * tri.Ny + C.z * tri.Nz) < 0 ? TRICOMPACT_FLIPPED : 0;
+}
+
+// texelCount: width * height of the texture used for LOD calculation; 0 yields LOD 0.
+FUNCTYPE void UnpackTriangle( const CoreTriCompact& packed, CoreTri& tri, const float texelCount = 0 )
+{
+	tri.vertex0 = packed.vertex0, tri.vertex1 = packed.vertex1, tri.vertex2 = packed.vertex2;
+	tri.material = packed.material, tri.ltriIdx = packed.ltriIdx;
+	tri.vN0 = UnpackOctahedral( packed.vN0 ), tri.vN1 = UnpackOctahedral( packed.vN1 ), tri.vN2 = UnpackOctahedral( packed.vN2 );
+	tri.T = UnpackOctahedral( packed.T ), tri.B = UnpackOctahedral( packed.B );
+	tri.u0 = HalfToFloat( packed.u0 ), tri.u1 = HalfToFloat( packed.u1 ), tri.u2 = HalfToFloat( packed.u2 );
+	tri.v0 = HalfToFloat( packed.v0 ), tri.v1 = HalfToFloat( packed.v1 ), tri.v2 = HalfToFloat( packed.v2 );
+	tri.u1_0 = HalfToFloat( packed.u1_0 ), tri.u1_1 = HalfToFloat( packed.u1_1 ), tri.u1_2 = HalfToFloat( packed.u1_2 );
+	tri.v1_0 = HalfToFloat( packed.v1_0 ), tri.v1_1 = HalfToFloat( packed.v1_1 ), tri.v1_2 = HalfToFloat( packed.v1_2 );
+	tri.alpha = make_float3( HalfToFloat( packed.alpha0 ), HalfToFloat( packed.alpha1 ), HalfToFloat( packed.alpha2 ) );
+	// derived data
+	const float3 C = cross( tri.vertex1 - tri.vertex0, tri.vertex2 - tri.vertex0 );
+	const float Pa = length( C );
+	const float3 N = Pa > 0 ? (C * ((packed.flags & TRICOMPACT_FLIPPED) ? -1.0f : 1.0f) / Pa) : tri.vN0;
+	tri.Nx = N.x, tri.Ny = N.y, tri.Nz = N.z;
+	tri.UpdateArea();
+	tri.invArea = tri.area > 0 ? 1.0f / tri.area : 0;
+	const float Ta = texelCount * fabsf( (tri.u1 - tri.u0) * (tri.v2 - tri.v0) - (tri.u2 - tri.u0) * (tri.v1 - tri.v0) );
+	tri.LOD = (Ta > 0 && Pa > 0) ? 0.5f * log2f( Ta / Pa ) : 0;
+}
+#endif
+
 // EOF
\ No newline at end of file
@@ -21,7 +21,7 @@
 #pragma once
 
 // global settings
-#define CACHEIMAGES					// imported images will be saved to bin files (faster)
+#define CACHEIMAGES					// imported images will be saved to bin files (faster), see HostTexture::LoadFromCache
 
 // default screen size
 #define SCRWIDTH			1600
@@ -57,7 +57,9 @@
 #define MIPLEVELCOUNT		5
 
 // file format versions
-#define BINTEXFILEVERSION	0x10001001
+#define BINTEXFILEVERSION	0x10001002
+#define BINTEXCOMPRESSION	1		// zlib level for cached textures; 0 stores the texels raw
+#define SCENECACHEVERSION	0x10002003
 
 // tools
 
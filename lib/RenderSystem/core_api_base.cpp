@@ -18,12 +18,17 @@
 
 #include "rendersystem.h"
 
-static CoreAPI_Base* api = 0;
-
 typedef CoreAPI_Base* (*createCoreFunction)();
-typedef void( *destroyCoreFunction )();
-static createCoreFunction createCore;
-static destroyCoreFunction destroyCore;
+
+// loaded core libraries, by name
+struct CoreModule
+{
+	createCoreFunction createCore = 0;
+	int instanceCount = 0;
+};
+static unordered_map<string, CoreModule> coreModules;
+static unordered_map<CoreAPI_Base*, string> coreNames;	// module of each live core
+static mutex coreModuleMutex;
 
 #ifdef _MSC_VER
 #define WIN32_LEAN_AND_MEAN
@@ -118,15 +123,34 @@ void* GetSymbol( void* module, const char* symbol )
 
 CoreAPI_Base* CoreAPI_Base::CreateCoreAPI( const char* coreName )
 {
-	if (!api)
+	lock_guard<mutex> lock( coreModuleMutex );
+	CoreModule& coreModule = coreModules[coreName];
+	if (!coreModule.createCore)
 	{
 		module = LoadModule( coreName );
-		createCore = (createCoreFunction)GetSymbol( module, "CreateCore" );
-		FATALERROR_IF( !createCore, "Could not find CreateCore in library" );
-		api = createCore();
-		api->Init();
+		coreModule.createCore = (createCoreFunction)GetSymbol( module, "CreateCore" );
+		FATALERROR_IF( !coreModule.createCore, "Could not find CreateCore in library" );
+	}
+	CoreAPI_Base* core = coreModule.createCore();
+	FATALERROR_IF( coreModule.instanceCount > 0 && !core->SupportsMultipleInstances(), "%s supports a single core per process", coreName );
+	coreModule.instanceCount++;
+	coreNames[core] = coreName;
+	core->Init();
+	return core;
+}
+
+void CoreAPI_Base::DestroyCoreAPI( CoreAPI_Base* core )
+{
+	if (!core) return;
+	core->Shutdown();
+	lock_guard<mutex> lock( coreModuleMutex );
+	auto name = coreNames.find( core );
+	if (name != coreNames.end())
+	{
+		coreModules[name->second].instanceCount--;
+		coreNames.erase( name );
 	}
-	return api;
+	delete core; // the destructor is virtual, so the core library frees its own object
 }
 
 // EOF
\ No newline at end of file
@@ -74,6 +74,92 @@ struct SystemStats
 	float sceneUpdateTime = 0;			// time spent updating the scene graph
 };
 
+//  +-----------------------------------------------------------------------------+
+//  |  CoreIndexedMesh                                                            |
+//  |  Indexed geometry for a single mesh: shared vertex attribute streams and a  |
+//  |  32-bit index buffer. Streams that a mesh does not have are null. A zero    |
+//  |  vertex normal means: use the face normal. Pointers are valid for the       |
+//  |  duration of the SetGeometry call only.                               LH2'21|
+//  +-----------------------------------------------------------------------------+
+struct CoreIndexedMesh
+{
+	const float4* positions = 0;		// vertex positions, w = 1
+	const float3* normals = 0;			// vertex normals (optional)
+	const float2* uv0 = 0;				// first uv layer (optional)
+	const float2* uv1 = 0;				// second uv layer (optional)
+	const float* alpha = 0;				// per vertex values for consistent normal interpolation
+	const uint* indices = 0;			// three vertex indices per triangle
+	const int* materials = 0;			// material index per triangle
+	int vertexCount = 0;
+	int triangleCount = 0;
+};
+
+//  +-----------------------------------------------------------------------------+
+//  |  ExpandIndexedTriangle                                                      |
+//  |  Produce the de-indexed vertices and the 'fat' CoreTri for triangle 'i' of  |
+//  |  an indexed mesh. Used by the RenderSystem and by cores that do not handle  |
+//  |  indexed geometry themselves.                                         LH2'21|
+//  +-----------------------------------------------------------------------------+
+inline void ExpandIndexedTriangle( const CoreIndexedMesh& mesh, const int i, float4* vertices, CoreTri& tri )
+{
+	const uint v0idx = mesh.indices[i * 3 + 0], v1idx = mesh.indices[i * 3 + 1], v2idx = mesh.indices[i * 3 + 2];
+	vertices[0] = mesh.positions[v0idx], vertices[1] = mesh.positions[v1idx], vertices[2] = mesh.positions[v2idx];
+	tri.vertex0 = make_float3( vertices[0] ), tri.vertex1 = make_float3( vertices[1] ), tri.vertex2 = make_float3( vertices[2] );
+	tri.material = mesh.materials[i];
+	const float3 N = normalize( cross( tri.vertex1 - tri.vertex0, tri.vertex2 - tri.vertex0 ) );
+	tri.Nx = N.x, tri.Ny = N.y, tri.Nz = N.z;
+	tri.alpha = make_float3( mesh.alpha[v0idx], mesh.alpha[v1idx], mesh.alpha[v2idx] );
+	tri.vN0 = tri.vN1 = tri.vN2 = N;
+	if (mesh.normals)
+	{
+		if (dot( mesh.normals[v0idx], mesh.normals[v0idx] ) > 0) tri.vN0 = mesh.normals[v0idx];
+		if (dot( mesh.normals[v1idx], mesh.normals[v1idx] ) > 0) tri.vN1 = mesh.normals[v1idx];
+		if (dot( mesh.normals[v2idx], mesh.normals[v2idx] ) > 0) tri.vN2 = mesh.normals[v2idx];
+	}
+	if (mesh.uv0)
+	{
+		tri.u0 = mesh.uv0[v0idx].x, tri.v0 = mesh.uv0[v0idx].y;
+		tri.u1 = mesh.uv0[v1idx].x, tri.v1 = mesh.uv0[v1idx].y;
+		tri.u2 = mesh.uv0[v2idx].x, tri.v2 = mesh.uv0[v2idx].y;
+		// calculate tangent vector based on uvs
+		const float2 uv01 = make_float2( tri.u1 - tri.u0, tri.v1 - tri.v0 );
+		const float2 uv02 = make_float2( tri.u2 - tri.u0, tri.v2 - tri.v0 );
+		if (dot( uv01, uv01 ) == 0 || dot( uv02, uv02 ) == 0)
+		{
+			// PBRT:
+			// https://github.com/mmp/pbrt-v3/blob/3f94503ae1777cd6d67a7788e06d67224a525ff4/src/shapes/triangle.cpp#L381
+			if (std::abs( N.x ) > std::abs( N.y ))
+				tri.T = make_float3( -N.z, 0, N.x ) / std::sqrt( N.x * N.x + N.z * N.z );
+			else
+				tri.T = make_float3( 0, N.z, -N.y ) / std::sqrt( N.y * N.y + N.z * N.z );
+			tri.B = normalize( cross( N, tri.T ) );
+		}
+		else
+		{
+			tri.T = normalize( (tri.vertex1 - tri.vertex0) * uv02.y - (tri.vertex2 - tri.vertex0) * uv01.y );
+			tri.B = normalize( (tri.vertex2 - tri.vertex0) * uv01.x - (tri.vertex1 - tri.vertex0) * uv02.x );
+		}
+		// catch bad tangents
+		if (std::isnan( tri.T.x + tri.T.y + tri.T.z + tri.B.x + tri.B.y + tri.B.z ))
+		{
+			tri.T = normalize( tri.vertex1 - tri.vertex0 );
+			tri.B = normalize( cross( N, tri.T ) );
+		}
+	}
+	else
+	{
+		// no uv information; use edges to calculate tangent vectors
+		tri.T = normalize( tri.vertex1 - tri.vertex0 );
+		tri.B = normalize( cross( N, tri.T ) );
+	}
+	if (mesh.uv1)
+	{
+		tri.u1_0 = mesh.uv1[v0idx].x, tri.v1_0 = mesh.uv1[v0idx].y;
+		tri.u1_1 = mesh.uv1[v1idx].x, tri.v1_1 = mesh.uv1[v1idx].y;
+		tri.u1_2 = mesh.uv1[v2idx].x, tri.v1_2 = mesh.uv1[v2idx].y;
+	}
+}
+
 //  +-----------------------------------------------------------------------------+
 //  |  CoreAPI_Base                                                               |
 //  |  Interface between the RenderSystem and the RenderCore.               LH2'19|
@@ -81,8 +167,15 @@ struct SystemStats
 class CoreAPI_Base
 {
 public:
-	// CreateCoreAPI: instantiate and initialize a RenderCore object and obtain an interface to it.
+	// CreateCoreAPI: instantiate and initialize a RenderCore object and obtain an interface to it. The library is loaded
+	// once; each call creates a new core, which fails for a second core of a type that does not support multiple instances.
 	static CoreAPI_Base* CreateCoreAPI( const char* dllName );
+	// DestroyCoreAPI: shut down and delete a core obtained from CreateCoreAPI; afterwards, a new core of its type may be created.
+	static void DestroyCoreAPI( CoreAPI_Base* core );
+	virtual ~CoreAPI_Base() = default;
+	// SupportsMultipleInstances: true if several cores of this type can be used in one process, i.e. the core keeps no state
+	// in globals (such as device constants). Such cores may be used concurrently from different threads.
+	virtual bool SupportsMultipleInstances() const { return false; }
 	// GetCoreStats: obtain a const ref to the CoreStats object, which provides statistics on the rendering process.
 	virtual CoreStats GetCoreStats() const = 0;
 	// Init: initialize the core
@@ -95,6 +188,13 @@ public:
 	virtual void Setting( const char* name, float value ) = 0;
 	// Render: produce one frame. Convergence can be 'Converge' or 'Restart'.
 	virtual void Render( const ViewPyramid& view, const Convergence converge, bool async ) = 0;
+	// RenderViews: produce one frame for each view, each in its own target, using the scene data as it is. Cores that can
+	// do better (e.g. render all views in one parallel pass) override this. Afterwards, the last target is the current target.
+	virtual void RenderViews( const ViewPyramid* views, GLTexture* const* targets, const int viewCount, const uint spp, const Convergence converge )
+	{
+		// the accumulator of the core is shared between the views, so with multiple views each view starts over
+		for (int i = 0; i < viewCount; i++) SetTarget( targets[i], spp ), Render( views[i], viewCount > 1 ? Restart : converge, false );
+	}
 	// WaitForRender: wait for the asynchronous render to complete.
 	virtual void WaitForRender() = 0;
 	// Shutdown: destroy the RenderCore and free all resources.
@@ -108,10 +208,23 @@ public:
 		const CorePointLight* pointLights, const int pointLightCount,
 		const CoreSpotLight* spotLights, const int spotLightCount,
 		const CoreDirectionalLight* directionalLights, const int directionalLightCount ) = 0;
+	// UpdateTriLights: replace light triangles at the specified positions in the array passed to the last SetLights
+	// call. Returns false if the core does not support this; the RenderSystem will then call SetLights instead.
+	virtual bool UpdateTriLights( const CoreLightTri* triLights, const int* triLightIdx, const int count ) { return false; }
 	// SetSkyData: specify the data required for sky dome rendering.
 	virtual void SetSkyData( const float3* pixels, const uint width, const uint height, const mat4& worldToLight = mat4() ) = 0;
 	// SetGeometry: update the geometry for a single mesh.
 	virtual void SetGeometry( const int meshIdx, const float4* vertexData, const int vertexCount, const int triangleCount, const CoreTri* triangles ) = 0;
+	// SetGeometry: update the geometry for a single mesh, using indexed data. By default, this is expanded to the 'fat' layout.
+	virtual void SetGeometry( const int meshIdx, const CoreIndexedMesh& mesh )
+	{
+		vector<float4> vertices( mesh.triangleCount * 3 );
+		vector<CoreTri> triangles( mesh.triangleCount );
+		for (int i = 0; i < mesh.triangleCount; i++) ExpandIndexedTriangle( mesh, i, &vertices[i * 3], triangles[i] );
+		SetGeometry( meshIdx, vertices.data(), mesh.triangleCount * 3, mesh.triangleCount, triangles.data() );
+	}
+	// AcceptsIndexedGeometry: true if the core stores indexed geometry itself, rather than the expanded layout.
+	virtual bool AcceptsIndexedGeometry() const { return false; }
 	// SetInstance: update the data on a single instance.
 	virtual void SetInstance( const int instanceIdx, const int modelIdx, const mat4& transform = mat4::Identity() ) = 0;
 	// FinalizeInstances: allow the core to do any finalizing work after receiving all geometry and instances.
@@ -176,6 +176,24 @@ quat HostAnimation::Sampler::SampleQuat( float currentTime, int k ) const
 	return key;
 }
 
+//  +-----------------------------------------------------------------------------+
+//  |  HostAnimation::Sampler::FindKey                                            |
+//  |  Find the last key at or before 'time'. During regular playback the key of  |
+//  |  the previous frame or the one after it applies; otherwise (seek, wrap)     |
+//  |  we fall back to a binary search.                                     LH2'21|
+//  +-----------------------------------------------------------------------------+
+int HostAnimation::Sampler::FindKey( const float time, const int hint ) const
+{
+	const int last = (int)t.size() - 2; // last key that has a successor
+	if (hint >= 0 && hint <= last && time >= t[hint])
+	{
+		if (time < t[hint + 1]) return hint;
+		if (hint < last && time < t[hint + 2]) return hint + 1;
+	}
+	const int k = (int)(upper_bound( t.begin(), t.end(), time ) - t.begin()) - 1;
+	return max( 0, min( k, last ) );
+}
+
 //  +-----------------------------------------------------------------------------+
 //  |  HostAnimation::Channel::Channel                                            |
 //  |  Constructor.                                                         LH2'19|
@@ -201,44 +219,40 @@ void HostAnimation::Channel::ConvertFromGLTFChannel( const tinygltfAnimationChan
 
 //  +-----------------------------------------------------------------------------+
 //  |  HostAnimation::Channel::Update                                             |
-//  |  Advance channel animation time.                                      LH2'19|
+//  |  Apply the channel to its target node, for time t and key frame k.    LH2'19|
 //  +-----------------------------------------------------------------------------+
-void HostAnimation::Channel::Update( const float dt, const Sampler* sampler )
+void HostAnimation::Channel::Update( HostNode* node, const float t, const int k, const Sampler* sampler )
 {
-	// advance animation timer
-	t += dt;
-	int keyCount = (int)sampler->t.size();
-	float animDuration = sampler->t[keyCount - 1];
+	const int keyCount = (int)sampler->t.size();
+	const float animDuration = sampler->t[keyCount - 1];
 	if (animDuration == 0 /* book scene */ || keyCount == 1 /* bird */)
 	{
 		if (target == 0) // translation
 		{
-			HostScene::nodePool[nodeIdx]->translation = sampler->vec3Key[0];
-			HostScene::nodePool[nodeIdx]->transformed = true;
+			node->translation = sampler->vec3Key[0];
+			node->transformed = true;
 		}
 		else if (target == 1) // rotation
 		{
-			HostScene::nodePool[nodeIdx]->rotation = sampler->vec4Key[0];
-			HostScene::nodePool[nodeIdx]->transformed = true;
+			node->rotation = sampler->vec4Key[0];
+			node->transformed = true;
 		}
 		else if (target == 2) // scale
 		{
-			HostScene::nodePool[nodeIdx]->scale = sampler->vec3Key[0];
-			HostScene::nodePool[nodeIdx]->transformed = true;
+			node->scale = sampler->vec3Key[0];
+			node->transformed = true;
 		}
 		else // target == 3, weight
 		{
-			int weightCount = (int)HostScene::nodePool[nodeIdx]->weights.size();
+			int weightCount = (int)node->weights.size();
 			for (int i = 0; i < weightCount; i++)
-				HostScene::nodePool[nodeIdx]->weights[i] = sampler->floatKey[0];
-			HostScene::nodePool[nodeIdx]->morphed = true;
+				node->weights[i] = sampler->floatKey[0];
+			node->morphed = true;
 		}
 	}
 	else
 	{
-		while (t >= animDuration) t -= animDuration, k = 0;
-		while (t >= sampler->t[(k + 1) % keyCount]) k++;
-		// determine interpolation parameters
+		// key frame has been determined by HostAnimation::Update
 		assert( k < keyCount - 1 );
 		assert( t >= 0 && t < animDuration );
 		assert( t < sampler->t[k + 1] );
@@ -246,27 +260,27 @@ void HostAnimation::Channel::Update( const float dt, const Sampler* sampler )
 		if (target == 0) // translation
 		{
 			assert( sampler->t.size() == sampler->vec3Key.size() );
-			HostScene::nodePool[nodeIdx]->translation = sampler->SampleVec3( t, k );
-			HostScene::nodePool[nodeIdx]->transformed = true;
+			node->translation = sampler->SampleVec3( t, k );
+			node->transformed = true;
 		}
 		else if (target == 1) // rotation
 		{
 			assert( sampler->t.size() == sampler->vec4Key.size() );
-			HostScene::nodePool[nodeIdx]->rotation = sampler->SampleQuat( t, k );
-			HostScene::nodePool[nodeIdx]->transformed = true;
+			node->rotation = sampler->SampleQuat( t, k );
+			node->transformed = true;
 		}
 		else if (target == 2) // scale
 		{
 			assert( sampler->t.size() == sampler->vec3Key.size() );
-			HostScene::nodePool[nodeIdx]->scale = sampler->SampleVec3( t, k );
-			HostScene::nodePool[nodeIdx]->transformed = true;
+			node->scale = sampler->SampleVec3( t, k );
+			node->transformed = true;
 		}
 		else // target == 3, weight
 		{
-			int weightCount = (int)HostScene::nodePool[nodeIdx]->weights.size();
+			int weightCount = (int)node->weights.size();
 			for (int i = 0; i < weightCount; i++)
-				HostScene::nodePool[nodeIdx]->weights[i] = sampler->SampleFloat( t, k, i, weightCount );
-			HostScene::nodePool[nodeIdx]->morphed = true;
+				node->weights[i] = sampler->SampleFloat( t, k, i, weightCount );
+			node->morphed = true;
 		}
 	}
 }
@@ -275,19 +289,54 @@ void HostAnimation::Channel::Update( const float dt, const Sampler* sampler )
 //  |  HostAnimation::HostAnimation                                               |
 //  |  Constructor.                                                         LH2'19|
 //  +-----------------------------------------------------------------------------+
-HostAnimation::HostAnimation( tinygltfAnimation& gltfAnim, tinygltfModel& gltfModel, const int nodeBase )
+HostAnimation::HostAnimation( HostScene* owner, tinygltfAnimation& gltfAnim, tinygltfModel& gltfModel, const int nodeBase ) : scene( owner )
 {
 	ConvertFromGLTFAnim( gltfAnim, gltfModel, nodeBase );
 }
 
+//  +-----------------------------------------------------------------------------+
+//  |  HostAnimation::HostAnimation                                               |
+//  |  Copy an animation for another instance of the animated node hierarchy,     |
+//  |  which starts nodeOffset slots further in the node pool. The samplers hold  |
+//  |  the key frames and are shared; each copy has its own channels and timers.  |
+//  |                                                                       LH2'21|
+//  +-----------------------------------------------------------------------------+
+HostAnimation::HostAnimation( const HostAnimation& original, const int nodeOffset ) : scene( original.scene )
+{
+	sampler = original.sampler;
+	for (const Channel* source : original.channel)
+	{
+		Channel* copy = new Channel( *source );
+		copy->nodeIdx += nodeOffset;
+		channel.push_back( copy );
+	}
+	duration = original.duration;
+	time.resize( channel.size(), 0 );
+	key.resize( channel.size(), 0 );
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostAnimation::~HostAnimation                                              |
+//  |  Destructor. The samplers are freed with the last copy that uses them.      |
+//  |                                                                       LH2'21|
+//  +-----------------------------------------------------------------------------+
+HostAnimation::~HostAnimation()
+{
+	for (Channel* c : channel) delete c;
+}
+
 //  +-----------------------------------------------------------------------------+
 //  |  HostAnimation::ConvertFromGLTFAnim                                         |
 //  |  Convert a gltf animation.                                            LH2'19|
 //  +-----------------------------------------------------------------------------+
 void HostAnimation::ConvertFromGLTFAnim( tinygltfAnimation& gltfAnim, tinygltfModel& gltfModel, const int nodeBase )
 {
-	for (int i = 0; i < gltfAnim.samplers.size(); i++) sampler.push_back( new Sampler( gltfAnim.samplers[i], gltfModel ) );
+	for (int i = 0; i < gltfAnim.samplers.size(); i++) sampler.push_back( make_shared<Sampler>( gltfAnim.samplers[i], gltfModel ) );
 	for (int i = 0; i < gltfAnim.channels.size(); i++) channel.push_back( new Channel( gltfAnim.channels[i], gltfModel, nodeBase ) );
+	// prepare the channel state arrays
+	time.resize( channel.size(), 0 );
+	key.resize( channel.size(), 0 );
+	for (int i = 0; i < channel.size(); i++) duration.push_back( sampler[channel[i]->samplerIdx]->t.back() );
 }
 
 //  +-----------------------------------------------------------------------------+
@@ -296,16 +345,30 @@ void HostAnimation::ConvertFromGLTFAnim( tinygltfAnimation& gltfAnim, tinygltfMo
 //  +-----------------------------------------------------------------------------+
 void HostAnimation::Reset()
 {
-	for (int i = 0; i < channel.size(); i++) channel[i]->Reset();
+	for (int i = 0; i < channel.size(); i++) time[i] = 0, key[i] = 0;
 }
 
 //  +-----------------------------------------------------------------------------+
 //  |  HostAnimation::Update                                                      |
-//  |  Advance channel animation timers.                                    LH2'19|
+//  |  Advance channel animation timers. The timers and key frames of all         |
+//  |  channels are updated in a single pass over the state arrays; the channels  |
+//  |  are then applied to their nodes.                                     LH2'19|
 //  +-----------------------------------------------------------------------------+
 void HostAnimation::Update( const float dt )
 {
-	for (int i = 0; i < channel.size(); i++) channel[i]->Update( dt, sampler[channel[i]->samplerIdx] );
+	const int channelCount = (int)channel.size();
+	// advance the timers and locate the current key frames
+	for (int i = 0; i < channelCount; i++)
+	{
+		if (duration[i] == 0 /* book scene */) continue;
+		float t = time[i] + dt;
+		if (t >= duration[i] || t < 0) t = fmodf( t, duration[i] );
+		if (t < 0) t += duration[i];
+		time[i] = t;
+		key[i] = sampler[channel[i]->samplerIdx]->FindKey( t, key[i] );
+	}
+	// apply the channels
+	for (int i = 0; i < channelCount; i++) channel[i]->Update( scene->nodePool[channel[i]->nodeIdx], time[i], key[i], sampler[channel[i]->samplerIdx].get() );
 }
 
 // EOF
\ No newline at end of file
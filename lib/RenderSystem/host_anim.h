@@ -20,6 +20,8 @@
 namespace lighthouse2
 {
 
+class HostNode;
+
 //  +-----------------------------------------------------------------------------+
 //  |  HostAnimation                                                              |
 //  |  Host-side animation definition.                                      LH2'19|
@@ -35,11 +37,13 @@ class HostAnimation
 			SPLINE,
 			STEP
 		};
+		Sampler() = default;
 		Sampler( const tinygltfAnimationSampler& gltfSampler, const tinygltfModel& gltfModel );
 		void ConvertFromGLTFSampler( const tinygltfAnimationSampler& gltfSampler, const tinygltfModel& gltfModel );
 		float SampleFloat( float t, int k, int i, int count ) const;
 		float3 SampleVec3( float t, int k ) const;
 		quat SampleQuat( float t, int k ) const;
+		int FindKey( const float time, const int hint ) const;
 		vector<float> t;				// key frame times
 		vector<float3> vec3Key;			// vec3 key frames (location or scale)
 		vector<quat> vec4Key;			// vec4 key frames (rotation)
@@ -49,21 +53,27 @@ class HostAnimation
 	class Channel
 	{
 	public:
+		Channel() = default;
 		Channel( const tinygltfAnimationChannel& gltfChannel, const tinygltfModel& gltfModel, const int nodeBase );
 		int samplerIdx;					// sampler used by this channel
 		int nodeIdx;					// index of the node this channel affects
 		int target;						// 0: translation, 1: rotation, 2: scale, 3: weights
-		void Reset() { t = 0, k = 0; }
-		void Update( const float t, const Sampler* sampler );	// apply this channel to the target nde for time t
+		void Update( HostNode* node, const float t, const int k, const Sampler* sampler );	// apply this channel to the target node for time t, key k
 		void ConvertFromGLTFChannel( const tinygltfAnimationChannel& gltfChannel, const tinygltfModel& gltfModel, const int nodeBase );
-		// data
-		float t = 0;					// animation timer
-		int k = 0;						// current keyframe
 	};
+	friend class HostScene;			// reads and writes samplers and channels for the scene cache
 public:
-	HostAnimation( tinygltfAnimation& gltfAnim, tinygltfModel& gltfModel, const int nodeBase );
-	vector<Sampler*> sampler;		// animation samplers
+	HostAnimation( HostScene* owner ) : scene( owner ) {}
+	HostAnimation( HostScene* owner, tinygltfAnimation& gltfAnim, tinygltfModel& gltfModel, const int nodeBase );
+	HostAnimation( const HostAnimation& original, const int nodeOffset );
+	HostAnimation( const HostAnimation& ) = delete;
+	~HostAnimation();
+	HostScene* scene;				// the scene that holds the animated nodes
+	vector<shared_ptr<Sampler>> sampler;	// animation samplers; shared with the copies of the animation
 	vector<Channel*> channel;		// animation channels
+	vector<float> time;				// per channel: animation timer
+	vector<int> key;				// per channel: current keyframe
+	vector<float> duration;			// per channel: duration of the sampler used by the channel
 	void Reset();					// reset all channels
 	void Update( const float dt );	// advance and apply all channels
 	void ConvertFromGLTFAnim( tinygltfAnimation& gltfAnim, tinygltfModel& gltfModel, const int nodeBase );
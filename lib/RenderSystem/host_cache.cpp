@@ -0,0 +1,474 @@
+/* host_cache.cpp - Copyright 2019/2021 Utrecht University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Binary scene cache. SaveCache writes the processed scene: meshes with
+   all derived data, nodes, materials, textures including MIP maps, skins,
+   animations, lights and the sky. LoadCache maps the file read-only and
+   copies the data arrays into the scene objects; no parsing, image
+   decoding or mesh processing takes place. The mapping is closed once
+   the data has been copied.
+
+   The cache stores the size and modification time of the files it was
+   produced from: every file the loaders read (see AddSourceFile), such as
+   glTF buffers and images, OBJ material libraries, PBRT includes and PLY
+   files, plus the texture files and the sky. LoadCache rejects the cache
+   if any of these changed, if it was written by a different version of
+   this code, or if the layout of the stored structs differs. Typical use:
+
+	  if (!scene->LoadCache( "data/cache/scene.bin" ))
+	  {
+		  scene->AddScene( ... );
+		  scene->SaveCache( "data/cache/scene.bin" );
+	  }
+*/
+
+#include "rendersystem.h"
+#include <filesystem>
+
+// sizes of the structs that are stored as raw bytes; a mismatch invalidates the cache
+static const uint cacheLayout[] = {
+	(uint)sizeof( HostTri ), (uint)sizeof( CoreMaterial ), (uint)sizeof( mat4 ), (uint)sizeof( quat ), (uint)sizeof( uint4 )
+};
+
+//  +-----------------------------------------------------------------------------+
+//  |  SourceStamp                                                                |
+//  |  Size and modification time of a source file, combined into a single        |
+//  |  value. Zero if the file cannot be inspected.                         LH2'21|
+//  +-----------------------------------------------------------------------------+
+uint64_t SourceStamp( const string& fileName )
+{
+	std::error_code error;
+	const uint64_t size = (uint64_t)std::filesystem::file_size( fileName, error );
+	if (error) return 0;
+	const auto modified = std::filesystem::last_write_time( fileName, error );
+	if (error) return 0;
+	return (uint64_t)modified.time_since_epoch().count() * 0x9E3779B97F4A7C15ull + size;
+}
+
+// writing: plain values and arrays of trivially copyable elements
+template <class T> static void Write( FILE* f, const T& value )
+{
+	static_assert(is_trivially_copyable<T>::value, "raw write of a non-trivial type");
+	fwrite( &value, sizeof( T ), 1, f );
+}
+template <class T> static void Write( FILE* f, const vector<T>& values )
+{
+	static_assert(is_trivially_copyable<T>::value, "raw write of a non-trivial type");
+	Write( f, (uint64_t)values.size() );
+	if (values.size() > 0) fwrite( values.data(), sizeof( T ), values.size(), f );
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  CacheReader                                                                |
+//  |  Reads values and arrays from the mapped cache file. Reads past the end of  |
+//  |  the data return zeroes and set 'failed'; array sizes are checked before    |
+//  |  anything is allocated, so a damaged file cannot cause huge allocations.    |
+//  |                                                                       LH2'21|
+//  +-----------------------------------------------------------------------------+
+class CacheReader
+{
+public:
+	CacheReader( const uchar* data, const size_t size ) : pos( data ), end( data + size ) {}
+	bool Fetch( void* dst, const size_t bytes )
+	{
+		if (failed || bytes > (size_t)(end - pos)) { failed = true; memset( dst, 0, bytes ); return false; }
+		memcpy( dst, pos, bytes );
+		pos += bytes;
+		return true;
+	}
+	template <class T> T Read()
+	{
+		static_assert(is_trivially_copyable<T>::value, "raw read of a non-trivial type");
+		T value;
+		Fetch( &value, sizeof( T ) );
+		return value;
+	}
+	template <class T> void Read( T& value ) { value = Read<T>(); }
+	template <class T> void Read( vector<T>& values )
+	{
+		static_assert(is_trivially_copyable<T>::value, "raw read of a non-trivial type");
+		const uint64_t count = Read<uint64_t>();
+		if (failed || count > (uint64_t)(end - pos) / sizeof( T )) { failed = true; values.clear(); return; }
+		values.resize( (size_t)count );
+		Fetch( values.data(), (size_t)count * sizeof( T ) );
+	}
+	void Read( string& value ) // counterpart of SerializeString
+	{
+		const uint length = Read<uint>();
+		if (failed || length > (size_t)(end - pos)) { failed = true; value.clear(); return; }
+		value.assign( (const char*)pos, length );
+		pos += length;
+	}
+	uint Count( const size_t minimumElementSize )
+	{
+		// object count, validated against the remaining data
+		const uint count = Read<uint>();
+		if (failed || count > (size_t)(end - pos) / minimumElementSize) { failed = true; return 0; }
+		return count;
+	}
+	size_t Remaining() const { return (size_t)(end - pos); }
+	bool failed = false;
+private:
+	const uchar* pos;
+	const uchar* end;
+};
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostScene::AddSourceFile                                                   |
+//  |  Record a file that a loader read. SaveCache stores the size and time of    |
+//  |  each of these; a change to any of them invalidates the cache. Files that   |
+//  |  do not exist (e.g. unresolved references) are skipped.               LH2'21|
+//  +-----------------------------------------------------------------------------+
+void HostScene::AddSourceFile( const string& fileName )
+{
+	if (FileExists( fileName.c_str() )) sourceFiles.push_back( fileName );
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostScene::SaveCache                                                       |
+//  |  Write the scene to a binary cache file. The file is written under a        |
+//  |  temporary name and renamed when complete, so processes that load the       |
+//  |  cache concurrently never see a partial file. Texels that were released     |
+//  |  after upload to the core are restored for writing and released again;      |
+//  |  meshes are stored without the triangles they expand on demand.       LH2'21|
+//  +-----------------------------------------------------------------------------+
+void HostScene::SaveCache( const char* cacheFile )
+{
+	const string tmpFile = string( cacheFile ) + ".tmp";
+	FILE* f;
+#ifdef _MSC_VER
+	fopen_s( &f, tmpFile.c_str(), "wb" );
+#else
+	f = fopen( tmpFile.c_str(), "wb" );
+#endif
+	if (!f) { printf( "could not create scene cache %s\n", cacheFile ); return; } // e.g. a read-only data directory
+	// header: version, struct layout, source files
+	Write( f, (uint)SCENECACHEVERSION );
+	for (uint size : cacheLayout) Write( f, size );
+	vector<string> sources = sourceFiles;
+	for (auto texture : textures) if (texture->origin.size() > 0 && FileExists( texture->origin.c_str() )) sources.push_back( texture->origin );
+	if (sky && sky->origin.size() > 0) sources.push_back( sky->origin );
+	sort( sources.begin(), sources.end() );
+	sources.erase( unique( sources.begin(), sources.end() ), sources.end() );
+	Write( f, (uint)sources.size() );
+	for (const string& source : sources) SerializeString( source, f ), Write( f, SourceStamp( source ) );
+	// textures
+	Write( f, (uint)textures.size() );
+	for (auto texture : textures)
+	{
+		const bool released = texture->texelsReleased;
+		texture->RestoreTexels();
+		SerializeString( texture->name, f );
+		SerializeString( texture->origin, f );
+		Write( f, texture->width ), Write( f, texture->height ), Write( f, texture->MIPlevels );
+		Write( f, texture->flags ), Write( f, texture->mods ), Write( f, texture->refCount ), Write( f, texture->bumpScale );
+		const bool hdr = texture->fdata != nullptr;
+		Write( f, (uint)hdr );
+		if (hdr) fwrite( texture->fdata, sizeof( float4 ), texture->PixelsNeeded( texture->width, texture->height, 1 ), f );
+		else fwrite( texture->idata, sizeof( uchar4 ), texture->PixelsNeeded( texture->width, texture->height, MIPLEVELCOUNT ), f );
+		Write( f, texture->encoded );
+		if (released) texture->ReleaseTexels();
+	}
+	// materials: the part that is sent to the cores is stored as-is, like in SynchronizeMaterials
+	Write( f, (uint)materials.size() );
+	for (auto material : materials)
+	{
+		fwrite( material, sizeof( CoreMaterial ), 1, f );
+		SerializeString( material->name, f );
+		SerializeString( material->origin, f );
+		Write( f, material->refCount );
+	}
+	Write( f, (uint)materialCopies.size() );
+	for (auto& copy : materialCopies) Write( f, copy.first ), Write( f, copy.second );
+	// meshes
+	Write( f, (uint)meshPool.size() );
+	for (auto mesh : meshPool)
+	{
+		SerializeString( mesh->name, f );
+		Write( f, mesh->vertices ), Write( f, mesh->triangles );
+		Write( f, mesh->vertexPos ), Write( f, mesh->vertexNormal ), Write( f, mesh->vertexUV0 ), Write( f, mesh->vertexUV1 );
+		Write( f, mesh->vertexAlpha ), Write( f, mesh->indices ), Write( f, mesh->triangleMaterial ), Write( f, mesh->materialList );
+		Write( f, mesh->original ), Write( f, mesh->origNormal ), Write( f, mesh->skinnedPos ), Write( f, mesh->skinnedNormal );
+		Write( f, mesh->skinIndex ), Write( f, mesh->joints ), Write( f, mesh->weights );
+		Write( f, mesh->morphBasePos ), Write( f, mesh->morphBaseNormal ), Write( f, mesh->morphNormal );
+		Write( f, (uint)mesh->morphTargets.size() );
+		for (auto& target : mesh->morphTargets) Write( f, target.index ), Write( f, target.position ), Write( f, target.normal );
+		Write( f, mesh->boundingSphere ), Write( f, mesh->isAnimated ), Write( f, mesh->excludeFromNavmesh );
+		Write( f, mesh->hostDataReleased ), Write( f, mesh->lightBound );
+	}
+	// skins
+	Write( f, (uint)skins.size() );
+	for (auto skin : skins)
+	{
+		SerializeString( skin->name, f );
+		Write( f, skin->skeletonRoot ), Write( f, skin->inverseBindMatrices ), Write( f, skin->jointMat ), Write( f, skin->joints );
+	}
+	// nodes; removed nodes leave an empty slot
+	Write( f, (uint)nodePool.size() );
+	for (auto node : nodePool)
+	{
+		Write( f, (uint)(node != nullptr) );
+		if (!node) continue;
+		SerializeString( node->name, f );
+		Write( f, node->localTransform ), Write( f, node->combinedTransform ), Write( f, node->matrix );
+		Write( f, node->translation ), Write( f, node->rotation ), Write( f, node->scale );
+		Write( f, node->meshID ), Write( f, node->skinID ), Write( f, node->weights ), Write( f, node->childIdx );
+	}
+	Write( f, rootNodes );
+	// animations
+	Write( f, (uint)animations.size() );
+	for (auto anim : animations)
+	{
+		Write( f, (uint)anim->sampler.size() );
+		for (auto& sampler : anim->sampler)
+		{
+			Write( f, sampler->t ), Write( f, sampler->vec3Key ), Write( f, sampler->vec4Key ), Write( f, sampler->floatKey );
+			Write( f, sampler->interpolation );
+		}
+		Write( f, (uint)anim->channel.size() );
+		for (auto channel : anim->channel) Write( f, channel->samplerIdx ), Write( f, channel->nodeIdx ), Write( f, channel->target );
+		Write( f, anim->time ), Write( f, anim->key ), Write( f, anim->duration );
+	}
+	// lights; light triangles are created again for the emissive triangles of the instances
+	Write( f, (uint)pointLights.size() );
+	for (auto light : pointLights) Write( f, light->position ), Write( f, light->radiance ), Write( f, light->enabled );
+	Write( f, (uint)spotLights.size() );
+	for (auto light : spotLights)
+	{
+		Write( f, light->position ), Write( f, light->direction ), Write( f, light->radiance );
+		Write( f, light->cosInner ), Write( f, light->cosOuter ), Write( f, light->enabled );
+	}
+	Write( f, (uint)directionalLights.size() );
+	for (auto light : directionalLights) Write( f, light->direction ), Write( f, light->radiance ), Write( f, light->enabled );
+	// sky
+	Write( f, (uint)(sky != nullptr && sky->pixels != nullptr) );
+	if (sky && sky->pixels)
+	{
+		SerializeString( sky->origin, f );
+		Write( f, sky->width ), Write( f, sky->height ), Write( f, sky->worldToLight );
+		fwrite( sky->pixels, sizeof( float3 ), (size_t)sky->width * sky->height, f );
+		Write( f, (uint)(sky->pdf != nullptr) );
+		if (sky->pdf)
+		{
+			fwrite( sky->pdf, sizeof( float ), IBLWIDTH * IBLHEIGHT, f );
+			fwrite( sky->cdf, sizeof( float ), IBLWIDTH * (IBLHEIGHT + 1), f );
+			fwrite( sky->columncdf, sizeof( float ), IBLWIDTH + 1, f );
+		}
+	}
+	const bool written = ferror( f ) == 0;
+	const bool closed = fclose( f ) == 0;
+	// replace the old cache, unless the new one is incomplete
+	std::error_code error;
+	if (written && closed) std::filesystem::rename( tmpFile, cacheFile, error );
+	if (!written || !closed || error)
+	{
+		printf( "could not replace scene cache %s%s%s\n", cacheFile, error ? ": " : "", error ? error.message().c_str() : "" );
+		std::filesystem::remove( tmpFile, error );
+	}
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostScene::LoadCache                                                       |
+//  |  Load a scene written by SaveCache into this (empty) scene. Returns false   |
+//  |  if the file is absent, outdated or damaged; the scene is then left         |
+//  |  untouched, and the caller is expected to load the sources and save a new   |
+//  |  cache.                                                               LH2'21|
+//  +-----------------------------------------------------------------------------+
+bool HostScene::LoadCache( const char* cacheFile )
+{
+	FATALERROR_IF( nodePool.size() > 0 || meshPool.size() > 0 || materials.size() > 0 || textures.size() > 0,
+		"Scene cache %s can only be loaded into an empty scene", cacheFile );
+	MappedFile file( cacheFile );
+	if (!file.IsOpen()) return false;
+	CacheReader in( file.data, file.size );
+	// validate the header
+	if (in.Read<uint>() != SCENECACHEVERSION) return false;
+	for (uint size : cacheLayout) if (in.Read<uint>() != size) return false;
+	vector<string> sources( in.Count( 12 ) );
+	for (string& source : sources)
+	{
+		in.Read( source );
+		const uint64_t stamp = in.Read<uint64_t>();
+		if (in.failed || stamp == 0 || SourceStamp( source ) != stamp) return false;
+	}
+	// textures
+	textures.resize( in.Count( 40 ) );
+	for (int s = (int)textures.size(), i = 0; i < s; i++)
+	{
+		HostTexture* texture = textures[i] = new HostTexture();
+		texture->ID = i;
+		in.Read( texture->name ), in.Read( texture->origin );
+		in.Read( texture->width ), in.Read( texture->height ), in.Read( texture->MIPlevels );
+		in.Read( texture->flags ), in.Read( texture->mods ), in.Read( texture->refCount ), in.Read( texture->bumpScale );
+		const bool hdr = in.Read<uint>() != 0;
+		const size_t bytes = hdr ? texture->PixelsNeeded( texture->width, texture->height, 1 ) * sizeof( float4 ) :
+			texture->PixelsNeeded( texture->width, texture->height, MIPLEVELCOUNT ) * sizeof( uchar4 );
+		if (in.failed || texture->width > 65536 || texture->height > 65536 || bytes > in.Remaining()) { in.failed = true; break; }
+		if (hdr) texture->fdata = (float4*)MALLOC64( bytes ); else texture->idata = (uchar4*)MALLOC64( bytes );
+		in.Fetch( hdr ? (void*)texture->fdata : (void*)texture->idata, bytes );
+		in.Read( texture->encoded );
+	}
+	// materials
+	materials.resize( in.Count( sizeof( CoreMaterial ) ) );
+	for (int s = (int)materials.size(), i = 0; i < s; i++)
+	{
+		HostMaterial* material = materials[i] = new HostMaterial();
+		in.Fetch( material, sizeof( CoreMaterial ) );
+		in.Read( material->name ), in.Read( material->origin ), in.Read( material->refCount );
+		material->ID = i;
+	}
+	for (int s = in.Count( 12 ), i = 0; i < s; i++)
+	{
+		const uint64_t key = in.Read<uint64_t>();
+		materialCopies[key] = in.Read<int>();
+	}
+	// meshes
+	meshPool.resize( in.Count( 8 ) );
+	for (int s = (int)meshPool.size(), i = 0; i < s; i++)
+	{
+		HostMesh* mesh = meshPool[i] = new HostMesh();
+		mesh->scene = this;
+		mesh->ID = i;
+		in.Read( mesh->name );
+		in.Read( mesh->vertices ), in.Read( mesh->triangles );
+		in.Read( mesh->vertexPos ), in.Read( mesh->vertexNormal ), in.Read( mesh->vertexUV0 ), in.Read( mesh->vertexUV1 );
+		in.Read( mesh->vertexAlpha ), in.Read( mesh->indices ), in.Read( mesh->triangleMaterial ), in.Read( mesh->materialList );
+		in.Read( mesh->original ), in.Read( mesh->origNormal ), in.Read( mesh->skinnedPos ), in.Read( mesh->skinnedNormal );
+		in.Read( mesh->skinIndex ), in.Read( mesh->joints ), in.Read( mesh->weights );
+		in.Read( mesh->morphBasePos ), in.Read( mesh->morphBaseNormal ), in.Read( mesh->morphNormal );
+		mesh->morphTargets.resize( in.Count( 24 ) );
+		for (auto& target : mesh->morphTargets) in.Read( target.index ), in.Read( target.position ), in.Read( target.normal );
+		in.Read( mesh->boundingSphere ), in.Read( mesh->isAnimated ), in.Read( mesh->excludeFromNavmesh );
+		in.Read( mesh->hostDataReleased ), in.Read( mesh->lightBound );
+	}
+	// skins
+	skins.resize( in.Count( 8 ) );
+	for (auto& skin : skins)
+	{
+		skin = new HostSkin();
+		in.Read( skin->name );
+		in.Read( skin->skeletonRoot ), in.Read( skin->inverseBindMatrices ), in.Read( skin->jointMat ), in.Read( skin->joints );
+	}
+	// nodes
+	nodePool.resize( in.Count( 4 ), nullptr );
+	for (int s = (int)nodePool.size(), i = 0; i < s; i++)
+	{
+		if (!in.Read<uint>()) { freeNodeSlots.push_back( i ); continue; }
+		HostNode* node = nodePool[i] = new HostNode();
+		node->scene = this;
+		node->ID = i;
+		in.Read( node->name );
+		in.Read( node->localTransform ), in.Read( node->combinedTransform ), in.Read( node->matrix );
+		in.Read( node->translation ), in.Read( node->rotation ), in.Read( node->scale );
+		in.Read( node->meshID ), in.Read( node->skinID ), in.Read( node->weights ), in.Read( node->childIdx );
+		if (node->meshID >= (int)meshPool.size() || node->skinID >= (int)skins.size()) in.failed = true;
+		for (int child : node->childIdx) if (child < 0 || child >= s) in.failed = true;
+	}
+	in.Read( rootNodes );
+	for (int node : rootNodes) if (node < 0 || node >= (int)nodePool.size() || !nodePool[node]) in.failed = true;
+	// animations
+	animations.resize( in.Count( 4 ) );
+	for (auto& anim : animations)
+	{
+		anim = new HostAnimation( this );
+		anim->sampler.resize( in.Count( 36 ) );
+		for (auto& sampler : anim->sampler)
+		{
+			sampler = make_shared<HostAnimation::Sampler>();
+			in.Read( sampler->t ), in.Read( sampler->vec3Key ), in.Read( sampler->vec4Key ), in.Read( sampler->floatKey );
+			in.Read( sampler->interpolation );
+		}
+		anim->channel.resize( in.Count( 12 ) );
+		for (auto& channel : anim->channel)
+		{
+			channel = new HostAnimation::Channel();
+			in.Read( channel->samplerIdx ), in.Read( channel->nodeIdx ), in.Read( channel->target );
+		}
+		in.Read( anim->time ), in.Read( anim->key ), in.Read( anim->duration );
+	}
+	// lights
+	pointLights.resize( in.Count( 28 ) );
+	for (int s = (int)pointLights.size(), i = 0; i < s; i++)
+	{
+		HostPointLight* light = pointLights[i] = new HostPointLight();
+		in.Read( light->position ), in.Read( light->radiance ), in.Read( light->enabled );
+		light->ID = i;
+	}
+	spotLights.resize( in.Count( 48 ) );
+	for (int s = (int)spotLights.size(), i = 0; i < s; i++)
+	{
+		HostSpotLight* light = spotLights[i] = new HostSpotLight();
+		in.Read( light->position ), in.Read( light->direction ), in.Read( light->radiance );
+		in.Read( light->cosInner ), in.Read( light->cosOuter ), in.Read( light->enabled );
+		light->ID = i;
+	}
+	directionalLights.resize( in.Count( 28 ) );
+	for (int s = (int)directionalLights.size(), i = 0; i < s; i++)
+	{
+		HostDirectionalLight* light = directionalLights[i] = new HostDirectionalLight();
+		in.Read( light->direction ), in.Read( light->radiance ), in.Read( light->enabled );
+		light->ID = i;
+	}
+	// sky
+	HostSkyDome* cachedSky = nullptr;
+	if (in.Read<uint>())
+	{
+		cachedSky = new HostSkyDome();
+		in.Read( cachedSky->origin );
+		in.Read( cachedSky->width ), in.Read( cachedSky->height ), in.Read( cachedSky->worldToLight );
+		const size_t bytes = (size_t)max( cachedSky->width, 0 ) * max( cachedSky->height, 0 ) * sizeof( float3 );
+		if (bytes > in.Remaining()) in.failed = true; else
+		{
+			cachedSky->pixels = (float3*)MALLOC64( bytes );
+			in.Fetch( cachedSky->pixels, bytes );
+		}
+		if (in.Read<uint>())
+		{
+			cachedSky->pdf = (float*)MALLOC64( IBLWIDTH * IBLHEIGHT * sizeof( float ) );
+			cachedSky->cdf = (float*)MALLOC64( IBLWIDTH * (IBLHEIGHT + 1) * sizeof( float ) );
+			cachedSky->columncdf = (float*)MALLOC64( (IBLWIDTH + 1) * sizeof( float ) );
+			in.Fetch( cachedSky->pdf, IBLWIDTH * IBLHEIGHT * sizeof( float ) );
+			in.Fetch( cachedSky->cdf, IBLWIDTH * (IBLHEIGHT + 1) * sizeof( float ) );
+			in.Fetch( cachedSky->columncdf, (IBLWIDTH + 1) * sizeof( float ) );
+		}
+	}
+	if (in.failed)
+	{
+		// damaged file (e.g. truncated): discard what was read, so the caller loads the sources instead
+		printf( "scene cache %s is damaged\n", cacheFile );
+		for (auto node : nodePool) delete node;
+		for (auto anim : animations) delete anim;
+		for (auto skin : skins) delete skin;
+		for (auto light : pointLights) delete light;
+		for (auto light : spotLights) delete light;
+		for (auto light : directionalLights) delete light;
+		for (auto mesh : meshPool) delete mesh;
+		for (auto material : materials) delete material;
+		for (auto texture : textures) delete texture;
+		delete cachedSky;
+		nodePool.clear(), freeNodeSlots.clear(), rootNodes.clear(), animations.clear(), skins.clear();
+		pointLights.clear(), spotLights.clear(), directionalLights.clear();
+		meshPool.clear(), materials.clear(), materialCopies.clear(), textures.clear();
+		return false;
+	}
+	if (cachedSky) delete sky, sky = cachedSky;
+	// restore the derived state: node slots, root nodes, light triangles
+	SyncNodeSlots();
+	for (int s = (int)rootNodes.size(), i = 0; i < s; i++) rootNodeIdx[rootNodes[i]] = i;
+	for (auto node : nodePool) if (node) node->PrepareLights();
+	sourceFiles = sources;
+	return true;
+}
+
+// EOF
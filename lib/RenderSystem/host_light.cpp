@@ -22,7 +22,7 @@
 //  |  - For efficient sampling, we store the vertices, normal and radiace;       |
 //  |  - For MIS, we store the original triangle (idx and instance idx).    LH2'20|
 //  +-----------------------------------------------------------------------------+
-HostTriLight::HostTriLight( HostTri* origTri, int origIdx, int origInstance )
+HostTriLight::HostTriLight( HostTri* origTri, int origIdx, int origInstance, const float3 emission )
 {
 	triIdx = origIdx;
 	instIdx = origInstance;
@@ -36,7 +36,7 @@ HostTriLight::HostTriLight( HostTri* origTri, int origIdx, int origInstance )
 	const float c = length( vertex0 - vertex2 );
 	const float s = (a + b + c) * 0.5f;
 	area = sqrtf( s * (s - a) * (s - b) * (s - c) ); // Heron's formula
-	radiance = HostScene::materials[origTri->material]->color();
+	radiance = emission;
 	const float3 E = radiance * area;
 	energy = E.x + E.y + E.z;
 }
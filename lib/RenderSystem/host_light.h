@@ -27,7 +27,7 @@ class HostTriLight
 public:
 	// constructor / destructor
 	HostTriLight() = default;
-	HostTriLight( HostTri* origTri, int origIdx, int origInstance );
+	HostTriLight( HostTri* origTri, int origIdx, int origInstance, const float3 emission );
 	// methods
 	CoreLightTri ConvertToCoreLightTri();
 	// data members
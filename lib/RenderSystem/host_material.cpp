@@ -30,10 +30,16 @@
 
 //  +-----------------------------------------------------------------------------+
 //  |  HostMaterial::ConvertFrom                                                  |
-//  |  Converts a tinyobjloader material to a HostMaterial.                 LH2'19|
+//  |  Converts a tinyobjloader material to a HostMaterial. Textures are added to |
+//  |  the specified scene; relative texture paths are relative to 'dir', the     |
+//  |  directory of the material library.                                   LH2'19|
 //  +-----------------------------------------------------------------------------+
-void HostMaterial::ConvertFrom( const tinyobjMaterial& original )
+void HostMaterial::ConvertFrom( const tinyobjMaterial& original, const char* dir, HostScene* scene )
 {
+	auto path = [dir]( const string& texname ) {
+		const bool absolute = texname[0] == '/' || texname[0] == '\\' || (texname.size() > 1 && texname[1] == ':');
+		return absolute ? texname : string( dir ) + "/" + texname;
+	};
 	// properties
 	name = original.name;
 	color.value = make_float3( original.diffuse[0], original.diffuse[1], original.diffuse[2] ); // Kd
@@ -43,26 +49,26 @@ void HostMaterial::ConvertFrom( const tinyobjMaterial& original )
 	// maps
 	if (original.diffuse_texname != "")
 	{
-		int diffuseTextureID = color.textureID = HostScene::FindOrCreateTexture( original.diffuse_texname, HostTexture::LINEARIZED | HostTexture::FLIPPED );
+		int diffuseTextureID = color.textureID = scene->FindOrCreateTexture( path( original.diffuse_texname ), HostTexture::LINEARIZED | HostTexture::FLIPPED );
 		color.value = make_float3( 1 ); // we have a texture now; default modulation to white
 	}
 	if (original.normal_texname != "")
 	{
-		normals.textureID = HostScene::FindOrCreateTexture( original.normal_texname, HostTexture::FLIPPED );
-		HostScene::textures[normals.textureID]->flags |= HostTexture::NORMALMAP; // TODO: what if it's also used as regular texture?
+		normals.textureID = scene->FindOrCreateTexture( path( original.normal_texname ), HostTexture::FLIPPED );
+		scene->textures[normals.textureID]->flags |= HostTexture::NORMALMAP; // TODO: what if it's also used as regular texture?
 	}
 	else if (original.bump_texname != "")
 	{
-		int bumpMapID = normals.textureID = HostScene::CreateTexture( original.bump_texname, HostTexture::FLIPPED ); // cannot reuse, height scale may differ
+		int bumpMapID = normals.textureID = scene->CreateTexture( path( original.bump_texname ), HostTexture::FLIPPED ); // cannot reuse, height scale may differ
 		float heightScaler = 1.0f;
 		auto heightScalerIt = original.unknown_parameter.find( "bump_height" );
 		if (heightScalerIt != original.unknown_parameter.end()) heightScaler = static_cast<float>(atof( (*heightScalerIt).second.c_str() ));
-		HostScene::textures[bumpMapID]->BumpToNormalMap( heightScaler );
-		HostScene::textures[bumpMapID]->flags |= HostTexture::NORMALMAP; // TODO: what if it's also used as regular texture?
+		scene->textures[bumpMapID]->BumpToNormalMap( heightScaler );
+		scene->textures[bumpMapID]->flags |= HostTexture::NORMALMAP; // TODO: what if it's also used as regular texture?
 	}
 	if (original.specular_texname != "")
 	{
-		roughness.textureID = HostScene::FindOrCreateTexture( original.specular_texname.c_str(), HostTexture::FLIPPED );
+		roughness.textureID = scene->FindOrCreateTexture( path( original.specular_texname ), HostTexture::FLIPPED );
 		roughness() = 1.0f;
 	}
 	// finalize
@@ -74,7 +80,7 @@ void HostMaterial::ConvertFrom( const tinyobjMaterial& original )
 //  |  HostMaterial::ConvertFrom                                                  |
 //  |  Converts a tinygltf material to a HostMaterial.                      LH2'19|
 //  +-----------------------------------------------------------------------------+
-void HostMaterial::ConvertFrom( const tinygltfMaterial& original, const tinygltfModel& model, const vector<int>& texIdx )
+void HostMaterial::ConvertFrom( const tinygltfMaterial& original, const tinygltfModel& model, const vector<int>& texIdx, HostScene* scene )
 {
 	name = original.name;
 	flags |= HostMaterial::FROM_MTL; // this material will be serialized on exit.
@@ -84,7 +90,7 @@ void HostMaterial::ConvertFrom( const tinygltfMaterial& original, const tinygltf
 		// note: may be overwritten by the "normalTexture" field in additionalValues.
 		normals.textureID = texIdx[original.normalTexture.index];
 		normals.scale = original.normalTexture.scale;
-		HostScene::textures[normals.textureID]->flags |= HostTexture::NORMALMAP;
+		scene->textures[normals.textureID]->flags |= HostTexture::NORMALMAP;
 	}
 	// process values list
 	for (const auto& value : original.values)
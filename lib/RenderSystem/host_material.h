@@ -18,6 +18,8 @@
 namespace lighthouse2
 {
 
+class HostScene;
+
 //  +-----------------------------------------------------------------------------+
 //  |  HostMaterial                                                               |
 //  |  Host-side material definition.                                       LH2'19|
@@ -77,8 +79,8 @@ public:
 	HostMaterial() = default;
 
 	// methods
-	void ConvertFrom( const tinyobjMaterial& );
-	void ConvertFrom( const tinygltfMaterial&, const tinygltfModel&, const vector<int>& texIdx );
+	void ConvertFrom( const tinyobjMaterial&, const char* dir, HostScene* scene );
+	void ConvertFrom( const tinygltfMaterial&, const tinygltfModel&, const vector<int>& texIdx, HostScene* scene );
 	bool IsEmissive() { float3& c = color(); return c.x > 1 || c.y > 1 || c.z > 1; /* ignores vec3map */ }
 
 	// START OF DATA THAT WILL BE COPIED TO COREMATERIAL
@@ -157,6 +159,7 @@ public:
 private:
 	uint prevFlags = SMOOTH;					// initially identical to flags
 	TRACKCHANGES;								// add Changed(), MarkAsDirty() methods, see system.h
+	POOLALLOCATED( HostMaterial );				// allocate from a type-specific pool, see system.h
 };
 
 } // namespace lighthouse2
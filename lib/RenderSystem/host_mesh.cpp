@@ -14,13 +14,8 @@
 */
 
 #include "rendersystem.h"
-#ifdef _MSC_VER
-#include <direct.h>
-#define getcwd _getcwd
-#define chdir _chdir
-#else
-#include <unistd.h>
-#endif
+
+#define OBJ_BATCH 4096 // triangles or vertices per OBJ processing task
 
 using namespace tinygltf;
 
@@ -75,12 +70,12 @@ HostMesh::HostMesh( const int triCount )
 	vertices.resize( triCount * 3 );
 }
 
-HostMesh::HostMesh( const char* file, const char* dir, const float scale, const bool flatShaded )
+HostMesh::HostMesh( HostScene* owner, const char* file, const char* dir, const float scale, const bool flatShaded ) : scene( owner )
 {
 	LoadGeometry( file, dir, scale, flatShaded );
 }
 
-HostMesh::HostMesh( const tinygltfMesh& gltfMesh, const tinygltfModel& gltfModel, const vector<int>& matIdx, const int materialOverride )
+HostMesh::HostMesh( HostScene* owner, const tinygltfMesh& gltfMesh, const tinygltfModel& gltfModel, const vector<int>& matIdx, const int materialOverride ) : scene( owner )
 {
 	ConvertFromGTLFMesh( gltfMesh, gltfModel, matIdx, materialOverride );
 }
@@ -126,139 +121,119 @@ void HostMesh::LoadGeometry( const char* file, const char* dir, const float scal
 
 //  +-----------------------------------------------------------------------------+
 //  |  HostMesh::LoadGeometryFromObj                                              |
-//  |  Load an obj file using tinyobj.                                      LH2'19|
+//  |  Load an obj file using the parallel OBJParser, and build the triangle      |
+//  |  data on the worker pool. Texture paths are resolved relative to the        |
+//  |  directory of the file, so loads in different threads do not interfere.     |
+//  |                                                                       LH2'19|
 //  +-----------------------------------------------------------------------------+
 void HostMesh::LoadGeometryFromOBJ( const string& fileName, const char* directory, const mat4& transform, const bool flatShaded )
 {
 	// load obj file
-	tinyobj::attrib_t attrib;
-	vector<tinyobj::shape_t> shapes;
-	vector<tinyobj::material_t> materials;
-	map<string, GLuint> textures;
-	string err, warn;
+	OBJParser obj;
 	Timer timer;
 	timer.reset();
-	tinyobj::LoadObj( &attrib, &shapes, &materials, &err, &warn, fileName.c_str(), directory );
-	FATALERROR_IF( err.size() > 0 || shapes.size() == 0, "tinyobj failed to load %s: %s", fileName.c_str(), err.c_str() );
+	const bool loaded = obj.Parse( fileName.c_str(), directory );
+	FATALERROR_IF( !loaded || obj.materialIds.size() == 0, "failed to load %s: %s", fileName.c_str(), loaded ? "no faces" : obj.error.c_str() );
+	if (scene) for (const string& library : obj.libraryFiles) scene->AddSourceFile( library );
 	printf( "loaded mesh in %5.3fs\n", timer.elapsed() );
 	// material offset: if we loaded an object before this one, material indices should not start at 0.
-	int matIdxOffset = (int)HostScene::materials.size();
+	int matIdxOffset = (int)scene->materials.size();
 	// process materials
 	timer.reset();
-	char currDir[1024];
-	getcwd( currDir, 1024 ); // GetCurrentDirectory( 1024, currDir );
-	chdir( directory ); // SetCurrentDirectory( directory );
 	materialList.clear();
-	materialList.reserve( materials.size() );
-	for (auto& mtl : materials)
+	materialList.reserve( obj.materials.size() );
+	for (auto& mtl : obj.materials)
 	{
 		// initialize
 		HostMaterial* material = new HostMaterial();
-		material->ID = (int)HostScene::materials.size();
+		material->ID = (int)scene->materials.size();
 		material->origin = fileName;
-		material->ConvertFrom( mtl );
+		material->ConvertFrom( mtl, directory, scene );
 		material->flags |= HostMaterial::FROM_MTL;
 		material->MarkAsDirty();
-		HostScene::materials.push_back( material );
+		scene->materials.push_back( material );
 		materialList.push_back( material->ID );
 	}
-	chdir( currDir ); // SetCurrentDirectory( currDir );
 	printf( "materials finalized in %5.3fs\n", timer.elapsed() );
+	const int triCount = (int)obj.materialIds.size();
+	const int3* corners = obj.corners.data();
 	// calculate values for consistent normal interpolation
-	const uint verts = (uint)attrib.normals.size() / 3;
+	const int verts = (int)obj.normals.size();
 	vector<float> alphas;
 	timer.reset();
 	alphas.resize( verts, 1.0f ); // we will have one alpha value per unique vertex normal
-	for (uint s = (uint)shapes.size(), i = 0; i < s; i++)
+	if (!flatShaded)
 	{
-		vector<tinyobj::index_t>& indices = shapes[i].mesh.indices;
-		if (flatShaded) for (uint s = (uint)indices.size(), f = 0; f < s; f++) alphas[indices[f].normal_index] = 1; else
-			for (uint s = (uint)indices.size(), f = 0; f < s; f += 3)
+		// per triangle corner: cosine of the angle between vertex normal and face normal
+		vector<float> cornerDots( triCount * 3, 1.0f );
+		ParallelBatches( triCount, OBJ_BATCH, [&]( const int first, const int last ) {
+			for (int f = first; f < last; f++)
 			{
-				const int idx0 = indices[f + 0].vertex_index, nidx0 = indices[f + 0].normal_index;
-				const int idx1 = indices[f + 1].vertex_index, nidx1 = indices[f + 1].normal_index;
-				const int idx2 = indices[f + 2].vertex_index, nidx2 = indices[f + 2].normal_index;
-				const float3 vert0 = make_float3( attrib.vertices[idx0 * 3 + 0], attrib.vertices[idx0 * 3 + 1], attrib.vertices[idx0 * 3 + 2] );
-				const float3 vert1 = make_float3( attrib.vertices[idx1 * 3 + 0], attrib.vertices[idx1 * 3 + 1], attrib.vertices[idx1 * 3 + 2] );
-				const float3 vert2 = make_float3( attrib.vertices[idx2 * 3 + 0], attrib.vertices[idx2 * 3 + 1], attrib.vertices[idx2 * 3 + 2] );
+				const int3* c = corners + f * 3;
+				if (c[0].z == -1) continue;
+				const float3 vert0 = obj.positions[c[0].x], vert1 = obj.positions[c[1].x], vert2 = obj.positions[c[2].x];
+				const float3 vN0 = obj.normals[c[0].z], vN1 = obj.normals[c[1].z], vN2 = obj.normals[c[2].z];
 				float3 N = normalize( cross( vert1 - vert0, vert2 - vert0 ) );
-				float3 vN0, vN1, vN2;
-				if (nidx0 > -1)
-				{
-					vN0 = make_float3( attrib.normals[nidx0 * 3 + 0], attrib.normals[nidx0 * 3 + 1], attrib.normals[nidx0 * 3 + 2] );
-					vN1 = make_float3( attrib.normals[nidx1 * 3 + 0], attrib.normals[nidx1 * 3 + 1], attrib.normals[nidx1 * 3 + 2] );
-					vN2 = make_float3( attrib.normals[nidx2 * 3 + 0], attrib.normals[nidx2 * 3 + 1], attrib.normals[nidx2 * 3 + 2] );
 				if (dot( N, vN0 ) < 0 && dot( N, vN1 ) < 0 && dot( N, vN2 ) < 0) N *= -1.0f; // flip if not consistent with vertex normals
-				alphas[nidx0] = min( alphas[nidx0], max( 0.7f, dot( vN0, N ) ) );
-				alphas[nidx1] = min( alphas[nidx1], max( 0.7f, dot( vN1, N ) ) );
-				alphas[nidx2] = min( alphas[nidx2], max( 0.7f, dot( vN2, N ) ) );
-			}
-				else
-				{
-					vN0 = vN1 = vN2 = N;
-				}
+				cornerDots[f * 3 + 0] = max( 0.7f, dot( vN0, N ) );
+				cornerDots[f * 3 + 1] = max( 0.7f, dot( vN1, N ) );
+				cornerDots[f * 3 + 2] = max( 0.7f, dot( vN2, N ) );
 			}
+		} );
+		// per unique vertex normal: the smallest of these; serial, as corners share normals
+		for (int i = 0; i < triCount * 3; i++) if (corners[i].z > -1) alphas[corners[i].z] = min( alphas[corners[i].z], cornerDots[i] );
 	}
 	// finalize alpha values based on max dots
 	const float w = 0.03632f;
-	for (uint i = 0; i < verts; i++)
-	{
-		const float nnv = alphas[i]; // temporarily stored there
-		alphas[i] = acosf( nnv ) * (1 + w * (1 - nnv) * (1 - nnv));
-	}
+	ParallelBatches( verts, OBJ_BATCH, [&]( const int first, const int last ) {
+		for (int i = first; i < last; i++)
+		{
+			const float nnv = alphas[i]; // temporarily stored there
+			alphas[i] = acosf( nnv ) * (1 + w * (1 - nnv) * (1 - nnv));
+		}
+	} );
 	printf( "calculated vertex alphas in %5.3fs\n", timer.elapsed() );
 	// extract data for ray tracing: raw vertex and index data
 	aabb sceneBounds;
-	int toReserve = 0;
+	mutex boundsMutex;
 	timer.reset();
-	for (auto& shape : shapes) toReserve += (int)shape.mesh.indices.size();
-	vertices.reserve( toReserve );
-	for (auto& shape : shapes) for (int f = 0; f < shape.mesh.indices.size(); f += 3)
-	{
-		const uint idx0 = shape.mesh.indices[f + 0].vertex_index;
-		const uint idx1 = shape.mesh.indices[f + 1].vertex_index;
-		const uint idx2 = shape.mesh.indices[f + 2].vertex_index;
-		const float3 v0 = make_float3( attrib.vertices[idx0 * 3 + 0], attrib.vertices[idx0 * 3 + 1], attrib.vertices[idx0 * 3 + 2] );
-		const float3 v1 = make_float3( attrib.vertices[idx1 * 3 + 0], attrib.vertices[idx1 * 3 + 1], attrib.vertices[idx1 * 3 + 2] );
-		const float3 v2 = make_float3( attrib.vertices[idx2 * 3 + 0], attrib.vertices[idx2 * 3 + 1], attrib.vertices[idx2 * 3 + 2] );
-		const float4 tv0 = make_float4( v0, 1 ) * transform;
-		const float4 tv1 = make_float4( v1, 1 ) * transform;
-		const float4 tv2 = make_float4( v2, 1 ) * transform;
-		vertices.push_back( tv0 );
-		vertices.push_back( tv1 );
-		vertices.push_back( tv2 );
-		sceneBounds.Grow( make_float3( tv0 ) );
-		sceneBounds.Grow( make_float3( tv1 ) );
-		sceneBounds.Grow( make_float3( tv2 ) );
-	}
+	vertices.resize( triCount * 3 );
+	ParallelBatches( triCount, OBJ_BATCH, [&]( const int first, const int last ) {
+		aabb bounds;
+		for (int i = first * 3; i < last * 3; i++)
+		{
+			vertices[i] = make_float4( obj.positions[corners[i].x], 1 ) * transform;
+			bounds.Grow( make_float3( vertices[i] ) );
+		}
+		lock_guard<mutex> lock( boundsMutex );
+		sceneBounds.Grow( bounds );
+	} );
 	printf( "created polygon soup for %i triangles in %5.3fs\n", (int)vertices.size() / 3, timer.elapsed() );
 	printf( "scene bounds: (%5.2f,%5.2f,%5.2f)-(%5.2f,%5.2f,%5.2f)\n",
 		sceneBounds.bmin3.x, sceneBounds.bmin3.y, sceneBounds.bmin3.z,
 		sceneBounds.bmax3.x, sceneBounds.bmax3.y, sceneBounds.bmax3.z );
 	// extract full model data and materials
 	timer.reset();
-	triangles.resize( vertices.size() / 3 );
-	for (int s = (int)shapes.size(), face = 0, i = 0; i < s; i++)
-	{
-		vector<tinyobj::index_t>& indices = shapes[i].mesh.indices;
-		for (int s = (int)shapes[i].mesh.indices.size(), f = 0; f < s; f += 3, face++)
+	triangles.resize( triCount );
+	ParallelBatches( triCount, OBJ_BATCH, [&]( const int first, const int last ) {
+		for (int face = first; face < last; face++)
 		{
 			HostTri& tri = triangles[face];
 			tri.vertex0 = make_float3( vertices[face * 3 + 0] );
 			tri.vertex1 = make_float3( vertices[face * 3 + 1] );
 			tri.vertex2 = make_float3( vertices[face * 3 + 2] );
-			const int tidx0 = indices[f + 0].texcoord_index, nidx0 = indices[f + 0].normal_index, idx0 = indices[f + 0].vertex_index;
-			const int tidx1 = indices[f + 1].texcoord_index, nidx1 = indices[f + 1].normal_index, idx1 = indices[f + 1].vertex_index;
-			const int tidx2 = indices[f + 2].texcoord_index, nidx2 = indices[f + 2].normal_index, idx2 = indices[f + 2].vertex_index;
+			const int tidx0 = corners[face * 3 + 0].y, nidx0 = corners[face * 3 + 0].z;
+			const int tidx1 = corners[face * 3 + 1].y, nidx1 = corners[face * 3 + 1].z;
+			const int tidx2 = corners[face * 3 + 2].y, nidx2 = corners[face * 3 + 2].z;
 			const float3 e1 = tri.vertex1 - tri.vertex0;
 			const float3 e2 = tri.vertex2 - tri.vertex0;
 			float3 N = normalize( cross( e1, e2 ) );
 			if (nidx0 > -1)
 			{
-			tri.vN0 = make_float3( attrib.normals[nidx0 * 3 + 0], attrib.normals[nidx0 * 3 + 1], attrib.normals[nidx0 * 3 + 2] );
-			tri.vN1 = make_float3( attrib.normals[nidx1 * 3 + 0], attrib.normals[nidx1 * 3 + 1], attrib.normals[nidx1 * 3 + 2] );
-			tri.vN2 = make_float3( attrib.normals[nidx2 * 3 + 0], attrib.normals[nidx2 * 3 + 1], attrib.normals[nidx2 * 3 + 2] );
-			if (dot( N, tri.vN0 ) < 0) N *= -1.0f; // flip face normal if not consistent with vertex normal
+				tri.vN0 = obj.normals[nidx0];
+				tri.vN1 = obj.normals[nidx1];
+				tri.vN2 = obj.normals[nidx2];
+				if (dot( N, tri.vN0 ) < 0) N *= -1.0f; // flip face normal if not consistent with vertex normal
 			}
 			else
 			{
@@ -267,9 +242,9 @@ void HostMesh::LoadGeometryFromOBJ( const string& fileName, const char* director
 			if (flatShaded) tri.vN0 = tri.vN1 = tri.vN2 = N;
 			if (tidx0 > -1)
 			{
-				tri.u0 = attrib.texcoords[tidx0 * 2 + 0], tri.v0 = attrib.texcoords[tidx0 * 2 + 1];
-				tri.u1 = attrib.texcoords[tidx1 * 2 + 0], tri.v1 = attrib.texcoords[tidx1 * 2 + 1];
-				tri.u2 = attrib.texcoords[tidx2 * 2 + 0], tri.v2 = attrib.texcoords[tidx2 * 2 + 1];
+				tri.u0 = obj.uvs[tidx0].x, tri.v0 = obj.uvs[tidx0].y;
+				tri.u1 = obj.uvs[tidx1].x, tri.v1 = obj.uvs[tidx1].y;
+				tri.u2 = obj.uvs[tidx2].x, tri.v2 = obj.uvs[tidx2].y;
 				// calculate tangent vectors
 				float2 uv01 = make_float2( tri.u1 - tri.u0, tri.v1 - tri.v0 );
 				float2 uv02 = make_float2( tri.u2 - tri.u0, tri.v2 - tri.v0 );
@@ -290,33 +265,25 @@ void HostMesh::LoadGeometryFromOBJ( const string& fileName, const char* director
 				tri.B = normalize( cross( N, tri.T ) );
 			}
 			tri.Nx = N.x, tri.Ny = N.y, tri.Nz = N.z;
-			tri.material = shapes[i].mesh.material_ids[f / 3] + matIdxOffset;
-		#if 0
-			const float a = (tri.vertex1 - tri.vertex0).length();
-			const float b = (tri.vertex2 - tri.vertex1).length();
-			const float c = (tri.vertex0 - tri.vertex2).length();
-			const float s = (a + b + c) * 0.5f;
-			tri.area = sqrtf( s * (s - a) * (s - b) * (s - c) ); // Heron's formula
-		#else
+			tri.material = obj.materialIds[face] + matIdxOffset;
 			tri.area = 0; // we don't actually use it, except for lights, where it is also calculated
-		#endif
 			tri.invArea = 0; // todo
-			if (nidx0 > -1) 
-			tri.alpha = make_float3( alphas[nidx0], tri.alpha.y = alphas[nidx1], tri.alpha.z = alphas[nidx2] );
+			if (nidx0 > -1)
+				tri.alpha = make_float3( alphas[nidx0], alphas[nidx1], alphas[nidx2] );
 			else
 				tri.alpha = make_float3( 0 );
 			// calculate triangle LOD data
-			HostMaterial* mat = HostScene::materials[tri.material];
+			HostMaterial* mat = scene->materials[tri.material];
 			int textureID = mat->color.textureID;
 			if (textureID > -1)
 			{
-				HostTexture* texture = HostScene::textures[textureID];
+				HostTexture* texture = scene->textures[textureID];
 				float Ta = (float)(texture->width * texture->height) * fabs( (tri.u1 - tri.u0) * (tri.v2 - tri.v0) - (tri.u2 - tri.u0) * (tri.v1 - tri.v0) );
 				float Pa = length( cross( tri.vertex1 - tri.vertex0, tri.vertex2 - tri.vertex0 ) );
 				tri.LOD = 0.5f * log2f( Ta / Pa );
 			}
 		}
-	}
+	} );
 	printf( "verbose triangle data in %5.3fs\n", timer.elapsed() );
 }
 
@@ -511,17 +478,32 @@ void HostMesh::ConvertFromGTLFMesh( const tinygltfMesh& gltfMesh, const tinygltf
 	}
 }
 
+// append a per-vertex stream of a primitive to the indexed streams of the mesh;
+// streams that only some of the primitives have are padded with zeroes
+template <class T> static void AppendStream( vector<T>& stream, const vector<T>& data, const size_t base, const size_t count )
+{
+	if (data.size() == 0 && stream.size() == 0) return;
+	stream.resize( base, T{} );
+	if (data.size() > 0) stream.insert( stream.end(), data.begin(), data.begin() + count );
+	else stream.resize( base + count, T{} );
+}
+
 //  +-----------------------------------------------------------------------------+
 //  |  HostMesh::BuildFromIndexedData                                             |
 //  |  We use non-indexed triangles, so three subsequent vertices form a tri,     |
 //  |  to skip one indirection during intersection. glTF and obj store indexed    |
-//  |  data, which we now convert to the final representation.              LH2'19|
+//  |  data, which we now convert to the final representation. Static meshes      |
+//  |  keep only the indexed data; the final representation is expanded from it   |
+//  |  when needed, see RestoreHostData.                                    LH2'19|
 //  +-----------------------------------------------------------------------------+
 void HostMesh::BuildFromIndexedData( const vector<int>& tmpIndices, const vector<float3>& tmpVertices,
 	const vector<float3>& tmpNormals, const vector<float2>& tmpUvs, const vector<float2>& tmpUv2s,
 	const vector<float4>& tmpTs, const vector<Pose>& tmpPoses,
 	const vector<uint4>& tmpJoints, const vector<float4>& tmpWeights, const int materialIdx )
 {
+	// skinned and morphed meshes are posed at runtime, from the full triangle data
+	if (tmpJoints.size() > 0 || tmpPoses.size() > 0) isAnimated = true;
+	if (isAnimated) RestoreHostData(); else if (triangles.size() == 0) hostDataReleased = true;
 	// calculate values for consistent normal interpolation
 	vector<float> tmpAlphas;
 	tmpAlphas.resize( tmpVertices.size(), 1.0f ); // we will have one alpha value per unique vertex
@@ -551,133 +533,132 @@ void HostMesh::BuildFromIndexedData( const vector<int>& tmpIndices, const vector
 		const float nnv = tmpAlphas[i]; // temporarily stored there
 		tmpAlphas[i] = acosf( nnv ) * (1 + 0.03632f * (1 - nnv) * (1 - nnv));
 	}
-	// prepare poses
-	if (tmpPoses.size() > 0) for (auto& pose : tmpPoses) poses.push_back( Pose() );
-	// build final mesh structures
-	const size_t newTriangleCount = tmpIndices.size() / 3;
-	size_t triIdx = triangles.size();
-	triangles.resize( triIdx + newTriangleCount );
-	for (size_t i = 0; i < newTriangleCount; i++, triIdx++)
+	// prepare morph targets; corners of earlier primitives without targets get their own base pose
+	if (tmpPoses.size() > 0)
+	{
+		if (morphTargets.size() < tmpPoses.size() - 1) morphTargets.resize( tmpPoses.size() - 1 );
+		for (size_t s = vertices.size(), i = morphBasePos.size(); i < s; i++)
+		{
+			const HostTri& tri = triangles[i / 3];
+			morphBasePos.push_back( vertices[i] );
+			morphBaseNormal.push_back( make_float4( i % 3 == 0 ? tri.vN0 : i % 3 == 1 ? tri.vN1 : tri.vN2, 0 ) );
+		}
+	}
+	// keep the unique vertices for skinning; without vertex normals, each corner gets its own face normal
+	const uint skinBase = (uint)original.size();
+	if (tmpJoints.size() > 0 && tmpNormals.size() > 0) for (size_t s = tmpVertices.size(), i = 0; i < s; i++)
 	{
-		HostTri& tri = triangles[triIdx];
-		tri.material = materialIdx;
+		original.push_back( make_float4( tmpVertices[i], 1 ) );
+		origNormal.push_back( make_float4( tmpNormals[i], 0 ) );
+		joints.push_back( tmpJoints[i] );
+		weights.push_back( tmpWeights[i] );
+	}
+	// store the indexed representation of the new triangles
+	const size_t vertexBase = vertexPos.size(), triBase = TriangleCount();
+	const size_t newVertexCount = tmpVertices.size(), newTriangleCount = tmpIndices.size() / 3;
+	for (const float3& v : tmpVertices) vertexPos.push_back( make_float4( v, 1 ) );
+	AppendStream( vertexNormal, tmpNormals, vertexBase, newVertexCount );
+	AppendStream( vertexUV0, tmpUvs, vertexBase, newVertexCount );
+	AppendStream( vertexUV1, tmpUv2s, vertexBase, newVertexCount );
+	vertexAlpha.insert( vertexAlpha.end(), tmpAlphas.begin(), tmpAlphas.end() );
+	for (size_t s = newTriangleCount * 3, i = 0; i < s; i++) indices.push_back( (uint)vertexBase + tmpIndices[i] );
+	triangleMaterial.resize( triangleMaterial.size() + newTriangleCount, materialIdx );
+	if (tmpUvs.size() > 0 && scene) ReplaceSingleTexelMaterials( (int)(indices.size() / 3 - newTriangleCount) );
+	// static meshes are done; build final mesh structures for the others
+	if (hostDataReleased) return;
+	const CoreIndexedMesh geometry = GetIndexedGeometry();
+	const size_t indexBase = indices.size() / 3 - newTriangleCount;
+	triangles.resize( triBase + newTriangleCount );
+	vertices.resize( (triBase + newTriangleCount) * 3 );
+	for (size_t i = 0; i < newTriangleCount; i++)
+		ExpandIndexedTriangle( geometry, (int)(indexBase + i), &vertices[(triBase + i) * 3], triangles[triBase + i] );
+	// add skinning and morph target data
+	for (size_t i = 0; i < newTriangleCount; i++)
+	{
+		const size_t triIdx = triBase + i;
+		const HostTri& tri = triangles[triIdx];
+		const float3 N = make_float3( tri.Nx, tri.Ny, tri.Nz );
 		const uint v0idx = tmpIndices[i * 3 + 0];
 		const uint v1idx = tmpIndices[i * 3 + 1];
 		const uint v2idx = tmpIndices[i * 3 + 2];
-		const float3 v0pos = tmpVertices[v0idx];
-		const float3 v1pos = tmpVertices[v1idx];
-		const float3 v2pos = tmpVertices[v2idx];
-		vertices.push_back( make_float4( v0pos, 1 ) );
-		vertices.push_back( make_float4( v1pos, 1 ) );
-		vertices.push_back( make_float4( v2pos, 1 ) );
-		const float3 N = normalize( cross( v1pos - v0pos, v2pos - v0pos ) );
-		tri.Nx = N.x, tri.Ny = N.y, tri.Nz = N.z;
-		tri.vertex0 = tmpVertices[v0idx];
-		tri.vertex1 = tmpVertices[v1idx];
-		tri.vertex2 = tmpVertices[v2idx];
-		tri.alpha = make_float3( tmpAlphas[v0idx], tmpAlphas[v1idx], tmpAlphas[v2idx] );
-		if (tmpNormals.size() > 0)
-			tri.vN0 = tmpNormals[v0idx],
-			tri.vN1 = tmpNormals[v1idx],
-			tri.vN2 = tmpNormals[v2idx];
-		else
-			tri.vN0 = tri.vN1 = tri.vN2 = N;
-		if (tmpUvs.size() > 0)
+		// process joints / weights
+		if (tmpJoints.size() > 0)
 		{
-			tri.u0 = tmpUvs[v0idx].x, tri.v0 = tmpUvs[v0idx].y;
-			tri.u1 = tmpUvs[v1idx].x, tri.v1 = tmpUvs[v1idx].y;
-			tri.u2 = tmpUvs[v2idx].x, tri.v2 = tmpUvs[v2idx].y;
-			if (tri.u0 == tri.u1 && tri.u1 == tri.u2 && tri.v0 == tri.v1 && tri.v1 == tri.v2)
-			{
-				// this triangle uses only a single point on the texture; replace by single color material.
-				int textureID = HostScene::materials[materialIdx]->color.textureID;
-				if (textureID != -1)
-				{
-					HostTexture* texture = HostScene::textures[textureID];
-					uint u = (uint)(tri.u0 * texture->width) % texture->width;
-					uint v = (uint)(tri.v0 * texture->height) % texture->height;
-					uint texel = ((uint*)texture->idata)[u + v * texture->width] & 0xffffff;
-					tri.material = HostScene::FindOrCreateMaterialCopy( materialIdx, texel );
-					int w = 0;
-				}
-			}
-			// calculate tangent vector based on uvs
-			float2 uv01 = make_float2( tri.u1 - tri.u0, tri.v1 - tri.v0 );
-			float2 uv02 = make_float2( tri.u2 - tri.u0, tri.v2 - tri.v0 );
-			if (dot( uv01, uv01 ) == 0 || dot( uv02, uv02 ) == 0)
-			{
-			#if 1
-				// PBRT:
-				// https://github.com/mmp/pbrt-v3/blob/3f94503ae1777cd6d67a7788e06d67224a525ff4/src/shapes/triangle.cpp#L381
-				if (std::abs( N.x ) > std::abs( N.y ))
-					tri.T = make_float3( -N.z, 0, N.x ) / std::sqrt( N.x * N.x + N.z * N.z );
-				else
-					tri.T = make_float3( 0, N.z, -N.y ) / std::sqrt( N.y * N.y + N.z * N.z );
-			#else
-				tri.T = normalize( tri.vertex1 - tri.vertex0 );
-			#endif
-				tri.B = normalize( cross( N, tri.T ) );
-			}
-			else
+			if (tmpNormals.size() > 0)
 			{
-				tri.T = normalize( (tri.vertex1 - tri.vertex0) * uv02.y - (tri.vertex2 - tri.vertex0) * uv01.y );
-				tri.B = normalize( (tri.vertex2 - tri.vertex0) * uv01.x - (tri.vertex1 - tri.vertex0) * uv02.x );
+				skinIndex.push_back( skinBase + v0idx );
+				skinIndex.push_back( skinBase + v1idx );
+				skinIndex.push_back( skinBase + v2idx );
 			}
-			// catch bad tangents
-			if (isnan( tri.T.x + tri.T.y + tri.T.z + tri.B.x + tri.B.y + tri.B.z ))
+			else for (int j = 0; j < 3; j++)
 			{
-				tri.T = normalize( tri.vertex1 - tri.vertex0 );
-				tri.B = normalize( cross( N, tri.T ) );
+				const uint vidx = tmpIndices[i * 3 + j];
+				skinIndex.push_back( (uint)original.size() );
+				original.push_back( make_float4( tmpVertices[vidx], 1 ) );
+				origNormal.push_back( make_float4( N, 0 ) );
+				joints.push_back( tmpJoints[vidx] );
+				weights.push_back( tmpWeights[vidx] );
 			}
 		}
-		else
-		{
-			// no uv information; use edges to calculate tangent vectors
-			tri.T = normalize( tri.vertex1 - tri.vertex0 );
-			tri.B = normalize( cross( N, tri.T ) );
-		}
-		// handle second and third set of uv coordinates, if available
-		if (tmpUv2s.size() > 0)
-		{
-			tri.u1_0 = tmpUv2s[v0idx].x, tri.v1_0 = tmpUv2s[v0idx].y;
-			tri.u1_1 = tmpUv2s[v1idx].x, tri.v1_1 = tmpUv2s[v1idx].y;
-			tri.u1_2 = tmpUv2s[v2idx].x, tri.v1_2 = tmpUv2s[v2idx].y;
-		}
-		// process joints / weights
-		if (tmpJoints.size() > 0)
-		{
-			joints.push_back( tmpJoints[v0idx] );
-			joints.push_back( tmpJoints[v1idx] );
-			joints.push_back( tmpJoints[v2idx] );
-			weights.push_back( tmpWeights[v0idx] );
-			weights.push_back( tmpWeights[v1idx] );
-			weights.push_back( tmpWeights[v2idx] );
-		}
-		// build poses
-		for (int s = (int)tmpPoses.size(), i = 0; i < s; i++)
+		// build morph targets; only displaced corners are stored
+		if (tmpPoses.size() > 0) for (int j = 0; j < 3; j++)
 		{
-			auto& pose = tmpPoses[i];
-			poses[i].positions.push_back( pose.positions[v0idx] );
-			poses[i].positions.push_back( pose.positions[v1idx] );
-			poses[i].positions.push_back( pose.positions[v2idx] );
-			poses[i].normals.push_back( pose.normals[v0idx] );
-			poses[i].normals.push_back( pose.normals[v1idx] );
-			poses[i].normals.push_back( pose.normals[v2idx] );
-			if (pose.tangents.size() > 0)
-			{
-				poses[i].tangents.push_back( pose.tangents[v0idx] );
-				poses[i].tangents.push_back( pose.tangents[v1idx] );
-				poses[i].tangents.push_back( pose.tangents[v2idx] );
-			}
-			else
+			const uint vidx = tmpIndices[i * 3 + j], corner = (uint)triIdx * 3 + j;
+			morphBasePos.push_back( make_float4( tmpPoses[0].positions[vidx], 1 ) );
+			morphBaseNormal.push_back( make_float4( tmpPoses[0].normals[vidx], 0 ) );
+			for (int s = (int)tmpPoses.size(), k = 1; k < s; k++)
 			{
-				// have some dummies for now
-				poses[i].tangents.push_back( make_float3( 0, 1, 0 ) );
-				poses[i].tangents.push_back( make_float3( 0, 1, 0 ) );
-				poses[i].tangents.push_back( make_float3( 0, 1, 0 ) );
+				const Pose& pose = tmpPoses[k];
+				const float3 dp = pose.positions.size() > 0 ? pose.positions[vidx] : make_float3( 0 );
+				const float3 dn = pose.normals.size() > 0 ? pose.normals[vidx] : make_float3( 0 );
+				if (dot( dp, dp ) == 0 && dot( dn, dn ) == 0) continue;
+				morphTargets[k - 1].index.push_back( corner );
+				morphTargets[k - 1].position.push_back( make_float4( dp, 0 ) );
+				morphTargets[k - 1].normal.push_back( make_float4( dn, 0 ) );
 			}
 		}
 	}
+	// animated meshes are posed from the 'fat' data and never sent as indexed geometry
+	if (isAnimated)
+	{
+		vector<float4>().swap( vertexPos );
+		vector<float3>().swap( vertexNormal );
+		vector<float2>().swap( vertexUV0 );
+		vector<float2>().swap( vertexUV1 );
+		vector<float>().swap( vertexAlpha );
+		vector<uint>().swap( indices );
+		vector<int>().swap( triangleMaterial );
+	}
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostMesh::ReplaceSingleTexelMaterials                                      |
+//  |  A triangle that uses only a single point on the texture of its material    |
+//  |  gets an untextured copy of the material, with the color of that texel.     |
+//  |  Checks the indexed triangles from 'first' on. The mesh must be in a scene; |
+//  |  meshes that are built outside one (e.g. pbrt shapes) are processed when    |
+//  |  they are added.                                                      LH2'21|
+//  +-----------------------------------------------------------------------------+
+void HostMesh::ReplaceSingleTexelMaterials( const int first )
+{
+	if (vertexUV0.size() == 0) return;
+	const bool expanded = !hostDataReleased && indices.size() == triangles.size() * 3;
+	for (int s = (int)indices.size() / 3, i = first; i < s; i++)
+	{
+		const float2 uv0 = vertexUV0[indices[i * 3 + 0]], uv1 = vertexUV0[indices[i * 3 + 1]], uv2 = vertexUV0[indices[i * 3 + 2]];
+		if (uv0.x != uv1.x || uv1.x != uv2.x || uv0.y != uv1.y || uv1.y != uv2.y) continue;
+		// this triangle uses only a single point on the texture; replace by single color material.
+		const int materialIdx = triangleMaterial[i];
+		const int textureID = scene->materials[materialIdx]->color.textureID;
+		if (textureID == -1) continue;
+		HostTexture* texture = scene->textures[textureID];
+		texture->RestoreTexels();
+		uint u = (uint)(uv0.x * texture->width) % texture->width;
+		uint v = (uint)(uv0.y * texture->height) % texture->height;
+		uint texel = ((uint*)texture->idata)[u + v * texture->width] & 0xffffff;
+		triangleMaterial[i] = scene->FindOrCreateMaterialCopy( materialIdx, texel );
+		if (expanded) triangles[i].material = triangleMaterial[i];
+	}
 }
 
 //  +-----------------------------------------------------------------------------+
@@ -689,12 +670,12 @@ void HostMesh::BuildFromIndexedData( const vector<int>& tmpIndices, const vector
 void HostMesh::BuildMaterialList()
 {
 	// mark all materials as 'not seen yet'
-	for (auto material : HostScene::materials) material->visited = false;
+	for (auto material : scene->materials) material->visited = false;
 	// add each material
 	materialList.clear();
-	for (auto tri : triangles)
+	for (int s = TriangleCount(), i = 0; i < s; i++)
 	{
-		HostMaterial* material = HostScene::materials[tri.material];
+		HostMaterial* material = scene->materials[MaterialOf( i )];
 		if (!material->visited)
 		{
 			material->visited = true;
@@ -704,154 +685,315 @@ void HostMesh::BuildMaterialList()
 }
 
 //  +-----------------------------------------------------------------------------+
-//  |  HostMesh::SetPose                                                          |
-//  |  Update the geometry data in this mesh using the weights from the node,     |
-//  |  and update all dependent data.                                       LH2'19|
+//  |  HostMesh::GetEmissiveTriangles                                             |
+//  |  Return the indices of the triangles that use an emissive material. The     |
+//  |  list is rebuilt only when the triangle count changes or when one of the    |
+//  |  materials of the mesh starts or stops emitting; otherwise the cost is a    |
+//  |  scan over the material list. Set emissiveTriCount to -1 after changing the |
+//  |  materials of existing triangles.                                     LH2'21|
 //  +-----------------------------------------------------------------------------+
-void HostMesh::SetPose( const vector<float>& weights )
+const vector<int>& HostMesh::GetEmissiveTriangles()
 {
-	assert( weights.size() == poses.size() - 1 /* first pose is base pose */ );
-	const int weightCount = (int)weights.size();
-	// adjust intersection geometry data
-	for (int s = (int)vertices.size(), i = 0; i < s; i++)
+	const int triCount = TriangleCount();
+	if (emissiveTriCount != triCount) BuildMaterialList();
+	// check if the set of emissive materials changed since the last rebuild
+	int emissiveCount = 0;
+	bool modified = emissiveTriCount != triCount;
+	for (int materialIdx : materialList) if (scene->materials[materialIdx]->IsEmissive())
 	{
-		vertices[i] = make_float4( poses[0].positions[i], 1 );
-		for (int j = 1; j <= weightCount; j++) vertices[i] += weights[j - 1] * make_float4( poses[j].positions[i], 0 );
+		if (emissiveCount >= emissiveMaterials.size() || emissiveMaterials[emissiveCount] != materialIdx) modified = true;
+		emissiveCount++;
 	}
-	// adjust full triangles
-	for (int s = (int)triangles.size(), i = 0; i < s; i++)
+	if (!modified && emissiveCount == emissiveMaterials.size()) return emissiveTris;
+	// rebuild
+	emissiveMaterials.clear();
+	for (int materialIdx : materialList) if (scene->materials[materialIdx]->IsEmissive()) emissiveMaterials.push_back( materialIdx );
+	emissiveTris.clear();
+	if (emissiveMaterials.size() > 0)
 	{
-		triangles[i].vertex0 = make_float3( vertices[i * 3 + 0] );
-		triangles[i].vertex1 = make_float3( vertices[i * 3 + 1] );
-		triangles[i].vertex2 = make_float3( vertices[i * 3 + 2] );
-		triangles[i].vN0 = poses[0].normals[i * 3 + 0];
-		triangles[i].vN1 = poses[0].normals[i * 3 + 1];
-		triangles[i].vN2 = poses[0].normals[i * 3 + 2];
-		for (int j = 1; j <= weightCount; j++)
-			triangles[i].vN0 += poses[j].normals[i * 3 + 0],
-			triangles[i].vN1 += poses[j].normals[i * 3 + 1],
-			triangles[i].vN2 += poses[j].normals[i * 3 + 2];
-		triangles[i].vN0 = normalize( triangles[i].vN0 );
-		triangles[i].vN1 = normalize( triangles[i].vN1 );
-		triangles[i].vN2 = normalize( triangles[i].vN2 );
+		RestoreHostData(); // light triangles need the full triangle data
+		for (int i = 0; i < triCount; i++) if (scene->materials[triangles[i].material]->IsEmissive()) emissiveTris.push_back( i );
 	}
-	// mark as dirty; changing vector contents doesn't trigger this
-	MarkAsDirty();
+	emissiveTriCount = triCount;
+	emissiveVersion++;
+	return emissiveTris;
 }
 
 //  +-----------------------------------------------------------------------------+
-//  |  HostMesh::SetPose                                                          |
-//  |  Update the geometry data in this mesh using a skin.                        |
-//  |  Called from RenderSystem::UpdateSceneGraph, for skinned mesh nodes.  LH2'19|
+//  |  HostMesh::HasIndexedGeometry / GetIndexedGeometry                          |
+//  |  The indexed representation is only valid for meshes that have not been     |
+//  |  modified after loading: animation and light triangle indices only exist in |
+//  |  the de-indexed data.                                                 LH2'21|
 //  +-----------------------------------------------------------------------------+
-void HostMesh::SetPose( const HostSkin* skin )
+bool HostMesh::HasIndexedGeometry() const
+{
+	if (indices.size() == 0 || indices.size() != (size_t)TriangleCount() * 3) return false;
+	return joints.size() == 0 && morphTargets.size() == 0 && !lightBound;
+}
+CoreIndexedMesh HostMesh::GetIndexedGeometry() const
+{
+	CoreIndexedMesh mesh;
+	mesh.positions = vertexPos.data();
+	mesh.normals = vertexNormal.size() > 0 ? vertexNormal.data() : 0;
+	mesh.uv0 = vertexUV0.size() > 0 ? vertexUV0.data() : 0;
+	mesh.uv1 = vertexUV1.size() > 0 ? vertexUV1.data() : 0;
+	mesh.alpha = vertexAlpha.data();
+	mesh.indices = indices.data();
+	mesh.materials = triangleMaterial.data();
+	mesh.vertexCount = (int)vertexPos.size();
+	mesh.triangleCount = (int)indices.size() / 3;
+	return mesh;
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostMesh::ReleaseHostData / RestoreHostData                                |
+//  |  The 'fat' triangles and vertices of a static mesh are a second copy of the |
+//  |  indexed streams. These are only expanded when the host needs them, e.g.    |
+//  |  for light triangles or for a core that does not accept indexed geometry,   |
+//  |  and can be freed again afterwards. Animated and emissive meshes are never  |
+//  |  released.                                                            LH2'21|
+//  +-----------------------------------------------------------------------------+
+bool HostMesh::ReleaseHostData()
 {
-	// ensure that we have a backup of the original vertex positions
-	if (original.size() == 0)
+	if (hostDataReleased || isAnimated || !HasIndexedGeometry()) return false;
+	// before the queries below: these cache their results in tracked members
+	const bool wasDirty = IsDirty();
+	if (GetEmissiveTriangles().size() > 0)
 	{
-		for (auto& vert : vertices) original.push_back( vert );
-		for (auto& tri : triangles)
-		{
-			origNormal.push_back( tri.vN0 );
-			origNormal.push_back( tri.vN1 );
-			origNormal.push_back( tri.vN2 );
-		}
-		vertexNormals.resize( vertices.size() );
+		if (!wasDirty) MarkAsNotDirty();
+		return false;
 	}
-#if 1
-	// code optimized for INFOMOV by Alysha Bogaers and Naraenda Prasetya
+	GetBoundingSphere(); // calculated from the vertices, so do this first
+	vector<float4>().swap( vertices );
+	vector<HostTri>().swap( triangles );
+	hostDataReleased = true;
+	if (!wasDirty) MarkAsNotDirty(); // not a change the core needs to see
+	return true;
+}
+void HostMesh::RestoreHostData()
+{
+	if (!hostDataReleased) return;
+	const bool wasDirty = IsDirty();
+	const CoreIndexedMesh geometry = GetIndexedGeometry();
+	triangles.resize( geometry.triangleCount );
+	vertices.resize( geometry.triangleCount * 3 );
+	for (int i = 0; i < geometry.triangleCount; i++) ExpandIndexedTriangle( geometry, i, &vertices[i * 3], triangles[i] );
+	hostDataReleased = false;
+	// the core already has this data; don't send it again because the buffers moved
+	if (!wasDirty) MarkAsNotDirty();
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostMesh::GetBoundingSphere                                                |
+//  |  Get a bounding sphere for the base pose of the mesh, in object space. It   |
+//  |  is calculated on first use and serves as an estimate for animated meshes.  |
+//  |                                                                       LH2'21|
+//  +-----------------------------------------------------------------------------+
+float4 HostMesh::GetBoundingSphere()
+{
+	if (boundingSphere.w >= 0) return boundingSphere;
+	const vector<float4>& base = original.size() > 0 ? original : morphBasePos.size() > 0 ? morphBasePos : hostDataReleased ? vertexPos : vertices;
+	if (base.size() == 0) return boundingSphere = make_float4( 0, 0, 0, 0 );
+	float3 bmin = make_float3( 1e34f ), bmax = make_float3( -1e34f );
+	for (const float4& v : base) bmin = fminf( bmin, make_float3( v ) ), bmax = fmaxf( bmax, make_float3( v ) );
+	const float3 center = (bmin + bmax) * 0.5f;
+	float r2 = 0;
+	for (const float4& v : base) r2 = max( r2, dot( make_float3( v ) - center, make_float3( v ) - center ) );
+	return boundingSphere = make_float4( center, sqrtf( r2 ) );
+}
 
-#if defined( __AVX2__ ) && ( defined( _MSC_VER ) || defined( __FMA__ ) )
-	// use avx2 instruction
-#define FMADD256(a,b,c) _mm256_fmadd_ps( (a),(b),(c) )
+//  +-----------------------------------------------------------------------------+
+//  |  Animation helpers                                                          |
+//  |  Skinning and morphing use SIMD kernels, which are selected at runtime      |
+//  |  based on the instruction sets supported by the CPU, so that a binary built |
+//  |  on an AVX2 machine still runs elsewhere. Large meshes are processed in     |
+//  |  batches on the shared task pool.                                     LH2'21|
+//  +-----------------------------------------------------------------------------+
+#if defined( _MSC_VER ) && !defined( __clang__ )
+// MSVC accepts SSE4.1 intrinsics without per-function flags
+#define TARGET_SSE41
 #else
-	// avx fallback (negligible impact on performance)
-#define FMADD256(a,b,c) _mm256_add_ps( _mm256_mul_ps( (a), (b) ), (c) )
+#define TARGET_SSE41 __attribute__( (target( "sse4.1" )) )
 #endif
+#define ANIMATION_BATCH 2048 // vertices or triangles per animation task
+
+enum { ISA_SCALAR = 0, ISA_SSE41, ISA_AVX2, ISA_AVX512 };
 
-#ifdef _MSC_VER
-#define USE_PARALLEL_SETPOSE // TODO: Find Linux replacement for PPL
+static int DetectISA()
+{
+	// detect the instruction sets supported by the CPU and the OS
+	bool sse41 = false, avx2 = false, avx512 = false;
+#if defined( _MSC_VER ) && !defined( __clang__ )
+	int info[4];
+	__cpuid( info, 0 );
+	const int maxLeaf = info[0];
+	__cpuid( info, 1 );
+	const bool fma = (info[2] >> 12) & 1, osxsave = (info[2] >> 27) & 1;
+	sse41 = (info[2] >> 19) & 1;
+	if (osxsave && maxLeaf >= 7)
+	{
+		const unsigned long long xcr0 = _xgetbv( 0 );
+		__cpuidex( info, 7, 0 );
+		avx2 = fma && ((info[1] >> 5) & 1) && ((xcr0 & 6) == 6) /* ymm state enabled */;
+		avx512 = avx2 && ((info[1] >> 16) & 1) && ((xcr0 & 0xe6) == 0xe6) /* zmm state enabled */;
+	}
+#else
+	__builtin_cpu_init();
+	sse41 = __builtin_cpu_supports( "sse4.1" );
+	avx2 = __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" );
+	avx512 = avx2 && __builtin_cpu_supports( "avx512f" );
 #endif
+	return avx512 ? ISA_AVX512 : avx2 ? ISA_AVX2 : sse41 ? ISA_SSE41 : ISA_SCALAR;
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostMesh::SetPose                                                          |
+//  |  Update the geometry data in this mesh using the weights from the node,     |
+//  |  and update all dependent data. Targets with a zero weight are skipped;     |
+//  |  the others only store deltas for the corners they displace.          LH2'19|
+//  +-----------------------------------------------------------------------------+
+void HostMesh::SetPose( const vector<float>& weights )
+{
+	assert( weights.size() == morphTargets.size() );
+	// gather the active targets
+	vector<int> active;
+	for (int s = (int)min( weights.size(), morphTargets.size() ), i = 0; i < s; i++)
+		if (weights[i] != 0 && morphTargets[i].index.size() > 0) active.push_back( i );
+	const int cornerCount = (int)morphBasePos.size();
+	morphNormal.resize( cornerCount );
+	// evaluate the targets per range of triangles, so batches never touch the same corners
+	ParallelBatches( cornerCount / 3, ANIMATION_BATCH, [&]( const int first, const int last ) {
+		const uint c0 = first * 3, c1 = last * 3;
+		// start from the base pose
+		memcpy( &vertices[c0], &morphBasePos[c0], (c1 - c0) * sizeof( float4 ) );
+		memcpy( &morphNormal[c0], &morphBaseNormal[c0], (c1 - c0) * sizeof( float4 ) );
+		// accumulate the weighted deltas of the active targets
+		for (const int t : active)
+		{
+			const MorphTarget& target = morphTargets[t];
+			const __m128 w4 = _mm_set1_ps( weights[t] );
+			const uint* idx = target.index.data();
+			const size_t s = target.index.size();
+			for (size_t k = lower_bound( idx, idx + s, c0 ) - idx; k < s && idx[k] < c1; k++)
+			{
+				float* P = &vertices[idx[k]].x, * N = &morphNormal[idx[k]].x;
+				_mm_store_ps( P, _mm_add_ps( _mm_load_ps( P ), _mm_mul_ps( w4, _mm_load_ps( &target.position[k].x ) ) ) );
+				_mm_store_ps( N, _mm_add_ps( _mm_load_ps( N ), _mm_mul_ps( w4, _mm_load_ps( &target.normal[k].x ) ) ) );
+			}
+		}
+		// adjust full triangles
+		for (int i = first; i < last; i++)
+		{
+			HostTri& tri = triangles[i];
+			tri.vertex0 = make_float3( vertices[i * 3 + 0] );
+			tri.vertex1 = make_float3( vertices[i * 3 + 1] );
+			tri.vertex2 = make_float3( vertices[i * 3 + 2] );
+			tri.vN0 = normalize( make_float3( morphNormal[i * 3 + 0] ) );
+			tri.vN1 = normalize( make_float3( morphNormal[i * 3 + 1] ) );
+			tri.vN2 = normalize( make_float3( morphNormal[i * 3 + 2] ) );
+			const float3 N = normalize( cross( tri.vertex1 - tri.vertex0, tri.vertex2 - tri.vertex0 ) );
+			tri.Nx = N.x, tri.Ny = N.y, tri.Nz = N.z;
+		}
+	} );
+	// mark as dirty; changing vector contents doesn't trigger this
+	MarkAsDirty();
+}
 
-	// adjust full triangles
-#ifdef USE_PARALLEL_SETPOSE
-	concurrency::parallel_for<int>( 0, (int)triangles.size(), [&]( int t ) {
-	#else
-	for (int s = (int)triangles.size(), t = 0; t < s; t++)
+//  +-----------------------------------------------------------------------------+
+//  |  Skinning kernels                                                           |
+//  |  Each kernel transforms the unique vertices [first,last) of the mesh using  |
+//  |  the joint matrices of the skin. The scatter functions then copy the        |
+//  |  results to the de-indexed vertex array and the HostTris.             LH2'21|
+//  +-----------------------------------------------------------------------------+
+typedef void (*SkinKernel)(HostMesh*, const HostSkin*, const int, const int);
+
+static void SkinVerticesScalar( HostMesh* mesh, const HostSkin* skin, const int first, const int last )
+{
+	for (int v = first; v < last; v++)
 	{
-	#endif
+		const uint4 j4 = mesh->joints[v];
+		const float4 w4 = mesh->weights[v];
+		mat4 skinMatrix = w4.x * skin->jointMat[j4.x];
+		skinMatrix += w4.y * skin->jointMat[j4.y];
+		skinMatrix += w4.z * skin->jointMat[j4.z];
+		skinMatrix += w4.w * skin->jointMat[j4.w];
+		mesh->skinnedPos[v] = skinMatrix * mesh->original[v];
+		mesh->skinnedNormal[v] = make_float4( normalize( make_float3( skinMatrix * mesh->origNormal[v] ) ), 0 );
+	}
+}
+
+static TARGET_SSE41 void SkinVerticesSSE( HostMesh* mesh, const HostSkin* skin, const int first, const int last )
+{
+	const float* M = skin->jointMat[0].cell;
+	for (int v = first; v < last; v++)
+	{
+		const uint4 j4 = mesh->joints[v];
+		const __m128 wx = _mm_set1_ps( mesh->weights[v].x ), wy = _mm_set1_ps( mesh->weights[v].y );
+		const __m128 wz = _mm_set1_ps( mesh->weights[v].z ), ww = _mm_set1_ps( mesh->weights[v].w );
+		// weighted skin matrix, one row at a time
+		__m128 row[4];
+		for (int r = 0; r < 4; r++)
+			row[r] = _mm_add_ps( _mm_add_ps( _mm_mul_ps( wx, _mm_loadu_ps( M + j4.x * 16 + r * 4 ) ), _mm_mul_ps( wy, _mm_loadu_ps( M + j4.y * 16 + r * 4 ) ) ),
+				_mm_add_ps( _mm_mul_ps( wz, _mm_loadu_ps( M + j4.z * 16 + r * 4 ) ), _mm_mul_ps( ww, _mm_loadu_ps( M + j4.w * 16 + r * 4 ) ) ) );
+		// transform vertex and normal; HADD and MUL is faster than DP
+		const __m128 vtxOrig = _mm_load_ps( &mesh->original[v].x );
+		const __m128 normOrig = _mm_load_ps( &mesh->origNormal[v].x );
+		const __m128 vtx = _mm_hadd_ps( _mm_hadd_ps( _mm_mul_ps( vtxOrig, row[0] ), _mm_mul_ps( vtxOrig, row[1] ) ),
+			_mm_hadd_ps( _mm_mul_ps( vtxOrig, row[2] ), _mm_mul_ps( vtxOrig, row[3] ) ) );
+		__m128 norm = _mm_hadd_ps( _mm_hadd_ps( _mm_mul_ps( normOrig, row[0] ), _mm_mul_ps( normOrig, row[1] ) ),
+			_mm_hadd_ps( _mm_mul_ps( normOrig, row[2] ), _mm_mul_ps( normOrig, row[3] ) ) );
+		norm = _mm_blend_ps( _mm_mul_ps( norm, _mm_rsqrt_ps( _mm_dp_ps( norm, norm, 0x77 ) ) ), _mm_setzero_ps(), 0b1000 );
+		_mm_store_ps( &mesh->skinnedPos[v].x, vtx );
+		_mm_store_ps( &mesh->skinnedNormal[v].x, norm );
+	}
+}
+
+// kernels built with per-file instruction set flags, see host_skinning_avx2.cpp / _avx512.cpp
+void SkinVerticesAVX2( HostMesh* mesh, const HostSkin* skin, const int first, const int last );
+void SkinVerticesAVX512( HostMesh* mesh, const HostSkin* skin, const int first, const int last );
+
+static void ScatterSkinnedScalar( HostMesh* mesh, const int first, const int last )
+{
+	for (int t = first; t < last; t++)
+	{
+		const uint* idx = &mesh->skinIndex[t * 3];
+		HostTri& tri = mesh->triangles[t];
+		mesh->vertices[t * 3 + 0] = mesh->skinnedPos[idx[0]];
+		mesh->vertices[t * 3 + 1] = mesh->skinnedPos[idx[1]];
+		mesh->vertices[t * 3 + 2] = mesh->skinnedPos[idx[2]];
+		tri.vertex0 = make_float3( mesh->skinnedPos[idx[0]] );
+		tri.vertex1 = make_float3( mesh->skinnedPos[idx[1]] );
+		tri.vertex2 = make_float3( mesh->skinnedPos[idx[2]] );
+		const float3 N = normalize( cross( tri.vertex1 - tri.vertex0, tri.vertex2 - tri.vertex0 ) );
+		tri.vN0 = make_float3( mesh->skinnedNormal[idx[0]] );
+		tri.vN1 = make_float3( mesh->skinnedNormal[idx[1]] );
+		tri.vN2 = make_float3( mesh->skinnedNormal[idx[2]] );
+		tri.Nx = N.x, tri.Ny = N.y, tri.Nz = N.z;
+	}
+}
+
+static TARGET_SSE41 void ScatterSkinnedSSE( HostMesh* mesh, const int first, const int last )
+{
+	for (int t = first; t < last; t++)
+	{
+		const uint* idx = &mesh->skinIndex[t * 3];
+		HostTri& tri = mesh->triangles[t];
 		__m128 tri_vtx[3], tri_nrm[3];
-		// adjust vertices of triangle
 		for (int t_v = 0; t_v < 3; t_v++)
 		{
-			// vertex index
-			int v = t * 3 + t_v;
-			// calculate weighted skin matrix
-			// skinM = w4.x * skin->jointMat[j4.x]
-			//       + w4.y * skin->jointMat[j4.y]
-			//       + w4.z * skin->jointMat[j4.z]
-			//       + w4.w * skin->jointMat[j4.w];
-			// the 4 joint indices
-			uint4 j4 = joints[v];
-			// the 4 weights of each joint
-			__m128 w4 = _mm_load_ps( (const float*)&weights[v] );
-			// create scalars for matrix scaling, use same shuffle value to help with uOP cache
-			__m256 w4x = _mm256_broadcastss_ps( w4 ); // w4.x component shuffled to all elements
-			w4 = _mm_shuffle_ps( w4, w4, 0b111001 );
-			__m256 w4y = _mm256_broadcastss_ps( w4 ); // w4.y component shuffled to all elements
-			w4 = _mm_shuffle_ps( w4, w4, 0b111001 );
-			__m256 w4z = _mm256_broadcastss_ps( w4 ); // w4.z component shuffled to all elements
-			w4 = _mm_shuffle_ps( w4, w4, 0b111001 );
-			__m256 w4w = _mm256_broadcastss_ps( w4 ); // w4.w component shuffled to all elements
-			// top half of weighted skin matrix
-			__m256 skinM_T = _mm256_mul_ps( w4x, _mm256_load_ps( skin->jointMat[j4.x].cell ) );
-			skinM_T = _mm256_fmadd_ps( w4y, _mm256_load_ps( skin->jointMat[j4.y].cell ), skinM_T );
-			skinM_T = _mm256_fmadd_ps( w4z, _mm256_load_ps( skin->jointMat[j4.z].cell ), skinM_T );
-			skinM_T = _mm256_fmadd_ps( w4w, _mm256_load_ps( skin->jointMat[j4.w].cell ), skinM_T );
-			// bottom half of weighted skin matrix
-			__m256 skinM_L = _mm256_mul_ps( w4x, _mm256_load_ps( &skin->jointMat[j4.x].cell[8] ) );
-			skinM_L = _mm256_fmadd_ps( w4y, _mm256_load_ps( &skin->jointMat[j4.y].cell[8] ), skinM_L );
-			skinM_L = _mm256_fmadd_ps( w4z, _mm256_load_ps( &skin->jointMat[j4.z].cell[8] ), skinM_L );
-			skinM_L = _mm256_fmadd_ps( w4w, _mm256_load_ps( &skin->jointMat[j4.w].cell[8] ), skinM_L );
-			// double each row so we can do two matrix multiplication at once
-			__m256 skinM0 = _mm256_permute2f128_ps( skinM_T, skinM_T, 0x00 );
-			__m256 skinM1 = _mm256_permute2f128_ps( skinM_T, skinM_T, 0x11 );
-			__m256 skinM2 = _mm256_permute2f128_ps( skinM_L, skinM_L, 0x00 );
-			__m256 skinM3 = _mm256_permute2f128_ps( skinM_L, skinM_L, 0x11 );
-			// load vertices and normal
-			__m128 vtxOrig = _mm_load_ps( &original[v].x );
-			__m128 normOrig = _mm_maskload_ps( &origNormal[v].x, _mm_set_epi32( 0, -1, -1, -1 ) );
-			// combine vectors to use AVX2 instead of SSE
-			__m256 combined = _mm256_set_m128( normOrig, vtxOrig );
-			// multiply vertex with skin matrix, multiply normal with skin matrix
-			// using HADD and MUL is faster than OR and DP
-			combined = _mm256_hadd_ps(
-				_mm256_hadd_ps( _mm256_mul_ps( combined, skinM0 ), _mm256_mul_ps( combined, skinM1 ) ),
-				_mm256_hadd_ps( _mm256_mul_ps( combined, skinM2 ), _mm256_mul_ps( combined, skinM3 ) ) );
-			// extract vertex and normal from combined vector
-			__m128 vtx = _mm256_castps256_ps128( combined );
-			__m128 norm = _mm256_extractf128_ps( combined, 1 );
-			// normalize normal
-			norm = _mm_mul_ps( norm, _mm_rsqrt_ps( _mm_dp_ps( norm, norm, 0x77 ) ) );
-			// store for reuse
-			tri_vtx[t_v] = vtx;
-			_mm_store_ps( &vertices[v].x, vtx );
-			tri_nrm[t_v] = norm;
-			_mm_maskstore_ps( &vertexNormals[v].x, _mm_set_epi32( 0, -1, -1, -1 ), norm );
+			tri_vtx[t_v] = _mm_load_ps( &mesh->skinnedPos[idx[t_v]].x );
+			tri_nrm[t_v] = _mm_load_ps( &mesh->skinnedNormal[idx[t_v]].x );
+			_mm_store_ps( &mesh->vertices[t * 3 + t_v].x, tri_vtx[t_v] );
 		}
 		// get vectors to calculate triangle normal
-		__m128 N_a = _mm_sub_ps( tri_vtx[1], tri_vtx[0] );
-		__m128 N_b = _mm_sub_ps( tri_vtx[2], tri_vtx[0] );
-		// cross product with four shuffles
-		// |a.x|   |b.x|   | a.y * b.z - a.z * b.y |
-		// |a.y| X |b.y| = | a.z * b.x - a.x * b.z |
-		// |a.z|   |b.z|   | a.x * b.y - a.y * b.x |
-		// Can be be done with three shuffles...
+		const __m128 N_a = _mm_sub_ps( tri_vtx[1], tri_vtx[0] );
+		const __m128 N_b = _mm_sub_ps( tri_vtx[2], tri_vtx[0] );
+		// cross product with three shuffles:
 		// |a.y|   |b.y|   | a.z * b.x - a.x * b.z |
 		// |a.z| X |b.z| = | a.x * b.y - a.y * b.x |
 		// |a.x|   |b.x|   | a.y * b.z - a.z * b.y |
 		// shuffle(..., 0b010010) = [x, y, z] -> [z, x, y] or [y, z, x] -> [x, y, z]
-		__m128 N = _mm_fmsub_ps( N_b, _mm_shuffle_ps( N_a, N_a, 0b010010 ),
+		__m128 N = _mm_sub_ps( _mm_mul_ps( N_b, _mm_shuffle_ps( N_a, N_a, 0b010010 ) ),
 			_mm_mul_ps( N_a, _mm_shuffle_ps( N_b, N_b, 0b010010 ) ) );
 		// reshuffle to get final result
 		N = _mm_shuffle_ps( N, N, 0b010010 );
@@ -865,48 +1007,36 @@ void HostMesh::SetPose( const HostSkin* skin )
 		tri_nrm[1] = _mm_insert_ps( tri_nrm[1], N, 0b01110000 );
 		tri_nrm[2] = _mm_insert_ps( tri_nrm[2], N, 0b10110000 );
 		// we use stores, because we can write multiple times to L1
-		_mm_store_ps( &triangles[t].vertex0.x, tri_vtx[0] );
-		_mm_store_ps( &triangles[t].vertex1.x, tri_vtx[1] );
-		_mm_store_ps( &triangles[t].vertex2.x, tri_vtx[2] );
-		// store to [vN0 (float3), Nx (float)]
-		_mm_store_ps( &triangles[t].vN0.x, tri_nrm[0] );
-		// store to [vN1 (float3), Ny (float)]
-		_mm_store_ps( &triangles[t].vN1.x, tri_nrm[1] );
-		// store to [vN1 (float3), Nz (float)]
-		_mm_store_ps( &triangles[t].vN2.x, tri_nrm[2] );
+		_mm_store_ps( &tri.vertex0.x, tri_vtx[0] );
+		_mm_store_ps( &tri.vertex1.x, tri_vtx[1] );
+		_mm_store_ps( &tri.vertex2.x, tri_vtx[2] );
+		// store to [vN0 (float3), Nx (float)], [vN1, Ny], [vN2, Nz]
+		_mm_store_ps( &tri.vN0.x, tri_nrm[0] );
+		_mm_store_ps( &tri.vN1.x, tri_nrm[1] );
+		_mm_store_ps( &tri.vN2.x, tri_nrm[2] );
 	}
-#ifdef USE_PARALLEL_SETPOSE
-	);
-#endif
+}
 
-#else
-	// transform original into vertex vector using skin matrices
-	for (int s = (int)vertices.size(), i = 0; i < s; i++)
-	{
-		uint4 j4 = joints[i];
-		float4 w4 = weights[i];
-		mat4 skinMatrix = w4.x * skin->jointMat[j4.x];
-		skinMatrix += w4.y * skin->jointMat[j4.y];
-		skinMatrix += w4.z * skin->jointMat[j4.z];
-		skinMatrix += w4.w * skin->jointMat[j4.w];
-		vertices[i] = skinMatrix * original[i];
-		vertexNormals[i] = normalize( make_float3( make_float4( origNormal[i], 0 ) * skinMatrix ) );
-	}
-	// adjust full triangles
-	for (int s = (int)triangles.size(), i = 0; i < s; i++)
-	{
-		triangles[i].vertex0 = make_float3( vertices[i * 3 + 0] );
-		triangles[i].vertex1 = make_float3( vertices[i * 3 + 1] );
-		triangles[i].vertex2 = make_float3( vertices[i * 3 + 2] );
-		float3 N = normalize( cross( triangles[i].vertex1 - triangles[i].vertex0, triangles[i].vertex2 - triangles[i].vertex0 ) );
-		triangles[i].vN0 = vertexNormals[i * 3 + 0];
-		triangles[i].vN1 = vertexNormals[i * 3 + 1];
-		triangles[i].vN2 = vertexNormals[i * 3 + 2];
-		triangles[i].Nx = N.x;
-		triangles[i].Ny = N.y;
-		triangles[i].Nz = N.z;
-	}
-#endif
+//  +-----------------------------------------------------------------------------+
+//  |  HostMesh::SetPose                                                          |
+//  |  Update the geometry data in this mesh using a skin.                        |
+//  |  Called from RenderSystem::UpdateSceneGraph, for skinned mesh nodes. Only   |
+//  |  the unique vertices are skinned; the results are then scattered to the     |
+//  |  triangles in a second pass.                                          LH2'19|
+//  +-----------------------------------------------------------------------------+
+void HostMesh::SetPose( const HostSkin* skin )
+{
+	static const int isa = DetectISA();
+	static const SkinKernel skinKernel[4] = { SkinVerticesScalar, SkinVerticesSSE, SkinVerticesAVX2, SkinVerticesAVX512 };
+	// prepare the output buffers for the unique vertices
+	const int uniqueCount = (int)original.size();
+	if (skinnedPos.size() != uniqueCount) skinnedPos.resize( uniqueCount ), skinnedNormal.resize( uniqueCount );
+	// transform the unique vertices using the best kernel for this CPU
+	ParallelBatches( uniqueCount, ANIMATION_BATCH, [this, skin]( const int first, const int last ) { skinKernel[isa]( this, skin, first, last ); } );
+	// scatter the transformed vertices to the triangles
+	ParallelBatches( (int)triangles.size(), ANIMATION_BATCH, [this]( const int first, const int last ) {
+		if (isa == ISA_SCALAR) ScatterSkinnedScalar( this, first, last ); else ScatterSkinnedSSE( this, first, last );
+	} );
 	// mark as dirty; changing vector contents doesn't trigger this
 	MarkAsDirty();
 }
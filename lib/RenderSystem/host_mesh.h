@@ -18,6 +18,9 @@
 namespace lighthouse2
 {
 
+struct CoreIndexedMesh;
+class HostScene;
+
 //  +-----------------------------------------------------------------------------+
 //  |  HostSkin                                                                   |
 //  |  Skin data storage.                                                   LH2'19|
@@ -25,6 +28,7 @@ namespace lighthouse2
 class HostSkin
 {
 public:
+	HostSkin() = default;
 	HostSkin( const tinygltfSkin& gltfSkin, const tinygltfModel& gltfModel, const int nodeBase );
 	void ConvertFromGLTFSkin( const tinygltfSkin& gltfSkin, const tinygltfModel& gltfModel, const int nodeBase );
 	string name;
@@ -47,11 +51,17 @@ public:
 		vector<float3> normals;
 		vector<float3> tangents;
 	};
+	struct MorphTarget
+	{
+		vector<uint> index;						// triangle corners displaced by this target, ascending
+		vector<float4> position;				// position deltas for these corners (w = 0)
+		vector<float4> normal;					// normal deltas for these corners (w = 0)
+	};
 	// constructor / destructor
 	HostMesh() = default;
 	HostMesh( const int triCount );
-	HostMesh( const char* name, const char* dir, const float scale = 1.0f, const bool flatShaded = false );
-	HostMesh( const tinygltfMesh& gltfMesh, const tinygltfModel& gltfModel, const vector<int>& matIdx, const int materialOverride = -1 );
+	HostMesh( HostScene* owner, const char* name, const char* dir, const float scale = 1.0f, const bool flatShaded = false );
+	HostMesh( HostScene* owner, const tinygltfMesh& gltfMesh, const tinygltfModel& gltfModel, const vector<int>& matIdx, const int materialOverride = -1 );
 	~HostMesh();
 	// methods
 	void LoadGeometry( const char* file, const char* dir, const float scale = 1.0f, const bool flatShaded = false );
@@ -61,24 +71,53 @@ public:
 		const vector<float3>& tmpNormals, const vector<float2>& tmpUvs, const vector<float2>& tmpUv2s,
 		const vector<float4>& tmpTs, const vector<Pose>& tmpPoses,
 		const vector<uint4>& tmpJoints, const vector<float4>& tmpWeights, const int materialIdx );
+	void ReplaceSingleTexelMaterials( const int first );
 	void BuildMaterialList();
+	const vector<int>& GetEmissiveTriangles();
 	void SetPose( const vector<float>& weights );
 	void SetPose( const HostSkin* skin );
+	float4 GetBoundingSphere();
+	bool HasIndexedGeometry() const;
+	CoreIndexedMesh GetIndexedGeometry() const;
+	bool ReleaseHostData();
+	void RestoreHostData();
+	int TriangleCount() const { return hostDataReleased ? (int)indices.size() / 3 : (int)triangles.size(); }
+	int MaterialOf( const int triIdx ) const { return hostDataReleased ? triangleMaterial[triIdx] : triangles[triIdx].material; }
 	// data members
 	string name = "unnamed";					// name for the mesh						
 	int ID = -1;								// unique ID for the mesh: position in mesh array
+	HostScene* scene = nullptr;					// the scene that holds this mesh; set by HostScene::AddMesh
 	vector<float4> vertices;					// model vertices
-	vector<float3> vertexNormals;				// vertex normals
-	vector<float4> original;					// skinning: base pose; will be transformed into vector vertices
-	vector<float3> origNormal;					// skinning: base pose normals
+	vector<float4> original;					// skinning: base pose of the unique vertices
+	vector<float4> origNormal;					// skinning: base pose normals of the unique vertices (w = 0)
+	vector<float4> skinnedPos;					// skinning: transformed unique vertices
+	vector<float4> skinnedNormal;				// skinning: transformed unique vertex normals
+	vector<uint> skinIndex;						// skinning: unique vertex index for each triangle corner
 	vector<HostTri> triangles;					// full triangles
+	vector<float4> vertexPos;					// indexed geometry: unique vertex positions
+	vector<float3> vertexNormal;				// indexed geometry: vertex normals; zero: use face normal
+	vector<float2> vertexUV0, vertexUV1;		// indexed geometry: texture coordinates
+	vector<float> vertexAlpha;					// indexed geometry: consistent normal interpolation data
+	vector<uint> indices;						// indexed geometry: three vertex indices per triangle
+	vector<int> triangleMaterial;				// indexed geometry: material per triangle
 	vector<int> materialList;					// list of materials used by the mesh; used to efficiently track light changes
-	vector<uint4> joints;						// skinning: joints
-	vector<float4> weights;						// skinning: joint weights
-	vector<Pose> poses;							// morph target data
-	bool isAnimated;							// true when this mesh has animation data
+	vector<int> emissiveTris;					// triangles with an emissive material; see GetEmissiveTriangles
+	vector<int> emissiveMaterials;				// the emissive materials emissiveTris was built for
+	int emissiveTriCount = -1;					// triangle count emissiveTris was built for; -1 forces a rebuild
+	uint emissiveVersion = 0;					// incremented whenever emissiveTris is rebuilt
+	vector<uint4> joints;						// skinning: joints, per unique vertex
+	vector<float4> weights;						// skinning: joint weights, per unique vertex
+	vector<float4> morphBasePos;				// morphing: base pose positions, per triangle corner
+	vector<float4> morphBaseNormal;				// morphing: base pose normals, per triangle corner (w = 0)
+	vector<float4> morphNormal;					// morphing: accumulated normals, per triangle corner
+	vector<MorphTarget> morphTargets;			// morphing: sparse target deltas
+	float4 boundingSphere = make_float4( 0, 0, 0, -1 );	// center and radius of the base pose; radius < 0: not calculated yet
+	bool isAnimated = false;					// true when this mesh has animation data
 	bool excludeFromNavmesh = false;			// prevents mesh from influencing navmesh generation (e.g. curtains)
+	bool hostDataReleased = false;				// true when vertices and triangles are not expanded from the indexed data
+	bool lightBound = false;					// some triangles refer to light triangles (HostTri::ltriIdx); see HostNode
 	TRACKCHANGES;								// add Changed(), MarkAsDirty() methods, see system.h
+	POOLALLOCATED( HostMesh );					// allocate from a type-specific pool, see system.h
 	// Note: design decision:
 	// Vertices and indices can be deduced from the list of HostTris, obviously. However, efficient intersection
 	// (e.g. in OptiX) requires only vertices and connectivity data. Shading on the other hand requires the full
@@ -33,12 +33,12 @@ static HostTri TransformedHostTri( HostTri* tri, mat4 T )
 //  |  HostNode::HostNode                                                         |
 //  |  Constructors.                                                        LH2'19|
 //  +-----------------------------------------------------------------------------+
-HostNode::HostNode( const tinygltfNode& gltfNode, const int nodeBase, const int meshBase, const int skinBase )
+HostNode::HostNode( HostScene* owner, const tinygltfNode& gltfNode, const int nodeBase, const int meshBase, const int skinBase ) : scene( owner )
 {
 	ConvertFromGLTFNode( gltfNode, nodeBase, meshBase, skinBase );
 }
 
-HostNode::HostNode( const int meshIdx, const mat4& transform )
+HostNode::HostNode( HostScene* owner, const int meshIdx, const mat4& transform ) : scene( owner )
 {
 	// setup a node based on a mesh index and a transform
 	meshID = meshIdx;
@@ -53,23 +53,9 @@ HostNode::HostNode( const int meshIdx, const mat4& transform )
 //  +-----------------------------------------------------------------------------+
 HostNode::~HostNode()
 {
-	if ((meshID > -1) && hasLights)
-	{
-		// this node is an instance and has emissive materials;
-		// remove the relevant area lights.
-		HostMesh* mesh = HostScene::meshPool[meshID];
-		for (auto materialIdx : mesh->materialList)
-		{
-			HostMaterial* material = HostScene::materials[materialIdx];
-			if (material->IsEmissive())
-			{
-				// mesh contains an emissive material; remove related area lights
-				vector<HostTriLight*>& lightList = HostScene::triLights;
-				for (int s = (int)lightList.size(), i = 0; i < s; i++)
-					if (lightList[i]->instIdx == ID) lightList.erase( lightList.begin() + i-- );
-			}
-		}
-	}
+	// if this node is an instance and has emissive materials,
+	// remove the relevant area lights.
+	RemoveLights();
 }
 
 //  +-----------------------------------------------------------------------------+
@@ -86,7 +72,7 @@ void HostNode::ConvertFromGLTFNode( const tinygltfNode& gltfNode, const int node
 	// if the mesh has morph targets, the node should have weights for them
 	if (meshID != -1)
 	{
-		const int morphTargets = (int)HostScene::meshPool[meshID]->poses.size() - 1;
+		const int morphTargets = (int)scene->meshPool[meshID]->morphTargets.size();
 		if (morphTargets > 0) weights.resize( morphTargets, 0.0f );
 	}
 	// copy child node indices
@@ -141,7 +127,7 @@ void HostNode::UpdateTransformFromTRS()
 //  |  child nodes. If a change is detected, the light triangles are updated      |
 //  |  as well.                                                             LH2'19|
 //  +-----------------------------------------------------------------------------+
-bool HostNode::Update( mat4& T, vector<int>& instances, int& posInInstanceArray )
+bool HostNode::Update( mat4& T, vector<int>& instances, int& posInInstanceArray, const AnimationLOD* lod )
 {
 	// update the combined transform for this node
 	bool thisWasModified = Changed();
@@ -156,19 +142,32 @@ bool HostNode::Update( mat4& T, vector<int>& instances, int& posInInstanceArray
 	// update the combined transforms of the children
 	for (int s = (int)childIdx.size(), i = 0; i < s; i++)
 	{
-		HostNode* child = HostScene::nodePool[childIdx[i]];
-		bool childChanged = child->Update( combinedTransform, instances, posInInstanceArray );
+		HostNode* child = scene->nodePool[childIdx[i]];
+		bool childChanged = child->Update( combinedTransform, instances, posInInstanceArray, lod );
 		instancesChanged |= childChanged;
 		treeChanged |= childChanged;
 	}
 	// update animations
 	if (meshID > -1)
 	{
-		if (morphed)
+		// distant meshes are re-posed at a reduced rate; skipped meshes stay clean and are not resent
+		const bool animate = (!morphed && skinID == -1) || AnimateThisFrame( lod );
+		if (morphed && animate)
 		{
-			HostScene::meshPool[meshID]->SetPose( weights );
+			scene->meshPool[meshID]->SetPose( weights );
 			morphed = false;
 		}
+		if (materialVersion != scene->materialVersion)
+		{
+			// emission changed; recreate the lights if the emissive triangles of the mesh changed, and
+			// update them if one of their materials changed
+			const uint checked = materialVersion;
+			materialVersion = scene->materialVersion;
+			HostMesh* mesh = scene->meshPool[meshID];
+			mesh->GetEmissiveTriangles();
+			if (lightVersion != mesh->emissiveVersion) RemoveLights(), PrepareLights(), thisWasModified |= hasLights; // pick up transform and radiance
+			else if (hasLights) for (int m : mesh->emissiveMaterials) if (m < (int)scene->emissionVersion.size() && scene->emissionVersion[m] > checked) thisWasModified = true;
+		}
 		if (thisWasModified && hasLights) UpdateLights();
 		if (instanceID != posInInstanceArray)
 		{
@@ -178,17 +177,17 @@ bool HostNode::Update( mat4& T, vector<int>& instances, int& posInInstanceArray
 			else
 				instances.push_back( ID );
 		}
-		if (skinID > -1)
+		if (skinID > -1 && animate)
 		{
-			HostSkin* skin = HostScene::skins[skinID];
+			HostSkin* skin = scene->skins[skinID];
 			mat4 meshTransform = combinedTransform;
 			mat4 meshTransformInverted = meshTransform.Inverted();
 			for (int s = (int)skin->joints.size(), j = 0; j < s; j++)
 			{
-				HostNode* jointNode = HostScene::nodePool[skin->joints[j]];
+				HostNode* jointNode = scene->nodePool[skin->joints[j]];
 				skin->jointMat[j] = meshTransformInverted * jointNode->combinedTransform * skin->inverseBindMatrices[j];
 			}
-			HostScene::meshPool[meshID]->SetPose( skin );
+			scene->meshPool[meshID]->SetPose( skin );
 		}
 		posInInstanceArray++;
 	}
@@ -196,62 +195,137 @@ bool HostNode::Update( mat4& T, vector<int>& instances, int& posInInstanceArray
 	return instancesChanged;
 }
 
+//  +-----------------------------------------------------------------------------+
+//  |  HostNode::AnimateThisFrame                                                 |
+//  |  Decide if the animated mesh of this node should be updated this frame.     |
+//  |  The update interval grows as the projected size of the mesh shrinks; the   |
+//  |  node ID offsets the frame counter so that updates are spread evenly over   |
+//  |  the frames of an interval.                                           LH2'21|
+//  +-----------------------------------------------------------------------------+
+bool HostNode::AnimateThisFrame( const AnimationLOD* lod )
+{
+	if (!lod) return true;
+	// estimate the projected size of the mesh using its bounding sphere
+	const float4 sphere = scene->meshPool[meshID]->GetBoundingSphere();
+	const float3 center = make_float3( combinedTransform * make_float4( make_float3( sphere ), 1 ) );
+	const float* M = combinedTransform.cell;
+	const float3 X = make_float3( M[0], M[4], M[8] ), Y = make_float3( M[1], M[5], M[9] ), Z = make_float3( M[2], M[6], M[10] );
+	const float radius = sphere.w * sqrtf( max( dot( X, X ), max( dot( Y, Y ), dot( Z, Z ) ) ) );
+	const float size = radius * lod->pixelScale / max( length( center - lod->eye ), 1e-4f );
+	if (size >= lod->fullRateSize) return true;
+	const int interval = min( lod->maxInterval, (int)ceilf( lod->fullRateSize / max( size, 1e-6f ) ) );
+	return interval <= 1 || (lod->frame + (uint)ID) % interval == 0;
+}
+
 //  +-----------------------------------------------------------------------------+
 //  |  HostNode::PrepareLights                                                    |
-//  |  Detects emissive triangles and creates light triangles for them.     LH2'19|
+//  |  Creates light triangles for the emissive triangles of the mesh. The mesh   |
+//  |  keeps the list of these, so we do not need to scan all triangles.          |
+//  |  The light index of an instance is firstLight plus the position in the      |
+//  |  emissive list. The triangles of a mesh are shared by its instances, so     |
+//  |  HostTri::ltriIdx (used by the cores for MIS) refers to the lights of the   |
+//  |  first instance only; other instances leave it alone.                 LH2'21|
 //  +-----------------------------------------------------------------------------+
 void HostNode::PrepareLights()
 {
-	if (meshID > -1)
+	materialVersion = scene->materialVersion;
+	if (meshID == -1) return;
+	HostMesh* mesh = scene->meshPool[meshID];
+	const vector<int>& emissiveTris = mesh->GetEmissiveTriangles();
+	lightVersion = mesh->emissiveVersion;
+	firstLight = (int)scene->triLights.size();
+	bool claimed = false;
+	for (int idx : emissiveTris)
 	{
-		HostMesh* mesh = HostScene::meshPool[meshID];
-		for (int s = (int)mesh->triangles.size(), i = 0; i < s; i++)
-		{
-			HostTri* tri = &mesh->triangles[i];
-			HostMaterial* mat = HostScene::materials[tri->material];
-			if (mat->IsEmissive())
-			{
-				tri->UpdateArea();
-				HostTri transformedTri = TransformedHostTri( tri, localTransform );
-				HostTriLight* light = new HostTriLight( &transformedTri, i, ID );
-				tri->ltriIdx = (int)HostScene::triLights.size(); // TODO: can't duplicate a light due to this.
-				HostScene::triLights.push_back( light );
-				hasLights = true;
-				// Note: TODO: 
-				// 1. if a mesh is deleted it should scan the list of area lights
-				//    to delete those that no longer exist.
-				// 2. if a material is changed from emissive to non-emissive,
-				//    meshes using the material should remove their light emitting
-				//    triangles from the list of area lights.
-				// 3. if a material is changed from non-emissive to emissive,
-				//    meshes using the material should update the area lights list.
-				// Item 1 can be done efficiently. Items 2 and 3 require a list
-				// of materials per mesh to be efficient.
-			}
-		}
+		HostTri* tri = &mesh->triangles[idx];
+		tri->UpdateArea();
+		HostTri transformedTri = TransformedHostTri( tri, localTransform );
+		HostTriLight* light = new HostTriLight( &transformedTri, idx, ID, scene->materials[tri->material]->color() );
+		if (tri->ltriIdx == -1) tri->ltriIdx = (int)scene->triLights.size(), claimed = true;
+		scene->triLights.push_back( light );
+		lights.push_back( light );
 	}
+	hasLights = lights.size() > 0;
+	if (!hasLights) firstLight = -1;
+	if (claimed) mesh->lightBound = true, mesh->MarkAsDirty();
 }
 
 //  +-----------------------------------------------------------------------------+
 //  |  HostNode::UpdateLights                                                     |
 //  |  Update light triangles belonging to this instance after the tansform for   |
-//  |  the node changed.                                                    LH2'19|
+//  |  the node changed. Only the lights of this instance are touched, so the     |
+//  |  RenderSystem can send just these to the core.                        LH2'21|
 //  +-----------------------------------------------------------------------------+
 void HostNode::UpdateLights()
 {
 	if (!hasLights) return;
-	HostMesh* mesh = HostScene::meshPool[meshID];
-	for (int s = (int)mesh->triangles.size(), i = 0; i < s; i++)
+	HostMesh* mesh = scene->meshPool[meshID];
+	const vector<int>& emissiveTris = mesh->emissiveTris;
+	for (int s = (int)lights.size(), i = 0; i < s; i++)
 	{
-		HostTri* tri = &mesh->triangles[i];
-		if (tri->ltriIdx > -1)
-		{
-			// triangle is light emitting; update it
+		HostTri* tri = &mesh->triangles[emissiveTris[i]];
 		tri->UpdateArea();
 		HostTri transformedTri = TransformedHostTri( tri, combinedTransform );
-			*HostScene::triLights[tri->ltriIdx] = HostTriLight( &transformedTri, i, ID );
+		const bool enabled = lights[i]->enabled;
+		*lights[i] = HostTriLight( &transformedTri, emissiveTris[i], ID, scene->materials[tri->material]->color() );
+		lights[i]->enabled = enabled;
+	}
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostNode::RemoveLights                                                     |
+//  |  Remove the light triangles of this instance from the scene, e.g. when the  |
+//  |  node is deleted or the emissive materials of its mesh changed. The block   |
+//  |  of lights is erased in one go; the lights of other nodes after it move     |
+//  |  down. Only meshes with triangles that refer to moved or erased lights are  |
+//  |  marked dirty.                                                        LH2'21|
+//  +-----------------------------------------------------------------------------+
+void HostNode::RemoveLights()
+{
+	if (!hasLights) return;
+	vector<HostTriLight*>& lightList = scene->triLights;
+	const int count = (int)lights.size();
+	int first = firstLight;
+	if (first < 0 || first + count > (int)lightList.size() || lightList[first] != lights[0])
+		first = (int)(find( lightList.begin(), lightList.end(), lights[0] ) - lightList.begin()); // moved before this node was added
+	if (first + count <= (int)lightList.size()) lightList.erase( lightList.begin() + first, lightList.begin() + first + count );
+	// move the blocks of later nodes down, and find another instance of this mesh to take over its triangles
+	HostNode* heir = nullptr;
+	vector<int> meshes( 1, meshID );
+	for (HostNode* node : scene->nodePool) if (node && node != this && node->hasLights)
+	{
+		if (node->firstLight > first) node->firstLight -= count, meshes.push_back( node->meshID );
+		if (!heir && node->meshID == meshID) heir = node;
+	}
+	sort( meshes.begin(), meshes.end() );
+	meshes.erase( unique( meshes.begin(), meshes.end() ), meshes.end() );
+	for (int id : meshes) if (id > -1 && id < (int)scene->meshPool.size())
+	{
+		HostMesh* mesh = scene->meshPool[id];
+		bool changed = false;
+		for (int idx : mesh->emissiveTris) if (idx < (int)mesh->triangles.size())
+		{
+			int& ltriIdx = mesh->triangles[idx].ltriIdx;
+			if (ltriIdx >= first + count) ltriIdx -= count, changed = true;
 		}
+		if (changed) mesh->MarkAsDirty();
+	}
+	// triangles that referred to the erased lights now refer to the lights of the heir, if any
+	HostMesh* mesh = meshID > -1 && meshID < (int)scene->meshPool.size() ? scene->meshPool[meshID] : nullptr;
+	if (mesh) for (HostTriLight* light : lights) if (light->triIdx < (int)mesh->triangles.size())
+	{
+		int& ltriIdx = mesh->triangles[light->triIdx].ltriIdx;
+		if (ltriIdx < first || ltriIdx >= first + count) continue;
+		ltriIdx = -1;
+		if (heir) for (int s = (int)heir->lights.size(), i = 0; i < s; i++)
+			if (heir->lights[i]->triIdx == light->triIdx) { ltriIdx = heir->firstLight + i; break; }
+		mesh->MarkAsDirty();
 	}
+	if (mesh && !heir) mesh->lightBound = false; // no other instance of the mesh has lights, so nothing claims its triangles
+	for (HostTriLight* light : lights) delete light;
+	lights.clear();
+	hasLights = false;
+	firstLight = -1;
 }
 
 // EOF
\ No newline at end of file
@@ -20,6 +20,20 @@
 namespace lighthouse2
 {
 
+//  +-----------------------------------------------------------------------------+
+//  |  AnimationLOD                                                               |
+//  |  Per-frame parameters for the animation update-rate policy: meshes that are |
+//  |  small on screen are re-posed every few frames instead of every frame.LH2'21|
+//  +-----------------------------------------------------------------------------+
+struct AnimationLOD
+{
+	float3 eye;							// camera position
+	float pixelScale;					// projected size in pixels of a unit radius at unit distance
+	float fullRateSize;					// meshes with a larger projected size are animated every frame
+	int maxInterval;					// maximum number of frames between two updates
+	uint frame;							// frame counter, used to stagger updates over frames
+};
+
 //  +-----------------------------------------------------------------------------+
 //  |  HostNode                                                                   |
 //  |  Simple node for construction of a scene graph for the scene.               |
@@ -30,15 +44,17 @@ class HostNode
 public:
 	// constructor / destructor
 	HostNode() = default;
-	HostNode( const int meshIdx, const mat4& transform );
-	HostNode( const tinygltfNode& gltfNode, const int nodeBase, const int meshBase, const int skinBase );
+	HostNode( HostScene* owner, const int meshIdx, const mat4& transform );
+	HostNode( HostScene* owner, const tinygltfNode& gltfNode, const int nodeBase, const int meshBase, const int skinBase );
 	~HostNode();
 	// methods
 	void ConvertFromGLTFNode( const tinygltfNode& gltfNode, const int nodeBase, const int meshBase, const int skinBase );
-	bool Update( mat4& T, vector<int>& instances, int& instanceIdx );	// recursively update the transform of this node and its children
+	bool Update( mat4& T, vector<int>& instances, int& instanceIdx, const AnimationLOD* lod = 0 );	// recursively update the transform of this node and its children
+	bool AnimateThisFrame( const AnimationLOD* lod );	// apply the animation LOD policy to the mesh of this node
 	void UpdateTransformFromTRS();		// process T, R, S data to localTransform
 	void PrepareLights();				// detects emissive triangles and creates light triangles for them
 	void UpdateLights();				// when the transform changes, this fixes the light triangles
+	void RemoveLights();				// removes the light triangles of this instance from the scene
 	// data members
 	string name;						// node name as specified in the GLTF file
 	mat4 combinedTransform;				// transform combined with ancestor transforms
@@ -48,15 +64,21 @@ public:
 	float3 scale = make_float3( 1 );
 	mat4 matrix;
 	int ID = -1;						// unique ID for the node: position in node array
+	HostScene* scene = nullptr;			// the scene that holds this node; set by HostScene::AddInstance
 	int meshID = -1;					// id of the mesh this node refers to (if any, -1 otherwise)
 	int skinID = -1;					// id of the skin this node refers to (if any, -1 otherwise)
 	vector<float> weights;				// morph target weights
 	bool hasLights = false;				// true if this instance uses an emissive material
+	vector<HostTriLight*> lights;		// light triangles of this instance, one per mesh->emissiveTris entry
+	int firstLight = -1;				// index of lights[0] in scene->triLights; the lights of a node are contiguous
+	uint lightVersion = 0;				// mesh->emissiveVersion the lights were created for
+	uint materialVersion = 0;			// scene->materialVersion the lights were last checked against
 	bool morphed = false;				// node mesh should update pose
 	bool transformed = false;			// local transform of node should be updated
 	bool treeChanged = false;			// this node or one of its children got updated
 	vector<int> childIdx;				// child nodes of this node
 	TRACKCHANGES;
+	POOLALLOCATED( HostNode );			// allocate from a type-specific pool, see system.h
 protected:
 	friend class RenderSystem;
 	int instanceID = -1;				// for mesh nodes: location in the instance array. For internal use only.
@@ -0,0 +1,364 @@
+/* host_objparser.cpp - Copyright 2019/2021 Utrecht University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   Parallel OBJ parser, used by HostMesh::LoadGeometryFromOBJ. Each chunk
+   of the file is parsed independently. Data that depends on preceding
+   chunks is fixed up during the merge:
+   - negative (relative) vertex indices are stored relative to the start
+	 of the chunk, and offset by the number of vertices in earlier chunks;
+   - triangles before the first 'usemtl' of a chunk use the material that
+	 was active at the end of the previous chunk;
+   - polygons with more than three corners are triangulated once the
+	 positions of all chunks are available.
+*/
+
+#include "rendersystem.h"
+
+#define OBJ_CHUNKSIZE (4 << 20) // bytes of OBJ text per parsing task
+
+//  +-----------------------------------------------------------------------------+
+//  |  OBJParser::Chunk                                                           |
+//  |  Parsing state and output of a single chunk of the file.              LH2'21|
+//  +-----------------------------------------------------------------------------+
+struct OBJParser::Chunk
+{
+	const char* begin, * end;				// the text of this chunk; starts at a line
+	vector<float3> positions, normals;
+	vector<float2> uvs;
+	vector<int3> corners;					// indices; see 'relative'
+	vector<size_t> relative;				// corner * 3 + component, for indices relative to the chunk start
+	vector<int2> polygons;					// polygons with more than three corners: first triangle, corner count
+	vector<int> materialNames;				// per triangle: index in 'names'; -1: active material of the previous chunk
+	vector<string> names;					// material names used in this chunk
+	vector<string> libraries;				// mtllib files referenced in this chunk
+	int lastMaterial = -1;					// index in 'names' of the material that is active at the end; -1: none
+	string error;
+};
+
+// parsing helpers; all of these stop at 'end'
+static inline bool IsBlank( const char c ) { return c == ' ' || c == '\t' || c == '\r'; }
+static inline bool IsDigit( const char c ) { return c >= '0' && c <= '9'; }
+static inline void SkipBlanks( const char*& p, const char* end ) { while (p < end && IsBlank( *p )) p++; }
+static inline bool StartsWith( const char* p, const char* end, const char* token, const size_t length )
+{
+	// the token must be followed by a blank
+	return (size_t)(end - p) > length && memcmp( p, token, length ) == 0 && IsBlank( p[length] );
+}
+static string ParseName( const char*& p, const char* end )
+{
+	SkipBlanks( p, end );
+	const char* first = p;
+	while (p < end && !IsBlank( *p )) p++;
+	return string( first, p );
+}
+static int ParseInt( const char*& p, const char* end )
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+	int value = 0;
+	while (p < end && IsDigit( *p )) value = value * 10 + (*p++ - '0');
+	return negative ? -value : value;
+}
+static float ParseFloat( const char*& p, const char* end )
+{
+	// decimal mantissa and exponent; digits beyond 18 significant ones are ignored
+	static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	SkipBlanks( p, end );
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	for (; p < end && IsDigit( *p ); p++) if (mantissa < 100000000000000000ull) mantissa = mantissa * 10 + (*p - '0'); else exponent++;
+	if (p < end && *p == '.') for (p++; p < end && IsDigit( *p ); p++)
+		if (mantissa < 100000000000000000ull) mantissa = mantissa * 10 + (*p - '0'), exponent--;
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		p++;
+		bool negativeExponent = false;
+		if (p < end && (*p == '-' || *p == '+')) negativeExponent = *p++ == '-';
+		int e = 0;
+		for (; p < end && IsDigit( *p ); p++) if (e < 1000) e = e * 10 + (*p - '0');
+		exponent += negativeExponent ? -e : e;
+	}
+	double value = (double)mantissa;
+	const int e = abs( exponent );
+	const double scale = e <= 22 ? pow10[e] : pow( 10.0, (double)e );
+	value = exponent < 0 ? value / scale : value * scale;
+	return (float)(negative ? -value : value);
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  Triangulate                                                                |
+//  |  Replace the fan of a polygon with more than three corners by triangles     |
+//  |  obtained by ear clipping, so that concave polygons are handled correctly.  |
+//  |  The polygon is projected on the plane of its largest Newell normal         |
+//  |  component. If no ear is found (e.g. self-intersecting polygons), the       |
+//  |  remaining corners are cut off one by one.                            LH2'21|
+//  +-----------------------------------------------------------------------------+
+static void Triangulate( const vector<float3>& positions, int3* tris, const int cornerCount )
+{
+	// recover the polygon from the fan: (c0, c1, c2), (c0, c2, c3), ...
+	vector<int3> polygon( cornerCount );
+	polygon[0] = tris[0], polygon[1] = tris[1];
+	for (int i = 2; i < cornerCount; i++) polygon[i] = tris[(i - 2) * 3 + 2];
+	// projection axes
+	float3 N = make_float3( 0 );
+	for (int i = 0; i < cornerCount; i++)
+	{
+		const float3 a = positions[polygon[i].x], b = positions[polygon[(i + 1) % cornerCount].x];
+		N += make_float3( (a.y - b.y) * (a.z + b.z), (a.z - b.z) * (a.x + b.x), (a.x - b.x) * (a.y + b.y) );
+	}
+	const int axis = fabs( N.x ) > fabs( N.y ) ? (fabs( N.x ) > fabs( N.z ) ? 0 : 2) : (fabs( N.y ) > fabs( N.z ) ? 1 : 2);
+	const float orientation = (axis == 0 ? N.x : axis == 1 ? N.y : N.z) < 0 ? -1.0f : 1.0f;
+	auto project = [&]( const int3& corner ) {
+		const float3 p = positions[corner.x];
+		return axis == 0 ? make_float2( p.y, p.z ) : axis == 1 ? make_float2( p.z, p.x ) : make_float2( p.x, p.y );
+	};
+	auto area = []( const float2 a, const float2 b, const float2 c ) { return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x); };
+	// clip ears
+	vector<int> remaining( cornerCount );
+	for (int i = 0; i < cornerCount; i++) remaining[i] = i;
+	int triIdx = 0;
+	while (remaining.size() > 3)
+	{
+		const int n = (int)remaining.size();
+		int ear = -1;
+		for (int i = 0; i < n && ear == -1; i++)
+		{
+			const float2 a = project( polygon[remaining[(i + n - 1) % n]] ), b = project( polygon[remaining[i]] ), c = project( polygon[remaining[(i + 1) % n]] );
+			if (area( a, b, c ) * orientation <= 0) continue; // reflex or degenerate corner
+			bool inside = false;
+			for (int j = 0; j < n && !inside; j++) if (j != i && j != (i + 1) % n && j != (i + n - 1) % n)
+			{
+				const float2 p = project( polygon[remaining[j]] );
+				inside = area( a, b, p ) * orientation >= 0 && area( b, c, p ) * orientation >= 0 && area( c, a, p ) * orientation >= 0;
+			}
+			if (!inside) ear = i;
+		}
+		if (ear == -1) ear = 0;
+		tris[triIdx * 3 + 0] = polygon[remaining[(ear + n - 1) % n]];
+		tris[triIdx * 3 + 1] = polygon[remaining[ear]];
+		tris[triIdx * 3 + 2] = polygon[remaining[(ear + 1) % n]];
+		triIdx++;
+		remaining.erase( remaining.begin() + ear );
+	}
+	tris[triIdx * 3 + 0] = polygon[remaining[0]];
+	tris[triIdx * 3 + 1] = polygon[remaining[1]];
+	tris[triIdx * 3 + 2] = polygon[remaining[2]];
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  OBJParser::ParseChunk                                                      |
+//  |  Parse the lines of a chunk. Lines other than v, vn, vt, f, usemtl and      |
+//  |  mtllib are ignored.                                                  LH2'21|
+//  +-----------------------------------------------------------------------------+
+void OBJParser::ParseChunk( Chunk& chunk )
+{
+	vector<int3> polygon;
+	vector<int> polygonRelative;			// per polygon corner: relative components, bit 0..2 for x..z
+	unordered_map<string, int> nameIdx;
+	int material = -1;
+	for (const char* p = chunk.begin; p < chunk.end && chunk.error.empty();)
+	{
+		const char* lineEnd = (const char*)memchr( p, '\n', chunk.end - p );
+		if (!lineEnd) lineEnd = chunk.end;
+		SkipBlanks( p, lineEnd );
+		const char* line = p;
+		if (StartsWith( p, lineEnd, "v", 1 ))
+		{
+			p += 1;
+			const float x = ParseFloat( p, lineEnd ), y = ParseFloat( p, lineEnd ), z = ParseFloat( p, lineEnd );
+			chunk.positions.push_back( make_float3( x, y, z ) );
+		}
+		else if (StartsWith( p, lineEnd, "vn", 2 ))
+		{
+			p += 2;
+			const float x = ParseFloat( p, lineEnd ), y = ParseFloat( p, lineEnd ), z = ParseFloat( p, lineEnd );
+			chunk.normals.push_back( make_float3( x, y, z ) );
+		}
+		else if (StartsWith( p, lineEnd, "vt", 2 ))
+		{
+			p += 2;
+			const float u = ParseFloat( p, lineEnd ), v = ParseFloat( p, lineEnd );
+			chunk.uvs.push_back( make_float2( u, v ) );
+		}
+		else if (StartsWith( p, lineEnd, "f", 1 ))
+		{
+			// read the corners of the polygon: v, v/vt, v//vn or v/vt/vn
+			polygon.clear();
+			polygonRelative.clear();
+			for (p += 1, SkipBlanks( p, lineEnd ); p < lineEnd; SkipBlanks( p, lineEnd ))
+			{
+				int value[3] = { 0, 0, 0 };
+				value[0] = ParseInt( p, lineEnd );
+				if (p < lineEnd && *p == '/')
+				{
+					p++;
+					if (p < lineEnd && *p != '/') value[1] = ParseInt( p, lineEnd );
+					if (p < lineEnd && *p == '/') p++, value[2] = ParseInt( p, lineEnd );
+				}
+				if ((p < lineEnd && !IsBlank( *p )) || value[0] == 0) { chunk.error = "invalid face: " + string( line, lineEnd ); break; }
+				// 1-based absolute indices become 0-based; relative indices are resolved against the chunk
+				const size_t counts[3] = { chunk.positions.size(), chunk.uvs.size(), chunk.normals.size() };
+				int3 corner = make_int3( -1 );
+				int relative = 0;
+				for (int i = 0; i < 3; i++)
+				{
+					int& idx = i == 0 ? corner.x : i == 1 ? corner.y : corner.z;
+					if (value[i] > 0) idx = value[i] - 1;
+					else if (value[i] < 0) idx = (int)counts[i] + value[i], relative |= 1 << i;
+				}
+				polygon.push_back( corner );
+				polygonRelative.push_back( relative );
+			}
+			// store as a fan for now; larger polygons are triangulated properly once all positions are known
+			if (polygon.size() > 3) chunk.polygons.push_back( make_int2( (int)chunk.materialNames.size(), (int)polygon.size() ) );
+			for (int s = (int)polygon.size(), i = 2; i < s; i++)
+			{
+				const int fan[3] = { 0, i - 1, i };
+				for (int j = 0; j < 3; j++)
+				{
+					const size_t corner = chunk.corners.size();
+					for (int k = 0; k < 3; k++) if (polygonRelative[fan[j]] & (1 << k)) chunk.relative.push_back( corner * 3 + k );
+					chunk.corners.push_back( polygon[fan[j]] );
+				}
+				chunk.materialNames.push_back( material );
+			}
+		}
+		else if (StartsWith( p, lineEnd, "usemtl", 6 ))
+		{
+			p += 6;
+			SkipBlanks( p, lineEnd );
+			const char* last = lineEnd;
+			while (last > p && IsBlank( last[-1] )) last--;
+			const string name( p, last );
+			auto known = nameIdx.find( name );
+			if (known != nameIdx.end()) material = known->second; else
+			{
+				material = nameIdx[name] = (int)chunk.names.size();
+				chunk.names.push_back( name );
+			}
+		}
+		else if (StartsWith( p, lineEnd, "mtllib", 6 ))
+		{
+			for (p += 6, SkipBlanks( p, lineEnd ); p < lineEnd; SkipBlanks( p, lineEnd )) chunk.libraries.push_back( ParseName( p, lineEnd ) );
+		}
+		p = lineEnd + 1;
+	}
+	chunk.lastMaterial = material;
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  OBJParser::Parse                                                           |
+//  |  Parse an OBJ file and the material libraries it uses. Returns false and    |
+//  |  sets 'error' if the file cannot be read or is malformed.             LH2'21|
+//  +-----------------------------------------------------------------------------+
+bool OBJParser::Parse( const char* fileName, const char* directory )
+{
+	MappedFile file( fileName );
+	if (!file.IsOpen()) { error = "could not open file"; return false; }
+	// split the file in line-aligned chunks
+	const char* text = (const char*)file.data, * textEnd = text + file.size;
+	vector<Chunk> chunks( (file.size + OBJ_CHUNKSIZE - 1) / OBJ_CHUNKSIZE );
+	for (size_t s = chunks.size(), i = 0; i < s; i++)
+	{
+		const char* begin = i == 0 ? text : chunks[i - 1].end;
+		const char* end = i == s - 1 ? textEnd : max( begin, text + (i + 1) * OBJ_CHUNKSIZE );
+		while (end < textEnd && end[-1] != '\n') end++;
+		chunks[i].begin = begin, chunks[i].end = end;
+	}
+	// parse the chunks
+	tf::Taskflow parseFlow;
+	for (Chunk& chunk : chunks) parseFlow.emplace( [&chunk]() { ParseChunk( chunk ); } );
+	HostTaskExecutor().run( parseFlow ).wait();
+	for (Chunk& chunk : chunks) if (!chunk.error.empty()) { error = chunk.error; return false; }
+	// load the material libraries, relative to the directory of the obj file
+	map<string, int> materialMap;
+	vector<string> libraries;
+	for (Chunk& chunk : chunks) for (const string& library : chunk.libraries)
+	{
+		if (find( libraries.begin(), libraries.end(), library ) != libraries.end()) continue;
+		libraries.push_back( library );
+		std::ifstream stream( string( directory ) + "/" + library );
+		if (!stream) { printf( "material library %s not found\n", library.c_str() ); continue; }
+		libraryFiles.push_back( string( directory ) + "/" + library );
+		string warn, err;
+		tinyobj::LoadMtl( &materialMap, &materials, &stream, &warn, &err );
+		if (!err.empty()) printf( "%s: %s\n", library.c_str(), err.c_str() );
+	}
+	// offsets of the chunks in the merged streams, and the material that is active at the start of each chunk
+	const size_t chunkCount = chunks.size();
+	vector<size_t> positionBase( chunkCount + 1, 0 ), uvBase( chunkCount + 1, 0 ), normalBase( chunkCount + 1, 0 ), cornerBase( chunkCount + 1, 0 );
+	vector<vector<int>> chunkMaterials( chunkCount );
+	vector<int> activeMaterial( chunkCount + 1, -1 );
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		Chunk& chunk = chunks[i];
+		positionBase[i + 1] = positionBase[i] + chunk.positions.size();
+		uvBase[i + 1] = uvBase[i] + chunk.uvs.size();
+		normalBase[i + 1] = normalBase[i] + chunk.normals.size();
+		cornerBase[i + 1] = cornerBase[i] + chunk.corners.size();
+		for (const string& name : chunk.names)
+		{
+			auto known = materialMap.find( name );
+			chunkMaterials[i].push_back( known == materialMap.end() ? -1 : known->second );
+		}
+		activeMaterial[i + 1] = chunk.lastMaterial == -1 ? activeMaterial[i] : chunkMaterials[i][chunk.lastMaterial];
+	}
+	if (positionBase[chunkCount] > INT_MAX || cornerBase[chunkCount] > INT_MAX) { error = "file too large"; return false; }
+	// merge the chunks
+	positions.resize( positionBase[chunkCount] );
+	uvs.resize( uvBase[chunkCount] );
+	normals.resize( normalBase[chunkCount] );
+	corners.resize( cornerBase[chunkCount] );
+	materialIds.resize( cornerBase[chunkCount] / 3 );
+	vector<char> invalid( chunkCount, 0 );
+	tf::Taskflow mergeFlow;
+	for (size_t i = 0; i < chunkCount; i++) mergeFlow.emplace( [&, i]() {
+		Chunk& chunk = chunks[i];
+		copy( chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionBase[i] );
+		copy( chunk.uvs.begin(), chunk.uvs.end(), uvs.begin() + uvBase[i] );
+		copy( chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalBase[i] );
+		for (size_t r : chunk.relative)
+		{
+			int3& corner = chunk.corners[r / 3];
+			if (r % 3 == 0) corner.x += (int)positionBase[i];
+			else if (r % 3 == 1) corner.y += (int)uvBase[i];
+			else corner.z += (int)normalBase[i];
+		}
+		for (const int3& corner : chunk.corners)
+			if (corner.x < 0 || corner.x >= (int)positions.size() || corner.y >= (int)uvs.size() || corner.z >= (int)normals.size() ||
+				corner.y < -1 || corner.z < -1) invalid[i] = 1;
+		copy( chunk.corners.begin(), chunk.corners.end(), corners.begin() + cornerBase[i] );
+		int* ids = materialIds.data() + cornerBase[i] / 3;
+		for (size_t s = chunk.materialNames.size(), t = 0; t < s; t++)
+			ids[t] = chunk.materialNames[t] == -1 ? activeMaterial[i] : chunkMaterials[i][chunk.materialNames[t]];
+		// release the chunk data early; the polygons are needed for triangulation
+		vector<int2> polygons = move( chunk.polygons );
+		chunk = Chunk();
+		chunk.polygons = move( polygons );
+	} );
+	HostTaskExecutor().run( mergeFlow ).wait();
+	for (char bad : invalid) if (bad) { error = "vertex index out of range"; return false; }
+	// triangulate; polygons may use the positions of any chunk, so this waits for the complete merge
+	tf::Taskflow triangulateFlow;
+	for (size_t i = 0; i < chunkCount; i++) if (chunks[i].polygons.size() > 0) triangulateFlow.emplace( [&, i]() {
+		for (const int2& polygon : chunks[i].polygons) Triangulate( positions, corners.data() + cornerBase[i] + polygon.x * 3, polygon.y );
+	} );
+	if (triangulateFlow.num_nodes() > 0) HostTaskExecutor().run( triangulateFlow ).wait();
+	return true;
+}
+
+// EOF
@@ -0,0 +1,49 @@
+/* host_objparser.h - Copyright 2019/2021 Utrecht University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#pragma once
+
+namespace lighthouse2
+{
+
+//  +-----------------------------------------------------------------------------+
+//  |  OBJParser                                                                  |
+//  |  Parallel parser for Wavefront OBJ files. The file is mapped into memory    |
+//  |  and split into line-aligned chunks, which are parsed on the worker pool;   |
+//  |  the streams of the chunks are then merged, also in parallel. Polygons are  |
+//  |  triangulated by ear clipping. Material libraries are loaded from the       |
+//  |  directory of the OBJ file; the working directory is not used.        LH2'21|
+//  +-----------------------------------------------------------------------------+
+class OBJParser
+{
+public:
+	bool Parse( const char* fileName, const char* directory );
+	// parsed data
+	vector<float3> positions;				// 'v' lines
+	vector<float3> normals;					// 'vn' lines
+	vector<float2> uvs;						// 'vt' lines
+	vector<int3> corners;					// three per triangle: position (x), uv (y) and normal (z) index; -1 if absent
+	vector<int> materialIds;				// per triangle: index in 'materials', or -1
+	vector<tinyobjMaterial> materials;		// materials from the mtllib files
+	vector<string> libraryFiles;			// paths of the mtllib files that were read
+	string error;							// reason for failure if Parse returned false
+private:
+	struct Chunk;
+	static void ParseChunk( Chunk& chunk );
+};
+
+} // namespace lighthouse2
+
+// EOF
@@ -14,11 +14,83 @@
 */
 
 #include "rendersystem.h"
+#include <filesystem>
+#include "stb_image.h"
 
 // forward declaration of the PBRT scene loader functions
-void PBRTInit();
+void PBRTInit( HostScene* scene );
 void ParsePBRTScene( std::string filename );
 
+// the PBRT loader keeps its parsing state in globals; scenes load .pbrt files one at a time
+static mutex pbrtLoaderMutex;
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostScene::SceneAsset                                                      |
+//  |  What AddScene needs to place a glTF file again without loading it: the     |
+//  |  objects created by the first load, and the node hierarchy of the file,     |
+//  |  which is instantiated for every placement.                           LH2'21|
+//  +-----------------------------------------------------------------------------+
+struct HostScene::SceneAsset
+{
+	int meshBase, meshCount;						// meshes of the first load
+	int skinBase, skinCount;						// skins of the first load
+	int animBase, animCount;						// animations of the first load
+	int nodeBase;									// first glTF node of the first load
+	vector<tinygltf::Node> nodes;					// glTF nodes; mesh and child indices as in the file
+	vector<int> rootNodes;							// root nodes of the first glTF scene
+};
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostScene::SceneLoad                                                       |
+//  |  A file requested with AddSceneAsync. Without a staging scene, the file is  |
+//  |  a glTF file that is loaded already; it is placed again at commit.    LH2'21|
+//  +-----------------------------------------------------------------------------+
+struct HostScene::SceneLoad
+{
+	int id;											// index in HostScene::sceneLoadNodes
+	string file, assetKey;							// requested file; its key in sceneAssets, for glTF files
+	mat4 transform;
+	HostScene* staging = nullptr;					// the scene the file is loaded into
+	future<int> node;								// node returned by AddScene on the staging scene
+};
+
+//  +-----------------------------------------------------------------------------+
+//  |  DeferImageDecode                                                           |
+//  |  Image loader callback for tinygltf. Instead of decoding, it keeps the      |
+//  |  encoded image and only reads the dimensions from its header; AddScene      |
+//  |  decodes the images on the worker pool.                               LH2'21|
+//  +-----------------------------------------------------------------------------+
+static bool DeferImageDecode( tinygltf::Image* image, const int imageIdx, string* err, string*, int, int, const uchar* bytes, int size, void* )
+{
+	int w, h, comp;
+	if (!stbi_info_from_memory( bytes, size, &w, &h, &comp ))
+	{
+		if (err) *err += "unknown image format for image[" + to_string( imageIdx ) + "]\n";
+		return false;
+	}
+	image->width = w, image->height = h;
+	image->component = 4, image->bits = 8;
+	image->pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+	image->image.assign( bytes, bytes + size );
+	return true;
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  SceneAssetKey                                                              |
+//  |  Key for a glTF file in the asset registry: canonical path and time of the  |
+//  |  last modification, so a file that changed on disk is loaded again. Empty   |
+//  |  if the file cannot be inspected; such files are not registered.      LH2'21|
+//  +-----------------------------------------------------------------------------+
+static string SceneAssetKey( const string& fileName )
+{
+	std::error_code error;
+	const std::filesystem::path path = std::filesystem::weakly_canonical( fileName, error );
+	if (error) return string();
+	const auto modified = std::filesystem::last_write_time( path, error );
+	if (error) return string();
+	return path.string() + "@" + to_string( modified.time_since_epoch().count() );
+}
+
 //  +-----------------------------------------------------------------------------+
 //  |  HostScene::HostScene                                                       |
 //  |  Constructor.                                                         LH2'19|
@@ -33,8 +105,27 @@ HostScene::HostScene()
 //  +-----------------------------------------------------------------------------+
 HostScene::~HostScene()
 {
-	// clean up allocated objects
+	// loading threads still use their staging scenes
+	for (SceneLoad* load : sceneLoads)
+	{
+		if (load->node.valid()) load->node.wait();
+		delete load->staging;
+		delete load;
+	}
+	// clean up allocated objects; nodes first, these remove their light triangles from the scene
+	for (int s = (int)nodePool.size(), i = 0; i < s; i++)
+	{
+		HostNode* node = nodePool[i];
+		nodePool[i] = 0;
+		delete node;
+	}
+	for (auto anim : animations) delete anim;
+	for (auto skin : skins) delete skin;
+	for (auto light : pointLights) delete light;
+	for (auto light : spotLights) delete light;
+	for (auto light : directionalLights) delete light;
 	for (auto mesh : meshPool) delete mesh;
+	for (auto asset : sceneAssets) delete asset.second;
 	for (auto material : materials) delete material;
 	for (auto texture : textures) delete texture;
 	delete sky;
@@ -115,9 +206,9 @@ void HostScene::DeserializeMaterials( const char* xmlFile )
 		if (!entry) continue;
 		// set the properties
 		const char* materialName = entry->FirstChildElement( "name" )->GetText();
-		int matID = HostScene::FindMaterialID( materialName );
+		int matID = FindMaterialID( materialName );
 		if (matID == -1) continue;
-		HostMaterial* m /* for brevity */ = HostScene::materials[matID];
+		HostMaterial* m /* for brevity */ = materials[matID];
 		if (entry->FirstChildElement( "flags" )) entry->FirstChildElement( "flags" )->QueryUnsignedText( &m->flags );
 		XMLElement* color = entry->FirstChildElement( "color" );
 		if (color)
@@ -180,6 +271,7 @@ int HostScene::AddMesh( HostMesh* mesh )
 		}
 	}
 	// add the mesh
+	mesh->scene = this;
 	mesh->ID = (int)meshPool.size();
 	meshPool.push_back( mesh );
 	return mesh->ID;
@@ -202,7 +294,8 @@ int HostScene::AddMesh( const char* objFile, const float scale, const bool flatS
 }
 int HostScene::AddMesh( const char* objFile, const char* dir, const float scale, const bool flatShaded )
 {
-	HostMesh* newMesh = new HostMesh( objFile, dir, scale, flatShaded );
+	HostMesh* newMesh = new HostMesh( this, objFile, dir, scale, flatShaded );
+	AddSourceFile( string( dir ) + "/" + string( objFile ) );
 	return AddMesh( newMesh );
 }
 
@@ -224,7 +317,8 @@ int HostScene::AddMesh( const int triCount )
 //  +-----------------------------------------------------------------------------+
 void HostScene::AddTriToMesh( const int meshId, const float3& v0, const float3& v1, const float3& v2, const int matId )
 {
-	HostMesh* m = HostScene::meshPool[meshId];
+	HostMesh* m = meshPool[meshId];
+	m->RestoreHostData();
 	m->vertices.push_back( make_float4( v0, 1 ) );
 	m->vertices.push_back( make_float4( v1, 1 ) );
 	m->vertices.push_back( make_float4( v2, 1 ) );
@@ -242,7 +336,9 @@ void HostScene::AddTriToMesh( const int meshId, const float3& v0, const float3&
 //  +-----------------------------------------------------------------------------+
 //  |  HostScene::AddScene                                                        |
 //  |  Loads a collection of meshes from a gltf file. An instance and a scene     |
-//  |  graph node is created for each mesh.                                 LH2'19|
+//  |  graph node is created for each mesh. When the same file (unmodified) was   |
+//  |  added before, its meshes are reused rather than loaded again; see          |
+//  |  HostScene::InstantiateSceneAsset.                                    LH2'19|
 //  +-----------------------------------------------------------------------------+
 int HostScene::AddScene( const char* sceneFile, const mat4& transform )
 {
@@ -256,8 +352,10 @@ int HostScene::AddScene( const char* sceneFile, const mat4& transform )
 	if (strstr( lastSlash + 1, ".pbrt" ))
 	{
 		// load a .pbrt scene
-		PBRTInit();
+		lock_guard<mutex> lock( pbrtLoaderMutex );
+		PBRTInit( this );
 		ParsePBRTScene( sceneFile );
+		AddSourceFile( sceneFile );
 	}
 	else
 	{
@@ -275,10 +373,16 @@ int HostScene::AddScene( const char* sceneFile, const char* dir, const mat4& tra
 	const int skinBase = (int)skins.size();
 	const int retVal = (int)nodePool.size();
 	const int nodeBase = (int)nodePool.size() + 1;
-	// load gltf file
+	const int animBase = (int)animations.size();
+	// place the file again if it was loaded before
 	string cleanFileName = string( dir ) + (dir[strlen( dir ) - 1] == '/' ? "" : "/") + string( sceneFile );
+	const string assetKey = SceneAssetKey( cleanFileName );
+	auto loadedAsset = sceneAssets.find( assetKey );
+	if (loadedAsset != sceneAssets.end()) return InstantiateSceneAsset( *loadedAsset->second, transform );
+	// load gltf file
 	tinygltf::Model gltfModel;
 	tinygltf::TinyGLTF loader;
+	loader.SetImageLoader( DeferImageDecode, nullptr );
 	string err, warn;
 	bool ret = false;
 	if (cleanFileName.size() > 4)
@@ -293,8 +397,18 @@ int HostScene::AddScene( const char* sceneFile, const char* dir, const mat4& tra
 	if (!warn.empty()) printf( "Warn: %s\n", warn.c_str() );
 	if (!err.empty()) printf( "Err: %s\n", err.c_str() );
 	FATALERROR_IF( !ret, "could not load glTF file:\n%s", cleanFileName.c_str() );
-	// convert textures
+	AddSourceFile( cleanFileName );
+	// external buffers and images are read by the loader as well
+	const string fileDir = cleanFileName.substr( 0, cleanFileName.find_last_of( '/' ) + 1 );
+	for (const tinygltf::Buffer& buffer : gltfModel.buffers) if (buffer.uri.size() > 0 && buffer.uri.compare( 0, 5, "data:" ) != 0) AddSourceFile( fileDir + buffer.uri );
+	for (const tinygltf::Image& image : gltfModel.images) if (image.uri.size() > 0 && image.uri.compare( 0, 5, "data:" ) != 0) AddSourceFile( fileDir + image.uri );
+	// convert textures; the images are decoded and MIP-mapped on the worker pool while the
+	// materials and meshes are converted. Code that needs the texels of one of these textures
+	// waits for it in HostTexture::RestoreTexels.
 	vector<int> texIdx;
+	vector<HostTexture*> newTextures;
+	vector<promise<void>> decoded( gltfModel.textures.size() );
+	tf::Taskflow decodeFlow;
 	for (size_t s = gltfModel.textures.size(), i = 0; i < s; i++)
 	{
 		char t[1024];
@@ -311,19 +425,25 @@ int HostScene::AddScene( const char* sceneFile, const char* dir, const mat4& tra
 			tinygltf::Texture& gltfTexture = gltfModel.textures[i];
 			HostTexture* texture = new HostTexture();
 			const tinygltf::Image& image = gltfModel.images[gltfTexture.source];
-			const size_t size = image.component * image.width * image.height;
 			texture->name = t;
 			texture->width = image.width;
 			texture->height = image.height;
 			texture->idata = (uchar4*)MALLOC64( texture->PixelsNeeded( image.width, image.height, MIPLEVELCOUNT ) * sizeof( uint ) );
 			texture->ID = (uint)textures.size();
 			texture->flags |= HostTexture::LDR;
-			memcpy( texture->idata, image.image.data(), size );
-			texture->ConstructMIPmaps();
+			texture->encoded = image.image; // kept so the texels can be released and decoded again
+			texture->decoding = decoded[i].get_future().share();
+			promise<void>* done = &decoded[i];
+			decodeFlow.emplace( [texture, done]() {
+				texture->Decode();
+				done->set_value();
+			} );
 			textures.push_back( texture );
+			newTextures.push_back( texture );
 			texIdx.push_back( texture->ID );
 		}
 	}
+	future<void> texturesDecoded = HostTaskExecutor().run( decodeFlow );
 	// convert materials
 	vector<int> matIdx;
 	for (size_t s = gltfModel.materials.size(), i = 0; i < s; i++)
@@ -343,7 +463,7 @@ int HostScene::AddScene( const char* sceneFile, const char* dir, const mat4& tra
 			HostMaterial* material = new HostMaterial();
 			material->ID = (int)materials.size();
 			material->origin = t;
-			material->ConvertFrom( gltfMaterial, gltfModel, texIdx );
+			material->ConvertFrom( gltfMaterial, gltfModel, texIdx, this );
 			material->flags |= HostMaterial::FROM_MTL;
 			materials.push_back( material );
 			matIdx.push_back( material->ID );
@@ -354,12 +474,13 @@ int HostScene::AddScene( const char* sceneFile, const char* dir, const mat4& tra
 	for (size_t s = gltfModel.meshes.size(), i = 0; i < s; i++)
 	{
 		tinygltf::Mesh& gltfMesh = gltfModel.meshes[i];
-		HostMesh* newMesh = new HostMesh( gltfMesh, gltfModel, matIdx, gltfModel.materials.size() == 0 ? 0 : -1 );
+		HostMesh* newMesh = new HostMesh( this, gltfMesh, gltfModel, matIdx, gltfModel.materials.size() == 0 ? 0 : -1 );
 		newMesh->ID = (int)i + meshBase;
 		meshPool.push_back( newMesh );
 	}
 	// push an extra node that holds a transform for the gltf scene
 	HostNode* newNode = new HostNode();
+	newNode->scene = this;
 	newNode->localTransform = transform;
 	newNode->ID = nodeBase - 1;
 	nodePool.push_back( newNode );
@@ -367,14 +488,14 @@ int HostScene::AddScene( const char* sceneFile, const char* dir, const mat4& tra
 	for (size_t s = gltfModel.nodes.size(), i = 0; i < s; i++)
 	{
 		tinygltf::Node& gltfNode = gltfModel.nodes[i];
-		HostNode* newNode = new HostNode( gltfNode, nodeBase, meshBase, skinBase );
+		HostNode* newNode = new HostNode( this, gltfNode, nodeBase, meshBase, skinBase );
 		newNode->ID = (int)nodePool.size();
 		nodePool.push_back( newNode );
 	}
 	// convert animations and skins
 	for (tinygltf::Animation& gltfAnim : gltfModel.animations)
 	{
-		HostAnimation* anim = new HostAnimation( gltfAnim, gltfModel, nodeBase );
+		HostAnimation* anim = new HostAnimation( this, gltfAnim, gltfModel, nodeBase );
 		animations.push_back( anim );
 	}
 	for (tinygltf::Skin& source : gltfModel.skins)
@@ -387,11 +508,281 @@ int HostScene::AddScene( const char* sceneFile, const char* dir, const mat4& tra
 	// add the root nodes to the scene transform node
 	for (size_t i = 0; i < glftScene.nodes.size(); i++) nodePool[nodeBase - 1]->childIdx.push_back( glftScene.nodes[i] + nodeBase );
 	// add the root transform to the scene
-	rootNodes.push_back( nodeBase - 1 );
+	AddRootNode( nodeBase - 1 );
+	// the scene is complete once all its textures are
+	texturesDecoded.wait();
+	for (HostTexture* texture : newTextures) texture->decoding = shared_future<void>();
+	// register the file, so that adding it again reuses the data
+	if (assetKey.size() > 0)
+	{
+		SceneAsset* asset = new SceneAsset();
+		asset->meshBase = meshBase, asset->meshCount = (int)gltfModel.meshes.size();
+		asset->skinBase = skinBase, asset->skinCount = (int)gltfModel.skins.size();
+		asset->animBase = animBase, asset->animCount = (int)gltfModel.animations.size();
+		asset->nodeBase = nodeBase;
+		asset->nodes = gltfModel.nodes;
+		asset->rootNodes = glftScene.nodes;
+		sceneAssets[assetKey] = asset;
+	}
 	// return index of first created node
 	return retVal;
 }
 
+//  +-----------------------------------------------------------------------------+
+//  |  HostScene::InstantiateSceneAsset                                           |
+//  |  Place a glTF file that was loaded before. The node hierarchy is created    |
+//  |  anew; static meshes are shared with the earlier placements, so memory and  |
+//  |  load time scale with the number of unique files. Skinned and morphed       |
+//  |  meshes are posed per instance, so these are copied, as are the skins and   |
+//  |  animations, which refer to the nodes of their instance. Returns the index  |
+//  |  of the first created node, like AddScene.                            LH2'21|
+//  +-----------------------------------------------------------------------------+
+int HostScene::InstantiateSceneAsset( const SceneAsset& asset, const mat4& transform )
+{
+	const int retVal = (int)nodePool.size();
+	const int nodeBase = (int)nodePool.size() + 1;
+	const int nodeOffset = nodeBase - asset.nodeBase;
+	const int skinBase = (int)skins.size();
+	// meshes
+	vector<int> meshIdx( asset.meshCount );
+	for (int i = 0; i < asset.meshCount; i++)
+	{
+		HostMesh* mesh = meshPool[asset.meshBase + i];
+		if (mesh->isAnimated)
+		{
+			HostMesh* copy = new HostMesh( *mesh );
+			copy->ID = (int)meshPool.size();
+			// the light triangles of the original belong to its own instances
+			for (HostTri& tri : copy->triangles) tri.ltriIdx = -1;
+			copy->lightBound = false;
+			copy->MarkAsDirty();
+			meshPool.push_back( copy );
+			mesh = copy;
+		}
+		meshIdx[i] = mesh->ID;
+	}
+	// skins and animations
+	for (int i = 0; i < asset.skinCount; i++)
+	{
+		HostSkin* skin = new HostSkin( *skins[asset.skinBase + i] );
+		skin->skeletonRoot += nodeOffset;
+		for (int& joint : skin->joints) joint += nodeOffset;
+		skins.push_back( skin );
+	}
+	for (int i = 0; i < asset.animCount; i++) animations.push_back( new HostAnimation( *animations[asset.animBase + i], nodeOffset ) );
+	// the extra node that holds the transform for the placement
+	HostNode* newNode = new HostNode();
+	newNode->scene = this;
+	newNode->localTransform = transform;
+	newNode->ID = nodeBase - 1;
+	nodePool.push_back( newNode );
+	// the nodes of the file, referencing the meshes of this placement
+	for (const tinygltf::Node& source : asset.nodes)
+	{
+		tinygltf::Node gltfNode = source;
+		if (gltfNode.mesh != -1) gltfNode.mesh = meshIdx[gltfNode.mesh];
+		HostNode* newNode = new HostNode( this, gltfNode, nodeBase, 0, skinBase );
+		newNode->ID = (int)nodePool.size();
+		nodePool.push_back( newNode );
+	}
+	for (int rootNode : asset.rootNodes) nodePool[nodeBase - 1]->childIdx.push_back( rootNode + nodeBase );
+	AddRootNode( nodeBase - 1 );
+	return retVal;
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostScene::AddSceneAsync                                                   |
+//  |  Start loading a scene file on a thread of its own. The file is loaded into |
+//  |  a separate HostScene, so it does not touch this scene until it is merged   |
+//  |  by CommitSceneLoads. Returns an id for SceneLoadResult.              LH2'21|
+//  +-----------------------------------------------------------------------------+
+int HostScene::AddSceneAsync( const char* sceneFile, const mat4& transform )
+{
+	SceneLoad* load = new SceneLoad();
+	load->id = (int)sceneLoadNodes.size();
+	load->file = sceneFile;
+	load->transform = transform;
+	sceneLoadNodes.push_back( -1 );
+	// a glTF file that is loaded or being loaded already is placed again by AddScene at commit
+	if (!strstr( sceneFile, ".pbrt" )) load->assetKey = SceneAssetKey( sceneFile );
+	bool known = load->assetKey.size() > 0 && sceneAssets.find( load->assetKey ) != sceneAssets.end();
+	for (SceneLoad* pending : sceneLoads) if (load->assetKey.size() > 0 && pending->assetKey == load->assetKey) known = true;
+	if (!known)
+	{
+		// the PBRT loader configures the camera of the scene it loads into
+		HostScene* staging = load->staging = new HostScene();
+		staging->Init();
+		load->node = async( launch::async, [staging, transform]( const string file ) { return staging->AddScene( file.c_str(), transform ); }, load->file );
+	}
+	sceneLoads.push_back( load );
+	return load->id;
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostScene::CommitSceneLoads                                                |
+//  |  Merge the scenes loaded by AddSceneAsync into this scene. Loads are        |
+//  |  committed in the order in which they were requested, so object IDs do not  |
+//  |  depend on the order in which the threads finish. Unless 'wait' is set,     |
+//  |  this stops at the first load that is not done. Called by the RenderSystem  |
+//  |  before synchronizing with the core, i.e., between frames. Returns the      |
+//  |  number of committed loads.                                           LH2'21|
+//  +-----------------------------------------------------------------------------+
+int HostScene::CommitSceneLoads( const bool wait )
+{
+	int committed = 0;
+	while (sceneLoads.size() > 0)
+	{
+		SceneLoad* load = sceneLoads.front();
+		if (load->staging)
+		{
+			if (!wait && load->node.wait_for( chrono::seconds( 0 ) ) != future_status::ready) break;
+			sceneLoadNodes[load->id] = MergeScene( load->staging, load->node.get() );
+			delete load->staging;
+		}
+		else sceneLoadNodes[load->id] = AddScene( load->file.c_str(), load->transform );
+		sceneLoads.erase( sceneLoads.begin() );
+		delete load;
+		committed++;
+	}
+	return committed;
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostScene::SceneLoadResult                                                 |
+//  |  The node that AddScene returned for an AddSceneAsync request, or -1 if the |
+//  |  load was not committed yet.                                          LH2'21|
+//  +-----------------------------------------------------------------------------+
+int HostScene::SceneLoadResult( const int loadId )
+{
+	return (loadId < 0 || loadId >= (int)sceneLoadNodes.size()) ? -1 : sceneLoadNodes[loadId];
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  OffsetTextureIDs                                                           |
+//  |  Helper for MergeScene: renumber the texture references of a material.      |
+//  |                                                                       LH2'21|
+//  +-----------------------------------------------------------------------------+
+static void OffsetTextureIDs( HostMaterial* material, const int offset )
+{
+	HostMaterial& m = *material;
+	int* ids[] = {
+		&m.color.textureID, &m.detailColor.textureID, &m.normals.textureID, &m.detailNormals.textureID,
+		&m.absorption.textureID, &m.metallic.textureID, &m.subsurface.textureID, &m.specular.textureID,
+		&m.roughness.textureID, &m.specularTint.textureID, &m.anisotropic.textureID, &m.sheen.textureID,
+		&m.sheenTint.textureID, &m.clearcoat.textureID, &m.clearcoatGloss.textureID, &m.transmission.textureID,
+		&m.eta.textureID, &m.reflection.textureID, &m.refraction.textureID, &m.ior.textureID,
+		&m.urough.textureID, &m.vrough.textureID, &m.Ks.textureID, &m.eta_rgb.textureID, &m.sigma.textureID,
+		&m.specTrans.textureID, &m.diffTrans.textureID, &m.scatterDistance.textureID, &m.flatness.textureID,
+		&m.Kr.textureID, &m.opacity.textureID
+	};
+	for (int* id : ids) if (*id > -1) *id += offset;
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostScene::MergeScene                                                      |
+//  |  Move the contents of a scene that was loaded by AddSceneAsync into this    |
+//  |  scene. All objects are appended, so the IDs in the staging scene shift by  |
+//  |  the size of the pools of this scene; references are renumbered to match.   |
+//  |  The camera settings of a pbrt file are applied, unless this scene got      |
+//  |  these from another pbrt file already. The staging scene is left empty.     |
+//  |  Returns the node 'stagingNode' became.                               LH2'21|
+//  +-----------------------------------------------------------------------------+
+int HostScene::MergeScene( HostScene* staging, const int stagingNode )
+{
+	const int textureOffset = (int)textures.size(), materialOffset = (int)materials.size();
+	const int meshOffset = (int)meshPool.size(), nodeOffset = (int)nodePool.size();
+	const int skinOffset = (int)skins.size(), animOffset = (int)animations.size();
+	const int triLightOffset = (int)triLights.size();
+	// camera
+	if (staging->pbrtCamera && !pbrtCamera)
+	{
+		camera->FOV = staging->camera->FOV, camera->focalDistance = staging->camera->focalDistance;
+		camera->aperture = staging->camera->aperture, camera->distortion = staging->camera->distortion;
+		pbrtCamera = true;
+	}
+	// textures and materials
+	for (HostTexture* texture : staging->textures) texture->ID += textureOffset, textures.push_back( texture );
+	for (HostMaterial* material : staging->materials)
+	{
+		OffsetTextureIDs( material, textureOffset );
+		material->ID += materialOffset;
+		materials.push_back( material );
+	}
+	for (const auto& copy : staging->materialCopies) materialCopies[copy.first + ((uint64_t)materialOffset << 32)] = copy.second + materialOffset;
+	// meshes
+	for (HostMesh* mesh : staging->meshPool)
+	{
+		mesh->ID += meshOffset;
+		mesh->scene = this;
+		for (HostTri& tri : mesh->triangles)
+		{
+			tri.material += materialOffset;
+			if (tri.ltriIdx > -1) tri.ltriIdx += triLightOffset;
+		}
+		for (int& material : mesh->triangleMaterial) material += materialOffset;
+		for (int& material : mesh->materialList) material += materialOffset;
+		for (int& material : mesh->emissiveMaterials) material += materialOffset;
+		meshPool.push_back( mesh );
+	}
+	// skins, nodes and animations
+	for (HostSkin* skin : staging->skins)
+	{
+		skin->skeletonRoot += nodeOffset;
+		for (int& joint : skin->joints) joint += nodeOffset;
+		skins.push_back( skin );
+	}
+	for (HostNode* node : staging->nodePool)
+	{
+		if (node)
+		{
+			node->ID += nodeOffset;
+			node->scene = this;
+			node->materialVersion = materialVersion;
+			if (node->firstLight > -1) node->firstLight += triLightOffset;
+			if (node->meshID > -1) node->meshID += meshOffset;
+			if (node->skinID > -1) node->skinID += skinOffset;
+			for (int& child : node->childIdx) child += nodeOffset;
+		}
+		nodePool.push_back( node );
+	}
+	for (HostAnimation* anim : staging->animations)
+	{
+		HostAnimation* moved = new HostAnimation( *anim, nodeOffset );
+		moved->scene = this;
+		animations.push_back( moved );
+		delete anim;
+	}
+	// lights
+	for (HostTriLight* light : staging->triLights) light->instIdx += nodeOffset, triLights.push_back( light );
+	for (HostPointLight* light : staging->pointLights) light->ID = (int)pointLights.size(), pointLights.push_back( light );
+	for (HostSpotLight* light : staging->spotLights) light->ID = (int)spotLights.size(), spotLights.push_back( light );
+	for (HostDirectionalLight* light : staging->directionalLights) light->ID = (int)directionalLights.size(), directionalLights.push_back( light );
+	if (!sky) swap( sky, staging->sky );
+	// bookkeeping: root nodes, source files and glTF assets
+	for (int node : staging->rootNodes) AddRootNode( node + nodeOffset );
+	sourceFiles.insert( sourceFiles.end(), staging->sourceFiles.begin(), staging->sourceFiles.end() );
+	for (auto& entry : staging->sceneAssets)
+	{
+		SceneAsset* asset = entry.second;
+		asset->meshBase += meshOffset, asset->skinBase += skinOffset;
+		asset->animBase += animOffset, asset->nodeBase += nodeOffset;
+		if (sceneAssets.find( entry.first ) == sceneAssets.end()) sceneAssets[entry.first] = asset; else delete asset;
+	}
+	// leave the staging scene empty, so that deleting it does not delete the moved objects
+	staging->textures.clear();
+	staging->materials.clear();
+	staging->meshPool.clear();
+	staging->skins.clear();
+	staging->nodePool.clear();
+	staging->animations.clear();
+	staging->triLights.clear();
+	staging->pointLights.clear();
+	staging->spotLights.clear();
+	staging->directionalLights.clear();
+	staging->sceneAssets.clear();
+	return stagingNode + nodeOffset;
+}
+
 //  +-----------------------------------------------------------------------------+
 //  |  HostScene::AddQuad                                                         |
 //  |  Create a mesh that consists of two triangles, described by a normal, a     |
@@ -401,6 +792,7 @@ int HostScene::AddScene( const char* sceneFile, const char* dir, const mat4& tra
 int HostScene::AddQuad( float3 N, const float3 pos, const float width, const float height, const int matId, const int meshID )
 {
 	HostMesh* newMesh = meshID > -1 ? meshPool[meshID] : new HostMesh();
+	newMesh->RestoreHostData(); // the quad is added to the full triangle data
 	N = normalize( N ); // let's not assume the normal is normalized.
 #if 1
 	const float3 tmp = fabs( N.x ) > 0.9f ? make_float3( 0, 1, 0 ) : make_float3( 1, 0, 0 );
@@ -442,6 +834,7 @@ int HostScene::AddQuad( float3 N, const float3 pos, const float width, const flo
 	// if the mesh was newly created, add it to scene mesh list
 	if (meshID == -1)
 	{
+		newMesh->scene = this;
 		newMesh->ID = (int)meshPool.size();
 		newMesh->materialList.push_back( matId );
 		meshPool.push_back( newMesh );
@@ -449,32 +842,55 @@ int HostScene::AddQuad( float3 N, const float3 pos, const float width, const flo
 	return newMesh->ID;
 }
 
+//  +-----------------------------------------------------------------------------+
+//  |  HostScene::SyncNodeSlots                                                   |
+//  |  Nodes may be appended to nodePool directly (e.g. by AddScene); extend the  |
+//  |  per-slot generation and root position arrays to match.               LH2'21|
+//  +-----------------------------------------------------------------------------+
+void HostScene::SyncNodeSlots()
+{
+	if (nodeGeneration.size() < nodePool.size()) nodeGeneration.resize( nodePool.size(), 0 );
+	if (rootNodeIdx.size() < nodePool.size()) rootNodeIdx.resize( nodePool.size(), -1 );
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostScene::AddRootNode                                                     |
+//  |  Add a node to the rootNodes vector, remembering its position so that it    |
+//  |  can be removed in constant time.                                     LH2'21|
+//  +-----------------------------------------------------------------------------+
+void HostScene::AddRootNode( const int nodeId )
+{
+	SyncNodeSlots();
+	rootNodeIdx[nodeId] = (int)rootNodes.size();
+	rootNodes.push_back( nodeId );
+}
+
 //  +-----------------------------------------------------------------------------+
 //  |  HostScene::AddInstance                                                     |
-//  |  Add an instance of an existing mesh to the scene.                    LH2'19|
+//  |  Add an instance of an existing mesh to the scene. Slots of removed nodes   |
+//  |  are reused first; these are kept on a free list.                     LH2'21|
 //  +-----------------------------------------------------------------------------+
 int HostScene::AddInstance( HostNode* newNode )
 {
-	if (nodeListHoles > 0)
+	SyncNodeSlots();
+	newNode->scene = this;
+	if (freeNodeSlots.size() > 0)
 	{
-		// we have holes in the nodes vector due to instance deletions; search from the
-		// end of the list to speed up frequent additions / deletions in complex scenes.
-		for (int i = (int)nodePool.size() - 1; i >= 0; i--) if (nodePool[i] == 0)
-		{
-			// overwrite an empty slot, created by deleting an instance
-			nodePool[i] = newNode;
-			newNode->ID = i;
-			rootNodes.push_back( i );
-			nodeListHoles--; // plugged one hole.
-			return i;
-		}
+		// overwrite an empty slot, created by deleting an instance
+		newNode->ID = freeNodeSlots.back();
+		freeNodeSlots.pop_back();
+		nodePool[newNode->ID] = newNode;
+		nodeNames.Invalidate(); // the index only picks up nodes appended to the pool
 	}
-	// no empty slots available or found; make sure we don't look for them again.
-	nodeListHoles = 0;
-	// insert the new node at the end of the list
-	newNode->ID = (int)nodePool.size();
-	nodePool.push_back( newNode );
-	rootNodes.push_back( newNode->ID );
+	else
+	{
+		// insert the new node at the end of the list
+		newNode->ID = (int)nodePool.size();
+		nodePool.push_back( newNode );
+		nodeGeneration.push_back( 0 );
+		rootNodeIdx.push_back( -1 );
+	}
+	AddRootNode( newNode->ID );
 	return newNode->ID;
 }
 
@@ -484,33 +900,125 @@ int HostScene::AddInstance( HostNode* newNode )
 //  +-----------------------------------------------------------------------------+
 int HostScene::AddInstance( const int meshId, const mat4& transform )
 {
-	HostNode* newNode = new HostNode( meshId, transform );
+	HostNode* newNode = new HostNode( this, meshId, transform );
 	return AddInstance( newNode );
 }
 
+//  +-----------------------------------------------------------------------------+
+//  |  HostScene::ReserveNodes                                                    |
+//  |  Make room for 'count' more nodes before adding many instances at once, so  |
+//  |  the node arrays grow once. Capacity at least doubles, so repeated calls    |
+//  |  do not turn into a reallocation per call.                            LH2'21|
+//  +-----------------------------------------------------------------------------+
+void HostScene::ReserveNodes( const size_t count )
+{
+	SyncNodeSlots();
+	const size_t reused = min( count, freeNodeSlots.size() );
+	const size_t needed = nodePool.size() + count - reused;
+	if (needed > nodePool.capacity())
+	{
+		const size_t capacity = max( needed, nodePool.capacity() * 2 );
+		nodePool.reserve( capacity );
+		nodeGeneration.reserve( capacity );
+		rootNodeIdx.reserve( capacity );
+	}
+	if (rootNodes.size() + count > rootNodes.capacity()) rootNodes.reserve( max( rootNodes.size() + count, rootNodes.capacity() * 2 ) );
+}
+
 //  +-----------------------------------------------------------------------------+
 //  |  HostScene::RemoveNode                                                      |
 //  |  Remove a node from the scene.                                              |
 //  |  This also removes the node from the rootNodes vector. Note that will only  |
 //  |  work correctly if the node is not part of a hierarchy. This assumption is  |
 //  |  valid for nodes that have been created using AddInstance.                  |
+//  |  The last root node takes the place of the removed one, so for scenes of    |
+//  |  single-node instances only that instance moves to a new core index.        |
 //  |  See the notes at the top of host_scene.h for the relation between host     |
 //  |  nodes and core instances.                                            LH2'19|
 //  +-----------------------------------------------------------------------------+
 void HostScene::RemoveNode( const int nodeId )
 {
+	if (nodeId < 0 || nodeId >= nodePool.size() || !nodePool[nodeId]) return;
+	SyncNodeSlots();
 	// remove the instance from the scene graph
-	for (int s = (int)rootNodes.size(), i = 0; i < s; i++) if (rootNodes[i] == nodeId)
+	const int rootIdx = rootNodeIdx[nodeId];
+	if (rootIdx > -1)
 	{
-		rootNodes[i] = rootNodes[s - 1];
+		const int last = rootNodes.back();
+		rootNodes[rootIdx] = last;
+		rootNodeIdx[last] = rootIdx;
 		rootNodes.pop_back();
-		break;
+		rootNodeIdx[nodeId] = -1;
 	}
 	// delete the instance
 	HostNode* node = nodePool[nodeId];
 	nodePool[nodeId] = 0; // safe; we only access the nodes vector indirectly.
 	delete node;
-	nodeListHoles++; // HostScene::AddInstance will fill up holes first.
+	// invalidate handles to this slot and make it available to AddInstance
+	nodeGeneration[nodeId]++;
+	freeNodeSlots.push_back( nodeId );
+}
+bool HostScene::RemoveNode( const NodeHandle& handle )
+{
+	if (!GetNode( handle )) return false;
+	RemoveNode( handle.index );
+	return true;
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostScene::GetNodeHandle / GetNode                                         |
+//  |  Generational handles: a handle stores the slot of a node and the number of |
+//  |  times that slot was freed, so a handle to a removed node stays invalid     |
+//  |  when AddInstance reuses the slot.                                    LH2'21|
+//  +-----------------------------------------------------------------------------+
+NodeHandle HostScene::GetNodeHandle( const int nodeId )
+{
+	NodeHandle handle;
+	if (nodeId < 0 || nodeId >= nodePool.size() || !nodePool[nodeId]) return handle;
+	SyncNodeSlots();
+	handle.index = nodeId;
+	handle.generation = nodeGeneration[nodeId];
+	return handle;
+}
+HostNode* HostScene::GetNode( const NodeHandle& handle )
+{
+	if (handle.index < 0 || handle.index >= nodePool.size()) return 0;
+	SyncNodeSlots();
+	return nodeGeneration[handle.index] == handle.generation ? nodePool[handle.index] : 0;
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostScene::Lookup                                                          |
+//  |  Hashed lookup of a key in one of the object pools. Objects are added to    |
+//  |  the index lazily, on the first lookup after they were added to the pool,   |
+//  |  so code that sets the name of an object right after adding it works as     |
+//  |  before. A hit is verified against the pool; a stale hit (object renamed or |
+//  |  deleted) rebuilds the index. Objects can also be renamed to the key after  |
+//  |  they were indexed; with 'scanOnMiss', a miss is therefore confirmed with a |
+//  |  linear scan. This is used for the names that applications look up and may  |
+//  |  change; the loaders, which look up origins and names they set themselves,  |
+//  |  skip it, as they miss once for every object they create. For duplicate     |
+//  |  keys the lowest index wins, as with the linear scans this replaces.  LH2'21|
+//  +-----------------------------------------------------------------------------+
+template <class T, class F> int HostScene::Lookup( LookupIndex& index, const vector<T*>& pool, const string& key, F keyOf, const bool scanOnMiss )
+{
+	for (int attempt = 0; attempt < 2; attempt++)
+	{
+		// index objects that were added since the previous lookup
+		for (size_t s = pool.size(); index.indexed < s; index.indexed++)
+			if (pool[index.indexed]) index.ids.emplace( keyOf( pool[index.indexed] ), (int)index.indexed );
+		auto it = index.ids.find( key );
+		if (it == index.ids.end()) break;
+		if (it->second < pool.size() && pool[it->second] && keyOf( pool[it->second] ) == key) return it->second;
+		index.Invalidate();
+	}
+	if (!scanOnMiss) return -1;
+	for (int s = (int)pool.size(), i = 0; i < s; i++) if (pool[i] && keyOf( pool[i] ) == key)
+	{
+		index.ids[key] = i; // renamed after it was indexed
+		return i;
+	}
+	return -1;
 }
 
 //  +-----------------------------------------------------------------------------+
@@ -519,26 +1027,35 @@ void HostScene::RemoveNode( const int nodeId )
 //  +-----------------------------------------------------------------------------+
 int HostScene::FindTextureID( const char* name )
 {
-	for (auto texture : textures) if (strcmp( texture->name.c_str(), name ) == 0) return texture->ID;
-	return -1;
+	const int idx = Lookup( textureNames, textures, name, []( HostTexture* t ) { return t->name; }, false );
+	return idx == -1 ? -1 : textures[idx]->ID;
 }
 
 //  +-----------------------------------------------------------------------------+
 //  |  HostScene::FindOrCreateTexture                                             |
 //  |  Return a texture: if it already exists, return the existing texture (after |
 //  |  increasing its refCount), otherwise, create a new texture and return its   |
-//  |  ID.                                                                  LH2'19|
+//  |  ID. If 'deferred' is specified, a new texture is registered without        |
+//  |  texels and added to that list; the caller loads it.                  LH2'19|
 //  +-----------------------------------------------------------------------------+
-int HostScene::FindOrCreateTexture( const string& origin, const uint modFlags )
+int HostScene::FindOrCreateTexture( const string& origin, const uint modFlags, vector<HostTexture*>* deferred )
 {
 	// search list for existing texture
-	for (auto texture : textures) if (texture->Equals( origin, modFlags ))
+	const auto key = []( const string& o, const uint m ) { return o + "|" + to_string( m ); };
+	const int idx = Lookup( textureOrigins, textures, key( origin, modFlags ), [&key]( HostTexture* t ) { return key( t->origin, t->mods ); }, false );
+	if (idx > -1)
 	{
-		texture->refCount++;
-		return texture->ID;
+		textures[idx]->refCount++;
+		return textures[idx]->ID;
 	}
 	// nothing found, create a new texture
-	return CreateTexture( origin, modFlags );
+	if (!deferred) return CreateTexture( origin, modFlags );
+	HostTexture* newTexture = new HostTexture();
+	newTexture->origin = origin;
+	newTexture->mods = modFlags;
+	textures.push_back( newTexture );
+	deferred->push_back( newTexture );
+	return newTexture->ID = (int)textures.size() - 1;
 }
 
 //  +-----------------------------------------------------------------------------+
@@ -549,13 +1066,14 @@ int HostScene::FindOrCreateTexture( const string& origin, const uint modFlags )
 //  +-----------------------------------------------------------------------------+
 int HostScene::FindOrCreateMaterial( const string& name )
 {
-	// search list for existing texture
-	for (auto material : materials) if (material->name.compare( name ) == 0)
+	// search list for existing material
+	const int idx = Lookup( materialNames, materials, name, []( HostMaterial* m ) { return m->name; }, false );
+	if (idx > -1)
 	{
-		material->refCount++;
-		return material->ID;
+		materials[idx]->refCount++;
+		return materials[idx]->ID;
 	}
-	// nothing found, create a new texture
+	// nothing found, create a new material
 	const int newID = AddMaterial( make_float3( 0 ) );
 	materials[newID]->name = name;
 	return newID;
@@ -572,14 +1090,18 @@ int HostScene::FindOrCreateMaterialCopy( const int matID, const uint color )
 	// search list for existing material copy
 	const int r = (color >> 16) & 255, g = (color >> 8) & 255, b = color & 255;
 	const float3 c = make_float3( b * (1.0f / 255.0f), g * (1.0f / 255.0f), r * (1.0f / 255.0f) );
-	for (auto material : materials)
+	const uint64_t key = ((uint64_t)matID << 32) + color;
+	auto copy = materialCopies.find( key );
+	if (copy != materialCopies.end())
 	{
-		if (material->flags & HostMaterial::SINGLE_COLOR_COPY &&
+		HostMaterial* material = copy->second < materials.size() ? materials[copy->second] : 0;
+		if (material && material->flags & HostMaterial::SINGLE_COLOR_COPY &&
 			material->color.value.x == c.x && material->color.value.y == c.y && material->color.value.z == c.z)
 		{
 			material->refCount++;
 			return material->ID;
 		}
+		materialCopies.erase( copy ); // stale entry
 	}
 	// nothing found, create a new material copy
 	const int newID = AddMaterial( make_float3( 0 ) );
@@ -591,6 +1113,7 @@ int HostScene::FindOrCreateMaterialCopy( const int matID, const uint color )
 	char t[256];
 	sprintf( t, "copied_mat_%i", newID );
 	materials[newID]->name = t;
+	materialCopies[key] = newID;
 	return newID;
 }
 
@@ -600,8 +1123,8 @@ int HostScene::FindOrCreateMaterialCopy( const int matID, const uint color )
 //  +-----------------------------------------------------------------------------+
 int HostScene::FindMaterialID( const char* name )
 {
-	for (auto material : materials) if (material->name.compare( name ) == 0) return material->ID;
-	return -1;
+	const int idx = Lookup( materialNames, materials, name, []( HostMaterial* m ) { return m->name; }, true );
+	return idx == -1 ? -1 : materials[idx]->ID;
 }
 
 //  +-----------------------------------------------------------------------------+
@@ -610,8 +1133,8 @@ int HostScene::FindMaterialID( const char* name )
 //  +-----------------------------------------------------------------------------+
 int HostScene::FindMaterialIDByOrigin( const char* name )
 {
-	for (auto material : materials) if (material->origin.compare( name ) == 0) return material->ID;
-	return -1;
+	const int idx = Lookup( materialOrigins, materials, name, []( HostMaterial* m ) { return m->origin; }, false );
+	return idx == -1 ? -1 : materials[idx]->ID;
 }
 
 //  +-----------------------------------------------------------------------------+
@@ -632,8 +1155,8 @@ int HostScene::FindNextMaterialID( const char* name, const int matID )
 //  +-----------------------------------------------------------------------------+
 int HostScene::FindNode( const char* name )
 {
-	for (auto node : nodePool) if (node->name.compare( name ) == 0) return node->ID;
-	return -1;
+	const int idx = Lookup( nodeNames, nodePool, name, []( HostNode* n ) { return n->name; }, true );
+	return idx == -1 ? -1 : nodePool[idx]->ID;
 }
 
 //  +-----------------------------------------------------------------------------+
@@ -20,7 +20,8 @@
    2. vector<HostNode*> nodes
 	  This is a collection of all the nodes in the scene. The nodes may be
 	  visible or not, and the collection may include nullptrs, in case nodes
-	  have been deleted. In that case, 'nodeListHoles' is greater than 0.
+	  have been deleted. These slots are on the 'freeNodeSlots' list, and
+	  AddInstance reuses them. A NodeHandle detects access to a reused slot.
    3. vector<HostMesh*> meshes
 	  The collection of meshes, i.e. the actual geometry. Each mesh may be
 	  referenced by 0 or more nodes.
@@ -47,10 +48,27 @@
 namespace lighthouse2
 {
 
+//  +-----------------------------------------------------------------------------+
+//  |  NodeHandle                                                                 |
+//  |  Node slot plus the generation of that slot. Node IDs are reused after      |
+//  |  RemoveNode; a handle to a removed node is recognized by its generation.    |
+//  |  Obtain one using HostScene::GetNodeHandle.                           LH2'21|
+//  +-----------------------------------------------------------------------------+
+struct NodeHandle
+{
+	int index = -1;						// slot in HostScene::nodePool
+	uint generation = 0;				// number of times the slot was freed when the handle was made
+};
+
 //  +-----------------------------------------------------------------------------+
 //  |  HostScene                                                                  |
 //  |  Module for scene I/O and host-side management.                             |
-//  |  This is a pure static class; we will not have more than one scene.   LH2'19|
+//  |  Each RenderSystem owns a scene; independent scenes may be loaded, updated  |
+//  |  and synchronized from different threads. Objects that need their scene     |
+//  |  (meshes, nodes, animations) keep a pointer to it.                          |
+//  |  AddSceneAsync loads files on other threads, each into a scene of its own;  |
+//  |  CommitSceneLoads merges these into this scene, in the order requested.     |
+//  |                                                                       LH2'21|
 //  +-----------------------------------------------------------------------------+
 class HostNode;
 class HostScene
@@ -60,58 +78,95 @@ public:
 	HostScene();
 	~HostScene();
 	// serialization / deserialization
-	static void SerializeMaterials( const char* xmlFile );
-	static void DeserializeMaterials( const char* xmlFile );
+	void SerializeMaterials( const char* xmlFile );
+	void DeserializeMaterials( const char* xmlFile );
+	bool LoadCache( const char* cacheFile );
+	void SaveCache( const char* cacheFile );
+	void AddSourceFile( const string& fileName );
 	// methods
-	static void Init();
-	static void SetSkyDome( HostSkyDome* );
-	static int FindOrCreateTexture( const string& origin, const uint modFlags = 0 );
-	static int FindTextureID( const char* name );
-	static int CreateTexture( const string& origin, const uint modFlags = 0 );
-	static int FindOrCreateMaterial( const string& name );
-	static int FindOrCreateMaterialCopy( const int matID, const uint color );
-	static int FindMaterialID( const char* name );
-	static int FindMaterialIDByOrigin( const char* name );
-	static int FindNextMaterialID( const char* name, const int matID );
-	static int FindNode( const char* name );
-	static void SetNodeTransform( const int nodeId, const mat4& transform );
-	static const mat4& GetNodeTransform( const int nodeId );
-	static void ResetAnimation( const int animId );
-	static void UpdateAnimation( const int animId, const float dt );
-	static int AnimationCount() { return (int)animations.size(); }
+	void Init();
+	void SetSkyDome( HostSkyDome* );
+	int FindOrCreateTexture( const string& origin, const uint modFlags = 0, vector<HostTexture*>* deferred = nullptr );
+	int FindTextureID( const char* name );
+	int CreateTexture( const string& origin, const uint modFlags = 0 );
+	int FindOrCreateMaterial( const string& name );
+	int FindOrCreateMaterialCopy( const int matID, const uint color );
+	int FindMaterialID( const char* name );
+	int FindMaterialIDByOrigin( const char* name );
+	int FindNextMaterialID( const char* name, const int matID );
+	int FindNode( const char* name );
+	void SetNodeTransform( const int nodeId, const mat4& transform );
+	const mat4& GetNodeTransform( const int nodeId );
+	void ResetAnimation( const int animId );
+	void UpdateAnimation( const int animId, const float dt );
+	int AnimationCount() { return (int)animations.size(); }
 	// scene construction / maintenance
-	static int AddMesh( HostMesh* mesh );
-	static int AddMesh( const char* objFile, const char* dir, const float scale = 1.0f, const bool flatShaded = false );
-	static int AddMesh( const char* objFile, const float scale = 1.0f, const bool flatShaded = false );
-	static int AddScene( const char* sceneFile, const mat4& transform = mat4::Identity() );
-	static int AddScene( const char* sceneFile, const char* dir, const mat4& transform );
-	static int AddMesh( const int triCount );
-	static void AddTriToMesh( const int meshId, const float3& v0, const float3& v1, const float3& v2, const int matId );
-	static int AddQuad( const float3 N, const float3 pos, const float width, const float height, const int matId, const int meshID = -1 );
-	static int AddInstance( HostNode* node );
-	static int AddInstance( const int meshId, const mat4& transform );
-	static void RemoveNode( const int instId );
-	static int AddMaterial( HostMaterial* material );
-	static int AddMaterial( const float3 color, const char* name = 0 );
-	static int AddPointLight( const float3 pos, const float3 radiance, bool enabled = true );
-	static int AddSpotLight( const float3 pos, const float3 direction, const float inner, const float outer, const float3 radiance, bool enabled = true );
-	static int AddDirectionalLight( const float3 direction, const float3 radiance, bool enabled = true );
+	int AddMesh( HostMesh* mesh );
+	int AddMesh( const char* objFile, const char* dir, const float scale = 1.0f, const bool flatShaded = false );
+	int AddMesh( const char* objFile, const float scale = 1.0f, const bool flatShaded = false );
+	int AddScene( const char* sceneFile, const mat4& transform = mat4::Identity() );
+	int AddScene( const char* sceneFile, const char* dir, const mat4& transform );
+	int AddSceneAsync( const char* sceneFile, const mat4& transform = mat4::Identity() );
+	int CommitSceneLoads( const bool wait = false );
+	int SceneLoadResult( const int loadId );
+	int AddMesh( const int triCount );
+	void AddTriToMesh( const int meshId, const float3& v0, const float3& v1, const float3& v2, const int matId );
+	int AddQuad( const float3 N, const float3 pos, const float width, const float height, const int matId, const int meshID = -1 );
+	int AddInstance( HostNode* node );
+	int AddInstance( const int meshId, const mat4& transform );
+	void ReserveNodes( const size_t count );
+	void RemoveNode( const int instId );
+	bool RemoveNode( const NodeHandle& handle );
+	NodeHandle GetNodeHandle( const int nodeId );
+	HostNode* GetNode( const NodeHandle& handle );
+	int AddMaterial( HostMaterial* material );
+	int AddMaterial( const float3 color, const char* name = 0 );
+	int AddPointLight( const float3 pos, const float3 radiance, bool enabled = true );
+	int AddSpotLight( const float3 pos, const float3 direction, const float inner, const float outer, const float3 radiance, bool enabled = true );
+	int AddDirectionalLight( const float3 direction, const float3 radiance, bool enabled = true );
 	// data members
-	static inline vector<int> rootNodes;
-	static inline vector<HostNode*> nodePool;
-	static inline vector<HostMesh*> meshPool;
-	static inline vector<HostSkin*> skins;
-	static inline vector<HostAnimation*> animations;
-	static inline vector<HostMaterial*> materials;
-	static inline vector<HostTexture*> textures;
-	static inline vector<HostTriLight*> triLights;
-	static inline vector<HostPointLight*> pointLights;
-	static inline vector<HostSpotLight*> spotLights;
-	static inline vector<HostDirectionalLight*> directionalLights;
-	static inline HostSkyDome* sky;
-	static inline Camera* camera;
+	vector<int> rootNodes;
+	vector<HostNode*> nodePool;
+	vector<HostMesh*> meshPool;
+	vector<HostSkin*> skins;
+	vector<HostAnimation*> animations;
+	vector<HostMaterial*> materials;
+	vector<HostTexture*> textures;
+	vector<HostTriLight*> triLights;
+	vector<HostPointLight*> pointLights;
+	vector<HostSpotLight*> spotLights;
+	vector<HostDirectionalLight*> directionalLights;
+	HostSkyDome* sky = nullptr;
+	Camera* camera = nullptr;
+	bool pbrtCamera = false;	// the camera settings were read from a pbrt file
+	uint materialVersion = 0;	// incremented when the emission of a material changes; nodes use it to refresh their lights
+	vector<uint> emissionVersion;	// per material: the materialVersion in which its emission last changed
 private:
-	static inline int nodeListHoles;	// zero if no instance deletions occurred; adding instances will be faster.
+	void SyncNodeSlots();
+	void AddRootNode( const int nodeId );
+	vector<int> freeNodeSlots;		// nodePool slots of removed nodes, reused by AddInstance
+	vector<uint> nodeGeneration;	// per nodePool slot: incremented when the node is removed
+	vector<int> rootNodeIdx;		// per nodePool slot: position in rootNodes, or -1
+	vector<string> sourceFiles;		// files read by the loaders; the scene cache depends on these
+	// hashed lookups for the Find* methods; see HostScene::Lookup
+	struct LookupIndex
+	{
+		unordered_map<string, int> ids;	// key to the lowest pool index with that key
+		size_t indexed = 0;				// number of pool entries processed so far
+		void Invalidate() { ids.clear(); indexed = 0; }
+	};
+	template <class T, class F> int Lookup( LookupIndex& index, const vector<T*>& pool, const string& key, F keyOf, const bool scanOnMiss );
+	LookupIndex textureNames, textureOrigins, materialNames, materialOrigins, nodeNames;
+	unordered_map<uint64_t, int> materialCopies;	// (source material, color) to material copy
+	// glTF files loaded by AddScene; adding such a file again instantiates the loaded data
+	struct SceneAsset;
+	int InstantiateSceneAsset( const SceneAsset& asset, const mat4& transform );
+	unordered_map<string, SceneAsset*> sceneAssets;	// by canonical path and modification time
+	// files loaded on other threads by AddSceneAsync, into scenes of their own
+	struct SceneLoad;
+	int MergeScene( HostScene* staging, const int stagingNode );
+	vector<SceneLoad*> sceneLoads;	// loads that have not been committed yet, in request order
+	vector<int> sceneLoadNodes;		// per load: the node returned by AddScene, or -1 until committed
 };
 
 } // namespace lighthouse2
@@ -0,0 +1,84 @@
+/* host_skinning_avx2.cpp - Copyright 2019/2021 Utrecht University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "rendersystem.h"
+
+//  +-----------------------------------------------------------------------------+
+//  |  SkinVerticesAVX2                                                           |
+//  |  Skinning kernel for HostMesh::SetPose. This is the only file built with    |
+//  |  /arch:AVX2; the kernel is only called when DetectISA in host_mesh.cpp      |
+//  |  reports support for it.                                              LH2'21|
+//  +-----------------------------------------------------------------------------+
+#if defined( _MSC_VER ) && !defined( __clang__ )
+#define TARGET_AVX2 // see EnableEnhancedInstructionSet in rendersystem.vcxproj
+#else
+#define TARGET_AVX2 __attribute__( (target( "avx2,fma" )) )
+#endif
+
+// code optimized for INFOMOV by Alysha Bogaers and Naraenda Prasetya
+TARGET_AVX2 void SkinVerticesAVX2( HostMesh* mesh, const HostSkin* skin, const int first, const int last )
+{
+	for (int v = first; v < last; v++)
+	{
+		// calculate weighted skin matrix
+		// skinM = w4.x * skin->jointMat[j4.x]
+		//       + w4.y * skin->jointMat[j4.y]
+		//       + w4.z * skin->jointMat[j4.z]
+		//       + w4.w * skin->jointMat[j4.w];
+		// the 4 joint indices
+		uint4 j4 = mesh->joints[v];
+		// the 4 weights of each joint
+		__m128 w4 = _mm_load_ps( (const float*)&mesh->weights[v] );
+		// create scalars for matrix scaling, use same shuffle value to help with uOP cache
+		__m256 w4x = _mm256_broadcastss_ps( w4 ); // w4.x component shuffled to all elements
+		w4 = _mm_shuffle_ps( w4, w4, 0b111001 );
+		__m256 w4y = _mm256_broadcastss_ps( w4 ); // w4.y component shuffled to all elements
+		w4 = _mm_shuffle_ps( w4, w4, 0b111001 );
+		__m256 w4z = _mm256_broadcastss_ps( w4 ); // w4.z component shuffled to all elements
+		w4 = _mm_shuffle_ps( w4, w4, 0b111001 );
+		__m256 w4w = _mm256_broadcastss_ps( w4 ); // w4.w component shuffled to all elements
+		// top half of weighted skin matrix; mat4 is not 32-byte aligned, so use unaligned loads
+		__m256 skinM_T = _mm256_mul_ps( w4x, _mm256_loadu_ps( skin->jointMat[j4.x].cell ) );
+		skinM_T = _mm256_fmadd_ps( w4y, _mm256_loadu_ps( skin->jointMat[j4.y].cell ), skinM_T );
+		skinM_T = _mm256_fmadd_ps( w4z, _mm256_loadu_ps( skin->jointMat[j4.z].cell ), skinM_T );
+		skinM_T = _mm256_fmadd_ps( w4w, _mm256_loadu_ps( skin->jointMat[j4.w].cell ), skinM_T );
+		// bottom half of weighted skin matrix
+		__m256 skinM_L = _mm256_mul_ps( w4x, _mm256_loadu_ps( &skin->jointMat[j4.x].cell[8] ) );
+		skinM_L = _mm256_fmadd_ps( w4y, _mm256_loadu_ps( &skin->jointMat[j4.y].cell[8] ), skinM_L );
+		skinM_L = _mm256_fmadd_ps( w4z, _mm256_loadu_ps( &skin->jointMat[j4.z].cell[8] ), skinM_L );
+		skinM_L = _mm256_fmadd_ps( w4w, _mm256_loadu_ps( &skin->jointMat[j4.w].cell[8] ), skinM_L );
+		// double each row so we can do two matrix multiplication at once
+		__m256 skinM0 = _mm256_permute2f128_ps( skinM_T, skinM_T, 0x00 );
+		__m256 skinM1 = _mm256_permute2f128_ps( skinM_T, skinM_T, 0x11 );
+		__m256 skinM2 = _mm256_permute2f128_ps( skinM_L, skinM_L, 0x00 );
+		__m256 skinM3 = _mm256_permute2f128_ps( skinM_L, skinM_L, 0x11 );
+		// load vertex and normal; combine vectors to use AVX2 instead of SSE
+		__m256 combined = _mm256_set_m128( _mm_load_ps( &mesh->origNormal[v].x ), _mm_load_ps( &mesh->original[v].x ) );
+		// multiply vertex with skin matrix, multiply normal with skin matrix
+		// using HADD and MUL is faster than OR and DP
+		combined = _mm256_hadd_ps(
+			_mm256_hadd_ps( _mm256_mul_ps( combined, skinM0 ), _mm256_mul_ps( combined, skinM1 ) ),
+			_mm256_hadd_ps( _mm256_mul_ps( combined, skinM2 ), _mm256_mul_ps( combined, skinM3 ) ) );
+		// extract vertex and normal from combined vector
+		__m128 vtx = _mm256_castps256_ps128( combined );
+		__m128 norm = _mm256_extractf128_ps( combined, 1 );
+		// normalize normal; clear w
+		norm = _mm_blend_ps( _mm_mul_ps( norm, _mm_rsqrt_ps( _mm_dp_ps( norm, norm, 0x77 ) ) ), _mm_setzero_ps(), 0b1000 );
+		_mm_store_ps( &mesh->skinnedPos[v].x, vtx );
+		_mm_store_ps( &mesh->skinnedNormal[v].x, norm );
+	}
+}
+
+// EOF
\ No newline at end of file
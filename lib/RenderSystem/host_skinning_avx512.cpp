@@ -0,0 +1,58 @@
+/* host_skinning_avx512.cpp - Copyright 2019/2021 Utrecht University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "rendersystem.h"
+
+//  +-----------------------------------------------------------------------------+
+//  |  SkinVerticesAVX512                                                         |
+//  |  Skinning kernel for HostMesh::SetPose. This is the only file built with    |
+//  |  /arch:AVX512; the kernel is only called when DetectISA in host_mesh.cpp    |
+//  |  reports support for it.                                              LH2'21|
+//  +-----------------------------------------------------------------------------+
+#if defined( _MSC_VER ) && !defined( __clang__ )
+#define TARGET_AVX512 // see EnableEnhancedInstructionSet in rendersystem.vcxproj
+#else
+#define TARGET_AVX512 __attribute__( (target( "avx512f,fma" )) )
+#endif
+
+TARGET_AVX512 void SkinVerticesAVX512( HostMesh* mesh, const HostSkin* skin, const int first, const int last )
+{
+	// lane 0 of each 128-bit group holds a row dot product after the reduction below
+	const __m512i gather = _mm512_setr_epi32( 0, 4, 8, 12, 0, 4, 8, 12, 0, 4, 8, 12, 0, 4, 8, 12 );
+	for (int v = first; v < last; v++)
+	{
+		const uint4 j4 = mesh->joints[v];
+		const float4 w4 = mesh->weights[v];
+		// the full weighted skin matrix fits in a single register
+		__m512 skinM = _mm512_mul_ps( _mm512_set1_ps( w4.x ), _mm512_loadu_ps( skin->jointMat[j4.x].cell ) );
+		skinM = _mm512_fmadd_ps( _mm512_set1_ps( w4.y ), _mm512_loadu_ps( skin->jointMat[j4.y].cell ), skinM );
+		skinM = _mm512_fmadd_ps( _mm512_set1_ps( w4.z ), _mm512_loadu_ps( skin->jointMat[j4.z].cell ), skinM );
+		skinM = _mm512_fmadd_ps( _mm512_set1_ps( w4.w ), _mm512_loadu_ps( skin->jointMat[j4.w].cell ), skinM );
+		// multiply each row with the vector, then sum within each row
+		__m512 pv = _mm512_mul_ps( skinM, _mm512_broadcast_f32x4( _mm_load_ps( &mesh->original[v].x ) ) );
+		__m512 pn = _mm512_mul_ps( skinM, _mm512_broadcast_f32x4( _mm_load_ps( &mesh->origNormal[v].x ) ) );
+		pv = _mm512_add_ps( pv, _mm512_permute_ps( pv, 0b10110001 ) );
+		pn = _mm512_add_ps( pn, _mm512_permute_ps( pn, 0b10110001 ) );
+		pv = _mm512_add_ps( pv, _mm512_permute_ps( pv, 0b01001110 ) );
+		pn = _mm512_add_ps( pn, _mm512_permute_ps( pn, 0b01001110 ) );
+		const __m128 vtx = _mm512_castps512_ps128( _mm512_permutexvar_ps( gather, pv ) );
+		__m128 norm = _mm512_castps512_ps128( _mm512_permutexvar_ps( gather, pn ) );
+		norm = _mm_blend_ps( _mm_mul_ps( norm, _mm_rsqrt_ps( _mm_dp_ps( norm, norm, 0x77 ) ) ), _mm_setzero_ps(), 0b1000 );
+		_mm_store_ps( &mesh->skinnedPos[v].x, vtx );
+		_mm_store_ps( &mesh->skinnedNormal[v].x, norm );
+	}
+}
+
+// EOF
\ No newline at end of file
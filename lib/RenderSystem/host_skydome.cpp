@@ -65,6 +65,7 @@ void HostSkyDome::Load( const char* filename, const float3 scale )
 	timer.reset();
 	FREE64( pixels ); // just in case we're reloading
 	pixels = 0;
+	origin = filename;
 	// Append ".bin" to the filename:
 #ifndef PATH_MAX
 #define PATH_MAX _MAX_PATH
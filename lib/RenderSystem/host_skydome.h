@@ -38,6 +38,7 @@ public:
 	float* pdf = nullptr;				// pdf for importance sampling
 	float* columncdf = nullptr;			// column cdf for importance sampling
 	mat4 worldToLight;					// for PBRT scenes; transform for skydome
+	string origin;						// file from which the sky was loaded
 	TRACKCHANGES;						// add Changed(), MarkAsDirty() methods, see system.h
 };
 
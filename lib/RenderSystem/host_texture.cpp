@@ -14,11 +14,10 @@
 */
 
 #include "rendersystem.h"
-
-// Local hack:
-#ifndef _MSC_VER
-#define strcat_s strcat
-#endif
+#include "stb_image.h"
+#include <filesystem>
+#include <random>
+#include <zlib.h>
 
 //  +-----------------------------------------------------------------------------+
 //  |  HostTexture::HostTexture                                                   |
@@ -161,48 +160,10 @@ void HostTexture::Load( const char* fileName, const uint modFlags, bool normalMa
 
 #ifdef CACHEIMAGES
 	// see if we can fetch a binary blob; faster than most FreeImage formats
-	if (strlen( fileName ) > 4) if (fileName[strlen( fileName ) - 4] == '.')
+	if (LoadFromCache( fileName, modFlags ))
 	{
-		char binFile[1024];
-		memcpy( binFile, fileName, strlen( fileName ) + 1 );
-		binFile[strlen( fileName ) - 4] = 0;
-		strcat_s( binFile, ".bin" );
-		FILE* f;
-	#ifdef _MSC_VER
-		fopen_s( &f, binFile, "rb" );
-	#else
-		f = fopen( binFile, "rb" );
-	#endif
-		if (f)
-		{
-			uint version;
-			fread( &version, 1, 4, f );
-			if (version == BINTEXFILEVERSION)
-			{
-				fread( &width, 4, 1, f );
-				fread( &height, 4, 1, f );
-				int dataType;
-				fread( &dataType, 4, 1, f );
-				fread( &mods, 4, 1, f );
-				fread( &flags, 4, 1, f );
-				fread( &MIPlevels, 4, 1, f );
-				if (dataType == 0)
-				{
-					int pixelCount = PixelsNeeded( width, height, 1 /* no MIPS for HDR textures */ );
-					fdata = (float4*)MALLOC64( sizeof( float4 ) * pixelCount );
-					fread( fdata, sizeof( float4 ), pixelCount, f );
-				}
-				else
-				{
-					int pixelCount = PixelsNeeded( width, height, MIPLEVELCOUNT );
-					idata = (uchar4*)MALLOC64( sizeof( uchar4 ) * pixelCount );
-					fread( idata, 4, pixelCount, f );
-				}
-				fclose( f );
-				mods = modFlags;
-				return;
-			}
-		}
+		if (normalMap) flags |= NORMALMAP;
+		return;
 	}
 #endif
 	// get filetype
@@ -281,36 +242,133 @@ void HostTexture::Load( const char* fileName, const uint modFlags, bool normalMa
 
 #ifdef CACHEIMAGES
 	// prepare binary blob to be faster next time
-	if (strlen( fileName ) > 4) if (fileName[strlen( fileName ) - 4] == '.')
+	SaveToCache( fileName );
+#endif
+	// all done, mark for sync with core
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostTexture::Decode                                                        |
+//  |  Decode the compressed image in 'encoded' to LDR texels and produce the MIP |
+//  |  maps. Used for images that are not a file of their own, e.g. images that   |
+//  |  are embedded in a glTF scene.                                        LH2'21|
+//  +-----------------------------------------------------------------------------+
+void HostTexture::Decode()
+{
+	int w, h, comp;
+	uchar* pixels = stbi_load_from_memory( encoded.data(), (int)encoded.size(), &w, &h, &comp, 4 );
+	FATALERROR_IF( !pixels || w != (int)width || h != (int)height, "could not decode texture %s", name.c_str() );
+	if (!idata) idata = (uchar4*)MALLOC64( PixelsNeeded( width, height, MIPLEVELCOUNT ) * sizeof( uint ) );
+	memcpy( idata, pixels, w * h * sizeof( uint ) );
+	stbi_image_free( pixels );
+	flags |= LDR;
+	ConstructMIPmaps();
+}
+
+// header of a texture cache file; the texels of all MIP levels follow, compressed or raw
+struct TextureCacheHeader
+{
+	uint version;					// BINTEXFILEVERSION
+	uint width, height;
+	uint flags, mods;				// flags without NORMALMAP, which is not a property of the file
+	uint MIPlevels;
+	uint hdr;						// 1: float4 texels, no MIP levels; 0: uchar4 texels, MIPLEVELCOUNT levels
+	uint compressed;				// 1: the texels are a zlib stream
+	uint64_t sourceStamp;			// SourceStamp of the image file
+	uint64_t rawSize, storedSize;	// size of the texels before and after compression
+};
+
+// one cache file per image and set of modifications, next to the image
+static string CacheFileName( const char* fileName, const uint modFlags )
+{
+	return string( fileName ) + "." + to_string( modFlags ) + ".bin";
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostTexture::LoadFromCache                                                 |
+//  |  Fetch the processed texels from the cache file written by SaveToCache.     |
+//  |  The file is mapped; the texels are decompressed from the mapping into      |
+//  |  the texture, or copied if they were stored raw. Returns false if there is  |
+//  |  no valid cache: a different file version, mods, or image file.       LH2'21|
+//  +-----------------------------------------------------------------------------+
+bool HostTexture::LoadFromCache( const char* fileName, const uint modFlags )
+{
+	const uint64_t stamp = SourceStamp( fileName );
+	if (stamp == 0) return false;
+	MappedFile file( CacheFileName( fileName, modFlags ).c_str() );
+	if (!file.IsOpen() || file.size < sizeof( TextureCacheHeader )) return false;
+	TextureCacheHeader header;
+	memcpy( &header, file.data, sizeof( TextureCacheHeader ) );
+	if (header.version != BINTEXFILEVERSION || header.mods != modFlags || header.sourceStamp != stamp) return false;
+	if (header.width == 0 || header.height == 0 || header.storedSize > file.size - sizeof( TextureCacheHeader )) return false;
+	const size_t texelSize = header.hdr ? sizeof( float4 ) : sizeof( uchar4 );
+	const size_t bytes = texelSize * PixelsNeeded( header.width, header.height, header.hdr ? 1 : MIPLEVELCOUNT );
+	if (header.rawSize != bytes) return false;
+	const uchar* stored = file.data + sizeof( TextureCacheHeader );
+	void* texels = MALLOC64( bytes );
+	bool valid;
+	if (header.compressed)
 	{
-		char binFile[1024];
-		memcpy( binFile, fileName, strlen( fileName ) + 1 );
-		binFile[strlen( fileName ) - 4] = 0;
-		strcat_s( binFile, ".bin" );
-		FILE* f;
-	#ifdef _MSC_VER
-		fopen_s( &f, binFile, "rb" );
-	#else
-		f = fopen( binFile, "rb" );
-	#endif
-		if (f)
-		{
-			uint version = BINTEXFILEVERSION;
-			fwrite( &version, 4, 1, f );
-			fwrite( &width, 4, 1, f );
-			fwrite( &height, 4, 1, f );
-			int dataType = fdata ? 0 : 1;
-			fwrite( &dataType, 4, 1, f );
-			fwrite( &mods, 4, 1, f );
-			fwrite( &flags, 4, 1, f );
-			fwrite( &MIPlevels, 4, 1, f );
-			if (dataType == 0) fwrite( fdata, sizeof( float4 ), PixelsNeeded( width, height, 1 ), f );
-			else fwrite( idata, 4, PixelsNeeded( width, height, MIPLEVELCOUNT ), f );
-			fclose( f );
-		}
+		uLongf size = (uLongf)bytes;
+		valid = uncompress( (Bytef*)texels, &size, stored, (uLong)header.storedSize ) == Z_OK && size == bytes;
+	}
+	else if ((valid = header.storedSize == bytes)) memcpy( texels, stored, bytes );
+	if (!valid)
+	{
+		FREE64( texels );
+		return false;
+	}
+	width = header.width, height = header.height, MIPlevels = header.MIPlevels;
+	flags = header.flags, mods = modFlags;
+	if (header.hdr) fdata = (float4*)texels; else idata = (uchar4*)texels;
+	return true;
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostTexture::SaveToCache                                                   |
+//  |  Store the processed texels, including the MIP levels, for LoadFromCache.   |
+//  |  Texels are compressed with zlib at level BINTEXCOMPRESSION, unless that    |
+//  |  does not pay off; these are stored raw. The file is written under a        |
+//  |  temporary name that is unique to the writer and then renamed, so a         |
+//  |  partial file is never read.                                          LH2'21|
+//  +-----------------------------------------------------------------------------+
+void HostTexture::SaveToCache( const char* fileName ) const
+{
+	TextureCacheHeader header = {};
+	header.sourceStamp = SourceStamp( fileName );
+	if (header.sourceStamp == 0 || (!idata && !fdata)) return;
+	header.version = BINTEXFILEVERSION;
+	header.width = width, header.height = height, header.MIPlevels = MIPlevels;
+	header.flags = flags & ~NORMALMAP, header.mods = mods;
+	header.hdr = fdata ? 1 : 0;
+	const uchar* texels = fdata ? (const uchar*)fdata : (const uchar*)idata;
+	header.rawSize = fdata ? sizeof( float4 ) * PixelsNeeded( width, height, 1 ) : sizeof( uchar4 ) * PixelsNeeded( width, height, MIPLEVELCOUNT );
+	header.storedSize = header.rawSize;
+	vector<uchar> packed;
+	if (BINTEXCOMPRESSION > 0 && header.rawSize <= 0xffffffffu)
+	{
+		uLongf size = compressBound( (uLong)header.rawSize );
+		packed.resize( size );
+		if (compress2( packed.data(), &size, texels, (uLong)header.rawSize, BINTEXCOMPRESSION ) == Z_OK && size < header.rawSize - header.rawSize / 8)
+			header.compressed = 1, header.storedSize = size, texels = packed.data();
 	}
+	// a temporary name per writer: textures are loaded on several threads, and by other processes
+	static const uint process = random_device()();
+	static atomic<uint> writers( 0 );
+	const string writer = to_string( process ) + "-" + to_string( hash<thread::id>()(this_thread::get_id()) ) + "-" + to_string( writers++ );
+	const string cacheFile = CacheFileName( fileName, mods ), tmpFile = cacheFile + "." + writer + ".tmp";
+	FILE* f;
+#ifdef _MSC_VER
+	fopen_s( &f, tmpFile.c_str(), "wb" );
+#else
+	f = fopen( tmpFile.c_str(), "wb" );
 #endif
-	// all done, mark for sync with core
+	if (!f) return; // e.g. a read-only data directory; the image is simply decoded again next time
+	const bool written = fwrite( &header, sizeof( TextureCacheHeader ), 1, f ) == 1 && fwrite( texels, 1, (size_t)header.storedSize, f ) == header.storedSize;
+	const bool closed = fclose( f ) == 0;
+	std::error_code error;
+	if (written && closed) std::filesystem::rename( tmpFile, cacheFile, error );
+	if (!written || !closed || error) std::filesystem::remove( tmpFile, error );
 }
 
 //  +-----------------------------------------------------------------------------+
@@ -340,6 +398,46 @@ void HostTexture::BumpToNormalMap( float heightScale )
 	}
 	if (width * height > 0) memcpy( idata, normalMap, width * height * 4 );
 	delete normalMap;
+	bumpScale = heightScale;
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostTexture::ReleaseTexels                                                 |
+//  |  Free the texel data once the core has its own copy. Only textures that     |
+//  |  can be reloaded are released: textures loaded from a file (or its binary   |
+//  |  cache), and textures that kept their compressed image.               LH2'21|
+//  +-----------------------------------------------------------------------------+
+bool HostTexture::ReleaseTexels()
+{
+	if (decoding.valid()) decoding.wait();
+	const bool reloadable = encoded.size() > 0 || (origin.size() > 0 && FileExists( origin.c_str() ));
+	if (texelsReleased || !reloadable) return false;
+	const bool wasDirty = IsDirty();
+	FREE64( idata );
+	FREE64( fdata );
+	idata = nullptr, fdata = nullptr;
+	texelsReleased = true;
+	if (!wasDirty) MarkAsNotDirty(); // not a change the core needs to see
+	return true;
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  HostTexture::RestoreTexels                                                 |
+//  |  Reload texel data that was freed by ReleaseTexels. Flags that were added   |
+//  |  after loading (e.g. NORMALMAP) are kept, and a bump map is converted to a  |
+//  |  normal map again.                                                    LH2'21|
+//  +-----------------------------------------------------------------------------+
+void HostTexture::RestoreTexels()
+{
+	if (decoding.valid()) decoding.wait();
+	if (!texelsReleased) return;
+	const bool wasDirty = IsDirty();
+	const uint keepFlags = flags;
+	if (encoded.size() > 0) Decode(); else Load( origin.c_str(), mods );
+	flags = keepFlags;
+	if (bumpScale != 0) BumpToNormalMap( bumpScale );
+	texelsReleased = false;
+	if (!wasDirty) MarkAsNotDirty();
 }
 
 // EOF
\ No newline at end of file
@@ -56,15 +56,20 @@ public:
 	// methods
 	bool Equals( const string& o, const uint m );
 	void Load( const char* fileName, const uint modFlags, bool normalMap = false );
+	void Decode();
 	static void sRGBtoLinear( uchar* pixels, const uint size, const uint stride );
 	static float InverseGammaCorrect( float value );
 	static float4 InverseGammaCorrect( const float4& value );
 	void BumpToNormalMap( float heightScale );
+	bool ReleaseTexels();
+	void RestoreTexels();
 	uint* GetLDRPixels() { return (uint*)idata; }
 	float4* GetHDRPixels() { return fdata; }
 	// internal methods
 	int PixelsNeeded( const int width, const int height, const int MIPlevels ) const;
 	void ConstructMIPmaps();
+	bool LoadFromCache( const char* fileName, const uint modFlags );
+	void SaveToCache( const char* fileName ) const;
 	// public properties
 public:
 	uint width = 0;						// width in pixels
@@ -78,7 +83,12 @@ public:
 	uint refCount = 1;					// the number of materials that use this texture
 	uchar4* idata = nullptr;			// pointer to a 32-bit ARGB bitmap
 	float4* fdata = nullptr;			// pointer to a 128-bit ARGB bitmap
+	vector<uchar> encoded;				// compressed image for textures without a file (e.g. embedded in a glTF scene)
+	float bumpScale = 0;				// height scale used to convert a bump map; reapplied when texels are reloaded
+	bool texelsReleased = false;		// true when the texels were freed after upload to the core
+	shared_future<void> decoding;		// valid while the texels are decoded on the worker pool; see HostScene::AddScene
 	TRACKCHANGES;						// add Changed(), MarkAsDirty() methods, see system.h
+	POOLALLOCATED( HostTexture );		// allocate from a type-specific pool, see system.h
 };
 
 } // namespace lighthouse2
@@ -138,8 +138,49 @@ enum class APIState
 static APIState currentApiState = APIState::Uninitialized;
 int catIndentCount = 0;
 
-std::map<std::string, std::vector<HostNode*>> instances;
-std::vector<HostNode*>* currentInstance = nullptr;
+// Object instancing: the shapes of an ObjectBegin/End block are merged into a single mesh,
+// in the space of the block. An ObjectInstance adds a node per part of the object, which
+// shares the mesh of the part. Instances inside a block are flattened: the parts of the
+// instantiated object become parts of the block, with the transforms concatenated.
+struct DeferredDirective;
+struct ObjectPart
+{
+	int meshID;
+	Transform transform;							// part to object
+};
+struct ObjectDefinition
+{
+	std::vector<ObjectPart> parts;					// complete once pbrtFlushDeferred passed ObjectEnd
+	std::vector<DeferredDirective*> shapes;			// merged into one mesh at ObjectEnd
+};
+std::map<std::string, ObjectDefinition> instances;
+ObjectDefinition* currentInstance = nullptr;
+
+// Deferred construction: pbrtShape records the shape and returns to the parser; the meshes
+// are built on the worker pool, SHAPE_BATCH shapes at a time. Image textures get their ID
+// right away and are loaded on the worker pool as well. pbrtFlushDeferred adds the meshes
+// and nodes to the scene in directive order, so IDs do not depend on worker timing.
+#define SHAPE_BATCH 16
+struct DeferredDirective
+{
+	enum { SHAPE, OBJECT, INSTANCE } type = SHAPE;
+	// Shape
+	std::string name;
+	ParamSet params;
+	Transform objToWorld, worldToObj;
+	bool reverseOrientation = false;
+	int materialIdx = -1;
+	HostMesh* mesh = nullptr;						// built on the worker pool; for ObjectEnd: the merged shapes
+	// ObjectEnd, ObjectInstance
+	ObjectDefinition* object = nullptr;				// the object that ended, or the object to instantiate
+	ObjectDefinition* target = nullptr;				// block that receives the instanced parts; nullptr: the scene
+	std::vector<Transform> transforms;				// consecutive instances of the same object, to world or block
+};
+static std::vector<DeferredDirective*> deferredDirectives;	// in directive order
+static size_t deferredLaunched = 0;							// directives handed to the worker pool
+static std::vector<std::unique_ptr<tf::Taskflow>> deferredFlows;
+static std::vector<std::future<void>> deferredDone;
+static std::vector<HostTexture*> deferredTextures;			// registered, but possibly still loading
 
 // API Macros
 #define VERIFY_INITIALIZED( func )                         \
@@ -200,17 +241,120 @@ static HostMesh* MakeShapes( const std::string& name,
 	const Transform* object2world,
 	const Transform* world2object,
 	bool reverseOrientation,
-	const ParamSet& params,
-	const int materialIdx )
+	ParamSet& params,
+	const int materialIdx,
+	std::map<std::string, HostMaterial::ScalarValue*>* floatTextures,
+	HostMesh* target = nullptr )
 {
 	if (name == "plymesh")
-		return CreatePLYMesh( object2world, world2object, reverseOrientation, params, materialIdx, &*graphicsState.floatTextures );
+		return CreatePLYMesh( object2world, world2object, reverseOrientation, params, materialIdx, floatTextures, target );
 	else if (name == "trianglemesh")
-		return CreateTriangleMeshShape( object2world, world2object, reverseOrientation, params, materialIdx, &*graphicsState.floatTextures );
+		return CreateTriangleMeshShape( object2world, world2object, reverseOrientation, params, materialIdx, floatTextures, target );
 	else Warning( "Shape \"%s\" unknown.", name.c_str() );
 	return nullptr;
 }
 
+static void LaunchDeferredShapes()
+{
+	std::unique_ptr<tf::Taskflow> flow( new tf::Taskflow() );
+	for (; deferredLaunched < deferredDirectives.size(); deferredLaunched++)
+	{
+		DeferredDirective* d = deferredDirectives[deferredLaunched];
+		// alpha textures are not supported yet, so shapes do not need the texture maps of the
+		// graphics state, which the parser keeps changing meanwhile.
+		if (d->type == DeferredDirective::SHAPE) flow->emplace( [d]() {
+			InsideHostTask() = true;
+			d->mesh = MakeShapes( d->name, &d->objToWorld, &d->worldToObj, d->reverseOrientation, d->params, d->materialIdx, nullptr );
+		} );
+		else if (d->type == DeferredDirective::OBJECT && d->object->shapes.size() > 0) flow->emplace( [d]() {
+			InsideHostTask() = true;
+			// failed shapes leave the merged mesh untouched; their 'mesh' stays nullptr
+			d->mesh = new HostMesh;
+			for (DeferredDirective* s : d->object->shapes)
+				s->mesh = MakeShapes( s->name, &s->objToWorld, &s->worldToObj, s->reverseOrientation, s->params, s->materialIdx, nullptr, d->mesh );
+		} );
+	}
+	if (flow->num_nodes() == 0) return;
+	deferredDone.push_back( HostTaskExecutor().run( *flow ) );
+	deferredFlows.push_back( std::move( flow ) );
+}
+
+static void LoadTextureDeferred( HostTexture* texture )
+{
+	// code that needs the texels before pbrtFlushDeferred waits in HostTexture::RestoreTexels
+	auto loaded = std::make_shared<std::promise<void>>();
+	texture->decoding = loaded->get_future().share();
+	std::unique_ptr<tf::Taskflow> flow( new tf::Taskflow() );
+	flow->emplace( [texture, loaded]() {
+		InsideHostTask() = true;
+		// load into a texture of its own; the scene may look up the origin and mods of this one meanwhile
+		HostTexture image;
+		image.Load( texture->origin.c_str(), texture->mods );
+		texture->width = image.width, texture->height = image.height, texture->MIPlevels = image.MIPlevels;
+		texture->flags |= image.flags;
+		texture->idata = image.idata, texture->fdata = image.fdata;
+		loaded->set_value();
+	} );
+	deferredDone.push_back( HostTaskExecutor().run( *flow ) );
+	deferredFlows.push_back( std::move( flow ) );
+}
+
+void pbrtFlushDeferred()
+{
+	LaunchDeferredShapes();
+	for (auto& done : deferredDone) done.wait();
+	deferredDone.clear();
+	deferredFlows.clear();
+	deferredLaunched = 0;
+	for (HostTexture* texture : deferredTextures) texture->decoding = shared_future<void>();
+	deferredTextures.clear();
+	// add the results to the scene in directive order
+	HostScene* scene = PbrtOptions.scene;
+	for (DeferredDirective* d : deferredDirectives)
+	{
+		if (d->type == DeferredDirective::INSTANCE)
+		{
+			const std::vector<ObjectPart>& parts = d->object->parts;
+			if (d->target) for (const Transform& T : d->transforms) for (const ObjectPart& part : parts)
+				d->target->parts.push_back( { part.meshID, T * part.transform } );
+			else
+			{
+				scene->ReserveNodes( d->transforms.size() * parts.size() );
+				for (const Transform& T : d->transforms) for (const ObjectPart& part : parts)
+					scene->AddInstance( new HostNode( scene, part.meshID, T * part.transform ) );
+			}
+		}
+		else if (d->type == DeferredDirective::OBJECT)
+		{
+			for (DeferredDirective* s : d->object->shapes)
+			{
+				s->params.ReportUnused();
+				if (!s->mesh) Warning( "No mesh created for %s", s->name.c_str() );
+				delete s;
+			}
+			d->object->shapes.clear();
+			if (d->mesh && d->mesh->TriangleCount() > 0)
+			{
+				d->object->parts.push_back( { scene->AddMesh( d->mesh ), Transform() } );
+				d->mesh->ReplaceSingleTexelMaterials( 0 ); // needs the scene; see HostMesh::BuildFromIndexedData
+			}
+			else delete d->mesh;
+		}
+		else
+		{
+			d->params.ReportUnused();
+			if (!d->mesh) Warning( "No mesh created for %s", d->name.c_str() );
+			else
+			{
+				scene->AddInstance( new HostNode( scene, scene->AddMesh( d->mesh ), d->objToWorld ) );
+				d->mesh->ReplaceSingleTexelMaterials( 0 ); // needs the scene; see HostMesh::BuildFromIndexedData
+			}
+		}
+		delete d;
+	}
+	deferredDirectives.clear();
+}
+
 static HostMaterial* MakeMaterial( const std::string& name,
 	const TextureParams& mp )
 {
@@ -317,7 +461,9 @@ static HostMaterial::Vec3Value* CreateImageSpectrumTexture(
 	bool gamma = tp.FindBool( "gamma", HasExtension( filename, ".tga" ) || HasExtension( filename, ".png" ) );
 	int flags = HostTexture::FLIPPED;
 	if (gamma) flags |= HostTexture::GAMMACORRECTION;
-	int texId = HostScene::FindOrCreateTexture( filename, flags );
+	const size_t deferredCount = deferredTextures.size();
+	int texId = PbrtOptions.scene->FindOrCreateTexture( filename, flags, &deferredTextures );
+	if (deferredTextures.size() > deferredCount) LoadTextureDeferred( deferredTextures.back() );
 	auto texPtr = new HostMaterial::Vec3Value();
 	texPtr->textureID = texId;
 	return texPtr;
@@ -516,12 +662,13 @@ void pbrtCamera( const std::string& name, const ParamSet& params )
 	// HostScene::camera->position = make_float3( CameraToWorld[0] * make_float4( 0, 0, 0, 1 ) );
 	// HostScene::camera->direction = make_float3( CameraToWorld[0] * make_float4( 0, 0, 1, 0 ) );
 	// HostScene::camera->transform = CameraToWorld; TODO
-	HostScene::camera->FOV = params.FindOneFloat( "fov", 90.f );
-	HostScene::camera->focalDistance = params.FindOneFloat( "focaldistance", 1e6f );
+	PbrtOptions.scene->camera->FOV = params.FindOneFloat( "fov", 90.f );
+	PbrtOptions.scene->camera->focalDistance = params.FindOneFloat( "focaldistance", 1e6f );
 	// This should be `aperturediameter', but is hardly ever used.
-	HostScene::camera->aperture = params.FindOneFloat( "lensradius", 0.f );
+	PbrtOptions.scene->camera->aperture = params.FindOneFloat( "lensradius", 0.f );
 	// Reset distortion, PBRT does not pass any such information:
-	HostScene::camera->distortion = 0.f;
+	PbrtOptions.scene->camera->distortion = 0.f;
+	PbrtOptions.scene->pbrtCamera = true;
 }
 
 void pbrtMakeNamedMedium( const std::string& name, const ParamSet& params ) { Warning( "pbrtMakeNamedMedium is not implemented!" ); }
@@ -715,7 +862,7 @@ void pbrtLightSource( const std::string& name, const ParamSet& params )
 		// transform the point to the desired position in space:
 		const auto light2world = curTransform[0];
 		const auto pos = light2world.TransformPoint( P );
-		HostScene::AddPointLight( pos, (I * sc).vector() );
+		PbrtOptions.scene->AddPointLight( pos, (I * sc).vector() );
 	}
 	else if (name == "spot")
 	{
@@ -752,7 +899,7 @@ void pbrtLightSource( const std::string& name, const ParamSet& params )
 		// const auto totalWidth = coneangle + conedelta;
 		// const auto falloffStart = coneangle;
 		// This is perhaps worth filing an issue for.
-		HostScene::AddSpotLight( from, dir, std::cos( Radians( falloffStart ) ), std::cos( Radians( totalWidth ) ), (I * sc).vector() );
+		PbrtOptions.scene->AddSpotLight( from, dir, std::cos( Radians( falloffStart ) ), std::cos( Radians( totalWidth ) ), (I * sc).vector() );
 	}
 	else if (name == "distant")
 	{
@@ -764,7 +911,7 @@ void pbrtLightSource( const std::string& name, const ParamSet& params )
 		// WARNING: In PBRT the dir vector points _towards_ the light,
 		// while in LH2 this represents the direction the light is pointed towards
 		const auto dir = normalize( light2world.TransformVector( to - from ) );
-		HostScene::AddDirectionalLight( dir, (L * sc).vector() );
+		PbrtOptions.scene->AddDirectionalLight( dir, (L * sc).vector() );
 	}
 	else if (name == "infinite" || name == "exinfinite")
 	{
@@ -777,7 +924,7 @@ void pbrtLightSource( const std::string& name, const ParamSet& params )
 		const auto light2world = curTransform[0];
 		sd->worldToLight = light2world.Inverted();
 		sd->Load( texmap.c_str(), (L * sc).vector() );
-		HostScene::SetSkyDome( sd );
+		PbrtOptions.scene->SetSkyDome( sd );
 	}
 	// TODO: Implement other light types
 	else Error( "LightSource: light type \"%s\" unknown.", name.c_str() );
@@ -823,27 +970,30 @@ void pbrtShape( const std::string& name, const ParamSet& params )
 		// Sanity, ensure the material is emissive within LH2 definitions:
 		if (!mtl->IsEmissive()) Error( "None of the rgb components are larger than 1, material is not emissive!" );
 		if (twoSided) mtl->flags |= HostMaterial::EMISSIVE_TWOSIDED;
-		materialIdx = HostScene::AddMaterial( mtl );
+		materialIdx = PbrtOptions.scene->AddMaterial( mtl );
 	}
 	else
 	{
 		auto mtl = graphicsState.GetMaterialForShape( params );
-		materialIdx = HostScene::AddMaterial( mtl );
+		materialIdx = PbrtOptions.scene->AddMaterial( mtl );
 	}
 	// Initialize _prims_ and _areaLights_ for static shape
-	// Create shapes for shape _name_
+	// Create shapes for shape _name_ on the worker pool; see pbrtFlushDeferred
 	// Transform* ObjToWorld = transformCache.Lookup( curTransform[0] );
 	// Transform* WorldToObj = transformCache.Lookup( Inverse( curTransform[0] ) );
-	Transform ObjToWorld = curTransform[0];
-	Transform WorldToObj = curTransform[0].Inverted();
-	auto hostMesh = MakeShapes( name, &ObjToWorld, &WorldToObj,
-		graphicsState.reverseOrientation, params, materialIdx );
-	// if ( shapes.empty() ) return;
-	params.ReportUnused();
-	if (!hostMesh)
-	{
-		Warning( "No mesh created for %s", name.c_str() );
-		return;
+	DeferredDirective* shape = new DeferredDirective();
+	shape->name = name;
+	shape->params = params;
+	shape->objToWorld = curTransform[0];
+	shape->worldToObj = curTransform[0].Inverted();
+	shape->reverseOrientation = graphicsState.reverseOrientation;
+	shape->materialIdx = materialIdx;
+	if (name == "plymesh") PbrtOptions.scene->AddSourceFile( params.FindOneFilename( "filename", "" ) ); // for the scene cache
+	// shapes of an object definition are built when the definition ends
+	if (currentInstance) currentInstance->shapes.push_back( shape ); else
+	{
+		deferredDirectives.push_back( shape );
+		if (deferredDirectives.size() - deferredLaunched >= SHAPE_BATCH) LaunchDeferredShapes();
 	}
 	// TODO: Medium and area lights
 #if 0
@@ -852,14 +1002,6 @@ void pbrtShape( const std::string& name, const ParamSet& params )
 	prims.push_back(
 		std::make_shared<GeometricPrimitive>( s, mtl, area, mi ) );
 #endif
-	auto meshIdx = HostScene::AddMesh( hostMesh );
-	HostNode* newNode = new HostNode( meshIdx, ObjToWorld );
-	// Add _prims_ and _areaLights_ to scene or current instance
-	if (currentInstance)
-		// Abusing HostNode instance (this is not an instance of the mesh _yet_)
-		// because it keeps track of the transform.
-		currentInstance->push_back( newNode );
-	else HostScene::AddInstance( newNode );
 }
 
 // Attempt to determine if the ParamSet for a shape may provide a value for
@@ -919,7 +1061,9 @@ void pbrtObjectBegin( const std::string& name )
 	VERIFY_WORLD( "ObjectBegin" );
 	pbrtAttributeBegin();
 	if (currentInstance) Error( "ObjectBegin called inside of instance definition" );
-	instances[name] = std::vector<HostNode*>();
+	// deferred ObjectInstance directives may still refer to an earlier definition
+	if (instances.find( name ) != instances.end()) pbrtFlushDeferred();
+	instances[name] = ObjectDefinition();
 	currentInstance = &instances[name];
 	if (PbrtOptions.cat || PbrtOptions.toPly) printf( "%*sObjectBegin \"%s\"\n", catIndentCount, "", name.c_str() );
 }
@@ -929,6 +1073,15 @@ void pbrtObjectEnd()
 	VERIFY_WORLD( "ObjectEnd" );
 	if (!currentInstance) Error( "ObjectEnd called outside of instance definition" );
 	if (PbrtOptions.cat || PbrtOptions.toPly) printf( "%*sObjectEnd\n", catIndentCount, "" );
+	if (currentInstance)
+	{
+		// merge the shapes of the definition on the worker pool; see pbrtFlushDeferred
+		DeferredDirective* object = new DeferredDirective();
+		object->type = DeferredDirective::OBJECT;
+		object->object = currentInstance;
+		deferredDirectives.push_back( object );
+		if (deferredDirectives.size() - deferredLaunched >= SHAPE_BATCH) LaunchDeferredShapes();
+	}
 	currentInstance = nullptr;
 	pbrtAttributeEnd();
 }
@@ -942,18 +1095,18 @@ void pbrtObjectInstance( const std::string& name )
 		return;
 	}
 	// Perform object instance error checking
-	if (currentInstance)
+	auto definition = instances.find( name );
+	if (definition == instances.end())
 	{
-		Error( "ObjectInstance can't be called inside instance definition" );
+		Error( "Unable to find instance named \"%s\"", name.c_str() );
 		return;
 	}
-	if (instances.find( name ) == instances.end())
+	ObjectDefinition* object = &definition->second;
+	if (object == currentInstance)
 	{
-		Error( "Unable to find instance named \"%s\"", name.c_str() );
+		Error( "ObjectInstance \"%s\" can't be called inside its own definition", name.c_str() );
 		return;
 	}
-	auto& in = instances[name];
-	if (in.empty()) return;
 	// static_assert( MaxTransforms == 2,
 	// 			   "TransformCache assumes only two transforms" );
 	// Create _animatedInstanceToWorld_ transform for instance
@@ -966,12 +1119,26 @@ void pbrtObjectInstance( const std::string& name )
 	// std::shared_ptr<Primitive> prim(
 	// 	std::make_shared<TransformedPrimitive>( in[0], animatedInstanceToWorld ) );
 	// primitives.push_back( prim );
-	for (auto& mesh : in) HostScene::AddInstance( new HostNode( *mesh ) );
+	// the parts of the object may still be under construction; see pbrtFlushDeferred
+	if (curTransform.IsAnimated()) Warning( "Animated instance transforms are not supported; using the start transform" );
+	DeferredDirective* last = deferredDirectives.size() > 0 ? deferredDirectives.back() : nullptr;
+	if (last && last->type == DeferredDirective::INSTANCE && last->object == object && last->target == currentInstance)
+	{
+		last->transforms.push_back( curTransform[0] );
+		return;
+	}
+	DeferredDirective* instance = new DeferredDirective();
+	instance->type = DeferredDirective::INSTANCE;
+	instance->object = object;
+	instance->target = currentInstance;
+	instance->transforms.push_back( curTransform[0] );
+	deferredDirectives.push_back( instance );
 }
 
 void pbrtWorldEnd()
 {
 	VERIFY_WORLD( "WorldEnd" );
+	pbrtFlushDeferred();
 	// Ensure there are no pushed graphics states
 	while (pushedGraphicsStates.size())
 	{
@@ -36,15 +36,15 @@ namespace pbrt
 
 // ParamSet Macros
 #define ADD_PARAM_TYPE( T, vec ) \
-	( vec ).emplace_back( new ParamSetItem<T>( name, std::move( values ), nValues ) );
-#define LOOKUP_PTR( vec )           \
-	for ( const auto& v : vec )     \
-		if ( v->name == name )      \
-		{                           \
-			*nValues = v->nValues;  \
-			v->lookedUp = true;     \
-			return v->values.get(); \
-		}                           \
+	( vec ).emplace_back( new ParamSetItem<T>( name, std::move( values ) ) );
+#define LOOKUP_PTR( vec )            \
+	for ( const auto& v : vec )      \
+		if ( v->name == name )       \
+		{                            \
+			*nValues = v->nValues;   \
+			v->lookedUp = true;      \
+			return v->values.data(); \
+		}                            \
 	return nullptr
 #define LOOKUP_ONE( vec )                         \
 	for ( const auto& v : vec )                   \
@@ -54,118 +54,112 @@ namespace pbrt
 			return v->values[0];                  \
 		}                                         \
 	return d
+#define LOOKUP_TAKE( vec )                        \
+	for ( const auto& v : vec )                   \
+		if ( v->name == name )                    \
+		{                                         \
+			v->lookedUp = true;                   \
+			values = std::move( v->values );      \
+			v->values.clear();                    \
+			v->nValues = 0;                       \
+			return true;                          \
+		}                                         \
+	return false
 
 // ParamSet Methods
-void ParamSet::AddFloat( const std::string& name,
-	std::unique_ptr<Float[]> values, int nValues )
+void ParamSet::AddFloat( const std::string& name, std::vector<Float> values )
 {
 	EraseFloat( name );
 	floats.emplace_back(
-		new ParamSetItem<Float>( name, std::move( values ), nValues ) );
+		new ParamSetItem<Float>( name, std::move( values ) ) );
 }
 
-void ParamSet::AddInt( const std::string& name, std::unique_ptr<int[]> values,
-	int nValues )
+void ParamSet::AddInt( const std::string& name, std::vector<int> values )
 {
 	EraseInt( name );
 	ADD_PARAM_TYPE( int, ints );
 }
 
-void ParamSet::AddBool( const std::string& name, std::unique_ptr<bool[]> values,
-	int nValues )
+void ParamSet::AddBool( const std::string& name, std::vector<bool> values )
 {
 	EraseBool( name );
 	ADD_PARAM_TYPE( bool, bools );
 }
 
-void ParamSet::AddPoint2f( const std::string& name,
-	std::unique_ptr<Point2f[]> values, int nValues )
+void ParamSet::AddPoint2f( const std::string& name, std::vector<Point2f> values )
 {
 	ErasePoint2f( name );
 	ADD_PARAM_TYPE( Point2f, point2fs );
 }
 
-void ParamSet::AddVector2f( const std::string& name,
-	std::unique_ptr<Vector2f[]> values, int nValues )
+void ParamSet::AddVector2f( const std::string& name, std::vector<Vector2f> values )
 {
 	EraseVector2f( name );
 	ADD_PARAM_TYPE( Vector2f, vector2fs );
 }
 
-void ParamSet::AddPoint3f( const std::string& name,
-	std::unique_ptr<Point3f[]> values, int nValues )
+void ParamSet::AddPoint3f( const std::string& name, std::vector<Point3f> values )
 {
 	ErasePoint3f( name );
 	ADD_PARAM_TYPE( Point3f, point3fs );
 }
 
-void ParamSet::AddVector3f( const std::string& name,
-	std::unique_ptr<Vector3f[]> values, int nValues )
+void ParamSet::AddVector3f( const std::string& name, std::vector<Vector3f> values )
 {
 	EraseVector3f( name );
 	ADD_PARAM_TYPE( Vector3f, vector3fs );
 }
 
-void ParamSet::AddNormal3f( const std::string& name,
-	std::unique_ptr<Normal3f[]> values, int nValues )
+void ParamSet::AddNormal3f( const std::string& name, std::vector<Normal3f> values )
 {
 	EraseNormal3f( name );
 	ADD_PARAM_TYPE( Normal3f, normals );
 }
 
-void ParamSet::AddRGBSpectrum( const std::string& name,
-	std::unique_ptr<Float[]> values, int nValues )
+void ParamSet::AddRGBSpectrum( const std::string& name, const std::vector<Float>& values )
 {
 	EraseSpectrum( name );
-	CHECK_EQ( nValues % 3, 0 );
-	nValues /= 3;
-	std::unique_ptr<Spectrum[]> s( new Spectrum[nValues] );
-	for (int i = 0; i < nValues; ++i) s[i] = Spectrum::FromRGB( &values[3 * i] );
+	CHECK_EQ( values.size() % 3, 0 );
+	std::vector<Spectrum> s( values.size() / 3 );
+	for (size_t i = 0; i < s.size(); ++i) s[i] = Spectrum::FromRGB( &values[3 * i] );
 	std::shared_ptr<ParamSetItem<Spectrum>> psi(
-		new ParamSetItem<Spectrum>( name, std::move( s ), nValues ) );
+		new ParamSetItem<Spectrum>( name, std::move( s ) ) );
 	spectra.push_back( psi );
 }
 
-void ParamSet::AddXYZSpectrum( const std::string& name,
-	std::unique_ptr<Float[]> values, int nValues )
+void ParamSet::AddXYZSpectrum( const std::string& name, const std::vector<Float>& values )
 {
 	EraseSpectrum( name );
-	CHECK_EQ( nValues % 3, 0 );
-	nValues /= 3;
-	std::unique_ptr<Spectrum[]> s( new Spectrum[nValues] );
-	for (int i = 0; i < nValues; ++i) s[i] = Spectrum::FromXYZ( &values[3 * i] );
+	CHECK_EQ( values.size() % 3, 0 );
+	std::vector<Spectrum> s( values.size() / 3 );
+	for (size_t i = 0; i < s.size(); ++i) s[i] = Spectrum::FromXYZ( &values[3 * i] );
 	std::shared_ptr<ParamSetItem<Spectrum>> psi(
-		new ParamSetItem<Spectrum>( name, std::move( s ), nValues ) );
+		new ParamSetItem<Spectrum>( name, std::move( s ) ) );
 	spectra.push_back( psi );
 }
 
-void ParamSet::AddBlackbodySpectrum( const std::string& name,
-	std::unique_ptr<Float[]> values,
-	int nValues )
+void ParamSet::AddBlackbodySpectrum( const std::string& name, const std::vector<Float>& values )
 {
 	EraseSpectrum( name );
-	CHECK_EQ( nValues % 2, 0 ); // temperature (K), scale, ...
-	nValues /= 2;
-	std::unique_ptr<Spectrum[]> s( new Spectrum[nValues] );
+	CHECK_EQ( values.size() % 2, 0 ); // temperature (K), scale, ...
+	std::vector<Spectrum> s( values.size() / 2 );
 	std::unique_ptr<Float[]> v( new Float[nCIESamples] );
-	for (int i = 0; i < nValues; ++i)
+	for (size_t i = 0; i < s.size(); ++i)
 	{
 		BlackbodyNormalized( CIE_lambda, nCIESamples, values[2 * i], v.get() );
 		s[i] = values[2 * i + 1] *
 			Spectrum::FromSampled( CIE_lambda, v.get(), nCIESamples );
 	}
 	std::shared_ptr<ParamSetItem<Spectrum>> psi(
-		new ParamSetItem<Spectrum>( name, std::move( s ), nValues ) );
+		new ParamSetItem<Spectrum>( name, std::move( s ) ) );
 	spectra.push_back( psi );
 }
 
-void ParamSet::AddSampledSpectrum( const std::string& name,
-	std::unique_ptr<Float[]> values,
-	int nValues )
+void ParamSet::AddSampledSpectrum( const std::string& name, const std::vector<Float>& values )
 {
 	EraseSpectrum( name );
-	CHECK_EQ( nValues % 2, 0 );
-	nValues /= 2;
+	CHECK_EQ( values.size() % 2, 0 );
+	const int nValues = (int)values.size() / 2;
 	std::unique_ptr<Float[]> wl( new Float[nValues] );
 	std::unique_ptr<Float[]> v( new Float[nValues] );
 	for (int i = 0; i < nValues; ++i)
@@ -173,19 +167,19 @@ void ParamSet::AddSampledSpectrum( const std::string& name,
 		wl[i] = values[2 * i];
 		v[i] = values[2 * i + 1];
 	}
-	std::unique_ptr<Spectrum[]> s( new Spectrum[1] );
+	std::vector<Spectrum> s( 1 );
 	s[0] = Spectrum::FromSampled( wl.get(), v.get(), nValues );
 	std::shared_ptr<ParamSetItem<Spectrum>> psi(
-		new ParamSetItem<Spectrum>( name, std::move( s ), 1 ) );
+		new ParamSetItem<Spectrum>( name, std::move( s ) ) );
 	spectra.push_back( psi );
 }
 
 void ParamSet::AddSampledSpectrumFiles( const std::string& name,
-	const char** names, int nValues )
+	const std::vector<std::string>& names )
 {
 	EraseSpectrum( name );
-	std::unique_ptr<Spectrum[]> s( new Spectrum[nValues] );
-	for (int i = 0; i < nValues; ++i)
+	std::vector<Spectrum> s( names.size() );
+	for (size_t i = 0; i < names.size(); ++i)
 	{
 		std::string fn = AbsolutePath( ResolveFilename( names[i] ) );
 		if (cachedSpectra.find( fn ) != cachedSpectra.end())
@@ -223,13 +217,12 @@ void ParamSet::AddSampledSpectrumFiles( const std::string& name,
 	}
 
 	std::shared_ptr<ParamSetItem<Spectrum>> psi(
-		new ParamSetItem<Spectrum>( name, std::move( s ), nValues ) );
+		new ParamSetItem<Spectrum>( name, std::move( s ) ) );
 	spectra.push_back( psi );
 }
 
 std::map<std::string, Spectrum> ParamSet::cachedSpectra;
-void ParamSet::AddString( const std::string& name,
-	std::unique_ptr<std::string[]> values, int nValues )
+void ParamSet::AddString( const std::string& name, std::vector<std::string> values )
 {
 	EraseString( name );
 	ADD_PARAM_TYPE( std::string, strings );
@@ -238,10 +231,8 @@ void ParamSet::AddString( const std::string& name,
 void ParamSet::AddTexture( const std::string& name, const std::string& value )
 {
 	EraseTexture( name );
-	std::unique_ptr<std::string[]> str( new std::string[1] );
-	str[0] = value;
 	std::shared_ptr<ParamSetItem<std::string>> psi(
-		new ParamSetItem<std::string>( name, std::move( str ), 1 ) );
+		new ParamSetItem<std::string>( name, std::vector<std::string>( 1, value ) ) );
 	textures.push_back( psi );
 }
 
@@ -384,7 +375,7 @@ const Float* ParamSet::FindFloat( const std::string& name, int* n ) const
 		{
 			*n = f->nValues;
 			f->lookedUp = true;
-			return f->values.get();
+			return f->values.data();
 		}
 	return nullptr;
 }
@@ -394,11 +385,6 @@ const int* ParamSet::FindInt( const std::string& name, int* nValues ) const
 	LOOKUP_PTR( ints );
 }
 
-const bool* ParamSet::FindBool( const std::string& name, int* nValues ) const
-{
-	LOOKUP_PTR( bools );
-}
-
 int ParamSet::FindOneInt( const std::string& name, int d ) const
 {
 	LOOKUP_ONE( ints );
@@ -493,6 +479,31 @@ std::string ParamSet::FindOneString( const std::string& name,
 	LOOKUP_ONE( strings );
 }
 
+bool ParamSet::TakeInt( const std::string& name, std::vector<int>& values )
+{
+	LOOKUP_TAKE( ints );
+}
+
+bool ParamSet::TakeFloat( const std::string& name, std::vector<Float>& values )
+{
+	LOOKUP_TAKE( floats );
+}
+
+bool ParamSet::TakePoint2f( const std::string& name, std::vector<Point2f>& values )
+{
+	LOOKUP_TAKE( point2fs );
+}
+
+bool ParamSet::TakePoint3f( const std::string& name, std::vector<Point3f>& values )
+{
+	LOOKUP_TAKE( point3fs );
+}
+
+bool ParamSet::TakeNormal3f( const std::string& name, std::vector<Normal3f>& values )
+{
+	LOOKUP_TAKE( normals );
+}
+
 std::string ParamSet::FindOneFilename( const std::string& name,
 	const std::string& d ) const
 {
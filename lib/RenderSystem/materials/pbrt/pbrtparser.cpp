@@ -640,12 +640,19 @@ static string_view dequoteString( string_view str )
 	return str;
 }
 
+// values are stored in the array that ParamSet will keep, according to the declared type,
+// so that large arrays (e.g. the vertices of a triangle mesh) are never copied.
 struct ParamListItem
 {
-	std::string name;
-	double* doubleValues = nullptr;
-	const char** stringValues = nullptr;
-	size_t size = 0;
+	std::string name;					// declaration: type and name
+	std::string paramName;				// name without the type
+	int type = -1;						// PARAM_TYPE_*, or -1 if the declaration is invalid
+	std::vector<int> ints;				// integer
+	std::vector<Float> floats;			// float, rgb/color, xyz, blackbody, spectrum
+	std::vector<float2> float2s;		// point2, vector2
+	std::vector<float3> float3s;		// point3, vector3, normal
+	std::vector<std::string> strings;	// bool, string, texture, spectrum files
+	size_t size = 0;					// number of values
 	bool isString = false;
 };
 
@@ -749,15 +756,15 @@ static const char* paramTypeToName( int type )
 	}
 }
 
-static void AddParam( ParamSet& ps, const ParamListItem& item, SpectrumType spectrumType )
+static void AddParam( ParamSet& ps, ParamListItem& item, SpectrumType spectrumType )
 {
-	int type;
-	std::string name;
-	if (lookupType( item.name, &type, name ))
+	const int type = item.type;
+	const std::string& name = item.paramName;
+	if (type != -1)
 	{
 		if (type == PARAM_TYPE_TEXTURE || type == PARAM_TYPE_STRING || type == PARAM_TYPE_BOOL)
 		{
-			if (!item.stringValues)
+			if (!item.isString)
 			{
 				Error( "Expected string parameter value for parameter "
 					"\"%s\" with type \"%s\". Ignoring.", name.c_str(), paramTypeToName( type ) );
@@ -766,7 +773,7 @@ static void AddParam( ParamSet& ps, const ParamListItem& item, SpectrumType spec
 		}
 		else if (type != PARAM_TYPE_SPECTRUM)
 		{ /* spectrum can be either... */
-			if (item.stringValues)
+			if (item.isString)
 			{
 				Error( "Expected numeric parameter value for parameter "
 					"\"%s\" with type \"%s\".  Ignoring.", name.c_str(), paramTypeToName( type ) );
@@ -774,22 +781,14 @@ static void AddParam( ParamSet& ps, const ParamListItem& item, SpectrumType spec
 			}
 		}
 		int nItems = (int)item.size;
-		if (type == PARAM_TYPE_INT)
-		{
-			// parser doesn't handle ints, so convert from doubles here....
-			int nAlloc = nItems;
-			std::unique_ptr<int[]> idata( new int[nAlloc] );
-			for (int j = 0; j < nAlloc; ++j) idata[j] = int( item.doubleValues[j] );
-			ps.AddInt( name, std::move( idata ), nItems );
-		}
+		if (type == PARAM_TYPE_INT) ps.AddInt( name, std::move( item.ints ) );
 		else if (type == PARAM_TYPE_BOOL)
 		{
 			// strings -> bools
-			int nAlloc = (int)item.size;
-			std::unique_ptr<bool[]> bdata( new bool[nAlloc] );
-			for (int j = 0; j < nAlloc; ++j)
+			std::vector<bool> bdata( item.size );
+			for (size_t j = 0; j < item.size; ++j)
 			{
-				std::string s( item.stringValues[j] );
+				const std::string& s = item.strings[j];
 				if (s == "true") bdata[j] = true;
 				else if (s == "false") bdata[j] = false;
 				else
@@ -799,81 +798,31 @@ static void AddParam( ParamSet& ps, const ParamListItem& item, SpectrumType spec
 					bdata[j] = false;
 				}
 			}
-			ps.AddBool( name, std::move( bdata ), nItems );
-		}
-		else if (type == PARAM_TYPE_FLOAT)
-		{
-			std::unique_ptr<Float[]> floats( new Float[nItems] );
-			for (int i = 0; i < nItems; ++i) floats[i] = item.doubleValues[i];
-			ps.AddFloat( name, std::move( floats ), nItems );
-		}
-		else if (type == PARAM_TYPE_POINT2)
-		{
-			if ((nItems % 2) != 0)
-				Warning( "Excess values given with point2 parameter \"%s\". "
-					"Ignoring last one of them.", item.name.c_str() );
-			std::unique_ptr<Point2f[]> pts( new Point2f[nItems / 2] );
-			for (int i = 0; i < nItems / 2; ++i)
-			{
-				pts[i].x = item.doubleValues[2 * i];
-				pts[i].y = item.doubleValues[2 * i + 1];
-			}
-			ps.AddPoint2f( name, std::move( pts ), nItems / 2 );
+			ps.AddBool( name, std::move( bdata ) );
 		}
-		else if (type == PARAM_TYPE_VECTOR2)
+		else if (type == PARAM_TYPE_FLOAT) ps.AddFloat( name, std::move( item.floats ) );
+		else if (type == PARAM_TYPE_POINT2 || type == PARAM_TYPE_VECTOR2)
 		{
 			if ((nItems % 2) != 0)
-				Warning( "Excess values given with vector2 parameter \"%s\". "
-					"Ignoring last one of them.", item.name.c_str() );
-			std::unique_ptr<Vector2f[]> vecs( new Vector2f[nItems / 2] );
-			for (int i = 0; i < nItems / 2; ++i)
-			{
-				vecs[i].x = item.doubleValues[2 * i];
-				vecs[i].y = item.doubleValues[2 * i + 1];
-			}
-			ps.AddVector2f( name, std::move( vecs ), nItems / 2 );
-		}
-		else if (type == PARAM_TYPE_POINT3)
-		{
-			if ((nItems % 3) != 0)
-				Warning( "Excess values given with point3 parameter \"%s\". "
-					"Ignoring last %d of them.", item.name.c_str(), nItems % 3 );
-			std::unique_ptr<Point3f[]> pts( new Point3f[nItems / 3] );
-			for (int i = 0; i < nItems / 3; ++i)
 			{
-				pts[i].x = item.doubleValues[3 * i];
-				pts[i].y = item.doubleValues[3 * i + 1];
-				pts[i].z = item.doubleValues[3 * i + 2];
+				Warning( "Excess values given with %s parameter \"%s\". "
+					"Ignoring last one of them.", paramTypeToName( type ), item.name.c_str() );
+				item.float2s.pop_back();
 			}
-			ps.AddPoint3f( name, std::move( pts ), nItems / 3 );
+			if (type == PARAM_TYPE_POINT2) ps.AddPoint2f( name, std::move( item.float2s ) );
+			else ps.AddVector2f( name, std::move( item.float2s ) );
 		}
-		else if (type == PARAM_TYPE_VECTOR3)
+		else if (type == PARAM_TYPE_POINT3 || type == PARAM_TYPE_VECTOR3 || type == PARAM_TYPE_NORMAL)
 		{
 			if ((nItems % 3) != 0)
-				Warning( "Excess values given with vector3 parameter \"%s\". "
-					"Ignoring last %d of them.", item.name.c_str(), nItems % 3 );
-			std::unique_ptr<Vector3f[]> vecs( new Vector3f[nItems / 3] );
-			for (int j = 0; j < nItems / 3; ++j)
 			{
-				vecs[j].x = item.doubleValues[3 * j];
-				vecs[j].y = item.doubleValues[3 * j + 1];
-				vecs[j].z = item.doubleValues[3 * j + 2];
+				Warning( "Excess values given with %s parameter \"%s\". "
+					"Ignoring last %d of them.", paramTypeToName( type ), item.name.c_str(), nItems % 3 );
+				item.float3s.pop_back();
 			}
-			ps.AddVector3f( name, std::move( vecs ), nItems / 3 );
-		}
-		else if (type == PARAM_TYPE_NORMAL)
-		{
-			if ((nItems % 3) != 0)
-				Warning( "Excess values given with \"normal\" parameter \"%s\". "
-					"Ignoring last %d of them.", item.name.c_str(), nItems % 3 );
-			std::unique_ptr<Normal3f[]> normals( new Normal3f[nItems / 3] );
-			for (int j = 0; j < nItems / 3; ++j)
-			{
-				normals[j].x = item.doubleValues[3 * j];
-				normals[j].y = item.doubleValues[3 * j + 1];
-				normals[j].z = item.doubleValues[3 * j + 2];
-			}
-			ps.AddNormal3f( name, std::move( normals ), nItems / 3 );
+			if (type == PARAM_TYPE_POINT3) ps.AddPoint3f( name, std::move( item.float3s ) );
+			else if (type == PARAM_TYPE_VECTOR3) ps.AddVector3f( name, std::move( item.float3s ) );
+			else ps.AddNormal3f( name, std::move( item.float3s ) );
 		}
 		else if (type == PARAM_TYPE_RGB)
 		{
@@ -881,11 +830,9 @@ static void AddParam( ParamSet& ps, const ParamListItem& item, SpectrumType spec
 			{
 				Warning( "Excess RGB values given with parameter \"%s\". Ignoring last %d of them",
 					item.name.c_str(), nItems % 3 );
-				nItems -= nItems % 3;
+				item.floats.resize( nItems - nItems % 3 );
 			}
-			std::unique_ptr<Float[]> floats( new Float[nItems] );
-			for (int j = 0; j < nItems; ++j) floats[j] = item.doubleValues[j];
-			ps.AddRGBSpectrum( name, std::move( floats ), nItems );
+			ps.AddRGBSpectrum( name, item.floats );
 		}
 		else if (type == PARAM_TYPE_XYZ)
 		{
@@ -893,11 +840,9 @@ static void AddParam( ParamSet& ps, const ParamListItem& item, SpectrumType spec
 			{
 				Warning( "Excess XYZ values given with parameter \"%s\". Ignoring last %d of them",
 					item.name.c_str(), nItems % 3 );
-				nItems -= nItems % 3;
+				item.floats.resize( nItems - nItems % 3 );
 			}
-			std::unique_ptr<Float[]> floats( new Float[nItems] );
-			for (int j = 0; j < nItems; ++j) floats[j] = item.doubleValues[j];
-			ps.AddXYZSpectrum( name, std::move( floats ), nItems );
+			ps.AddXYZSpectrum( name, item.floats );
 		}
 		else if (type == PARAM_TYPE_BLACKBODY)
 		{
@@ -905,17 +850,15 @@ static void AddParam( ParamSet& ps, const ParamListItem& item, SpectrumType spec
 			{
 				Warning( "Excess value given with blackbody parameter \"%s\". Ignoring extra one.",
 					item.name.c_str() );
-				nItems -= nItems % 2;
+				item.floats.resize( nItems - nItems % 2 );
 			}
-			std::unique_ptr<Float[]> floats( new Float[nItems] );
-			for (int j = 0; j < nItems; ++j) floats[j] = item.doubleValues[j];
-			ps.AddBlackbodySpectrum( name, std::move( floats ), nItems );
+			ps.AddBlackbodySpectrum( name, item.floats );
 		}
 		else if (type == PARAM_TYPE_SPECTRUM)
 		{
-			if (item.stringValues)
+			if (item.isString)
 			{
-				ps.AddSampledSpectrumFiles( name, item.stringValues, nItems );
+				ps.AddSampledSpectrumFiles( name, item.strings );
 			}
 			else
 			{
@@ -923,26 +866,15 @@ static void AddParam( ParamSet& ps, const ParamListItem& item, SpectrumType spec
 				{
 					Warning( "Non-even number of values given with sampled "
 						"spectrum parameter \"%s\". Ignoring extra.", item.name.c_str() );
-					nItems -= nItems % 2;
+					item.floats.resize( nItems - nItems % 2 );
 				}
-				std::unique_ptr<Float[]> floats( new Float[nItems] );
-				for (int j = 0; j < nItems; ++j) floats[j] = item.doubleValues[j];
-				ps.AddSampledSpectrum( name, std::move( floats ), nItems );
+				ps.AddSampledSpectrum( name, item.floats );
 			}
 		}
-		else if (type == PARAM_TYPE_STRING)
-		{
-			std::unique_ptr<std::string[]> strings( new std::string[nItems] );
-			for (int j = 0; j < nItems; ++j) strings[j] = std::string( item.stringValues[j] );
-			ps.AddString( name, std::move( strings ), nItems );
-		}
+		else if (type == PARAM_TYPE_STRING) ps.AddString( name, std::move( item.strings ) );
 		else if (type == PARAM_TYPE_TEXTURE)
 		{
-			if (nItems == 1)
-			{
-				std::string val( *item.stringValues );
-				ps.AddTexture( name, val );
-			}
+			if (nItems == 1) ps.AddTexture( name, item.strings[0] );
 			else Error( "Only one string allowed for \"texture\" parameter \"%s\"", name.c_str() );
 		}
 	}
@@ -964,45 +896,44 @@ ParamSet parseParams( Next nextToken, Unget ungetToken, SpectrumType spectrumTyp
 		}
 		ParamListItem item;
 		item.name = toString( dequoteString( decl ) );
-		size_t nAlloc = 0;
+		if (!lookupType( item.name, &item.type, item.paramName )) item.type = -1;
 		auto addVal = [&]( string_view val )
 		{
 			if (isQuotedString( val ))
 			{
-				if (item.doubleValues)
+				if (item.size > 0 && !item.isString)
 				{
 					Error( "mixed string and numeric parameters" );
 					exit( 1 );
 				}
-				if (item.size == nAlloc)
-				{
-					nAlloc = std::max<size_t>( 2 * item.size, 4 );
-					const char** newData = new const char*[nAlloc];
-					std::copy( item.stringValues, item.stringValues + item.size, newData );
-					item.stringValues = newData;
-				}
-				val = dequoteString( val );
-				char* buf = new char[val.size() + 1];
-				memcpy( buf, val.data(), val.size() );
-				buf[val.size()] = '\0';
-				item.stringValues[item.size++] = buf;
+				item.isString = true;
+				item.strings.push_back( toString( dequoteString( val ) ) );
 			}
 			else
 			{
-				if (item.stringValues)
+				if (item.isString)
 				{
 					Error( "mixed string and numeric parameters" );
 					exit( 1 );
 				}
-				if (item.size == nAlloc)
+				// append to the array of the declared type; vectors are filled one component at a time
+				const double number = parseNumber( val );
+				const Float v = (Float)number;
+				switch (item.type)
 				{
-					nAlloc = std::max<size_t>( 2 * item.size, 4 );
-					double* newData = new double[nAlloc];
-					std::copy( item.doubleValues, item.doubleValues + item.size, newData );
-					item.doubleValues = newData;
+				case PARAM_TYPE_INT: item.ints.push_back( int( number ) ); break;
+				case PARAM_TYPE_POINT2: case PARAM_TYPE_VECTOR2:
+					if (item.size % 2 == 0) item.float2s.push_back( make_float2( 0 ) );
+					(&item.float2s.back().x)[item.size % 2] = v;
+					break;
+				case PARAM_TYPE_POINT3: case PARAM_TYPE_VECTOR3: case PARAM_TYPE_NORMAL:
+					if (item.size % 3 == 0) item.float3s.push_back( make_float3( 0 ) );
+					(&item.float3s.back().x)[item.size % 3] = v;
+					break;
+				default: item.floats.push_back( v );
 				}
-				item.doubleValues[item.size++] = parseNumber( val );
 			}
+			item.size++;
 		};
 		string_view val = nextToken( TokenRequired );
 		if (val == "[") while (true)
@@ -1158,6 +1089,7 @@ static void parse( std::unique_ptr<Tokenizer> t )
 					std::unique_ptr<Tokenizer> tinc = Tokenizer::CreateFromFile( filename, tokError );
 					if (tinc)
 					{
+						PbrtOptions.scene->AddSourceFile( filename ); // for the scene cache
 						fileStack.push_back( std::move( tinc ) );
 						parserLoc = &fileStack.back()->loc;
 					}
@@ -1311,6 +1243,7 @@ void pbrtParseFile( std::string filename )
 	std::unique_ptr<Tokenizer> t = Tokenizer::CreateFromFile( filename, tokError );
 	if (!t) return;
 	parse( std::move( t ) );
+	pbrtFlushDeferred(); // in case the file lacks a WorldEnd
 }
 
 void pbrtParseString( std::string str )
@@ -1319,11 +1252,12 @@ void pbrtParseString( std::string str )
 	std::unique_ptr<Tokenizer> t = Tokenizer::CreateFromString( std::move( str ), tokError );
 	if (!t) return;
 	parse( std::move( t ) );
+	pbrtFlushDeferred();
 }
 
 } // namespace pbrt
 
 // namespace-less interface
 
-void PBRTInit() { pbrt::Options opt; pbrt::pbrtInit( opt ); }
+void PBRTInit( HostScene* scene ) { pbrt::Options opt; opt.scene = scene; pbrt::pbrtInit( opt ); }
 void ParsePBRTScene( std::string filename ) { pbrt::pbrtParseFile( filename ); }
\ No newline at end of file
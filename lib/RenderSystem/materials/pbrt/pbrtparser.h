@@ -42,7 +42,11 @@
 namespace pbrt
 {
 
-struct Options { bool cat = false, toPly = false; };
+struct Options
+{
+	bool cat = false, toPly = false;
+	HostScene* scene = nullptr;		// receives the parsed meshes, materials and lights
+};
 
 using Float = float;
 using Vector3f = float3;
@@ -190,21 +194,21 @@ class ParamSet
 {
 public:
 	ParamSet() {}
-	void AddFloat( const std::string&, std::unique_ptr<Float[]> v, int nValues = 1 );
-	void AddInt( const std::string&, std::unique_ptr<int[]> v, int nValues );
-	void AddBool( const std::string&, std::unique_ptr<bool[]> v, int nValues );
-	void AddPoint2f( const std::string&, std::unique_ptr<Point2f[]> v, int nValues );
-	void AddVector2f( const std::string&, std::unique_ptr<Vector2f[]> v, int nValues );
-	void AddPoint3f( const std::string&, std::unique_ptr<Point3f[]> v, int nValues );
-	void AddVector3f( const std::string&, std::unique_ptr<Vector3f[]> v, int nValues );
-	void AddNormal3f( const std::string&, std::unique_ptr<Normal3f[]> v, int nValues );
-	void AddString( const std::string&, std::unique_ptr<std::string[]> v, int nValues );
+	void AddFloat( const std::string&, std::vector<Float> v );
+	void AddInt( const std::string&, std::vector<int> v );
+	void AddBool( const std::string&, std::vector<bool> v );
+	void AddPoint2f( const std::string&, std::vector<Point2f> v );
+	void AddVector2f( const std::string&, std::vector<Vector2f> v );
+	void AddPoint3f( const std::string&, std::vector<Point3f> v );
+	void AddVector3f( const std::string&, std::vector<Vector3f> v );
+	void AddNormal3f( const std::string&, std::vector<Normal3f> v );
+	void AddString( const std::string&, std::vector<std::string> v );
 	void AddTexture( const std::string&, const std::string& );
-	void AddRGBSpectrum( const std::string&, std::unique_ptr<Float[]> v, int nValues );
-	void AddXYZSpectrum( const std::string&, std::unique_ptr<Float[]> v, int nValues );
-	void AddBlackbodySpectrum( const std::string&, std::unique_ptr<Float[]> v, int nValues );
-	void AddSampledSpectrumFiles( const std::string&, const char**, int nValues );
-	void AddSampledSpectrum( const std::string&, std::unique_ptr<Float[]> v, int nValues );
+	void AddRGBSpectrum( const std::string&, const std::vector<Float>& v );
+	void AddXYZSpectrum( const std::string&, const std::vector<Float>& v );
+	void AddBlackbodySpectrum( const std::string&, const std::vector<Float>& v );
+	void AddSampledSpectrumFiles( const std::string&, const std::vector<std::string>& files );
+	void AddSampledSpectrum( const std::string&, const std::vector<Float>& v );
 	bool EraseInt( const std::string& );
 	bool EraseBool( const std::string& );
 	bool EraseFloat( const std::string& );
@@ -230,7 +234,6 @@ public:
 	std::string FindTexture( const std::string& ) const;
 	const Float* FindFloat( const std::string&, int* n ) const;
 	const int* FindInt( const std::string&, int* nValues ) const;
-	const bool* FindBool( const std::string&, int* nValues ) const;
 	const Point2f* FindPoint2f( const std::string&, int* nValues ) const;
 	const Vector2f* FindVector2f( const std::string&, int* nValues ) const;
 	const Point3f* FindPoint3f( const std::string&, int* nValues ) const;
@@ -238,6 +241,12 @@ public:
 	const Normal3f* FindNormal3f( const std::string&, int* nValues ) const;
 	const Spectrum* FindSpectrum( const std::string&, int* nValues ) const;
 	const std::string* FindString( const std::string&, int* nValues ) const;
+	// move the values of a parameter out of the set, e.g. into a mesh, instead of copying them
+	bool TakeInt( const std::string&, std::vector<int>& values );
+	bool TakeFloat( const std::string&, std::vector<Float>& values );
+	bool TakePoint2f( const std::string&, std::vector<Point2f>& values );
+	bool TakePoint3f( const std::string&, std::vector<Point3f>& values );
+	bool TakeNormal3f( const std::string&, std::vector<Normal3f>& values );
 	void ReportUnused() const;
 	void Clear();
 	std::string ToString() const;
@@ -261,17 +270,17 @@ private:
 
 template <typename T> struct ParamSetItem
 {
-	ParamSetItem( const std::string& name, std::unique_ptr<T[]> val, int nValues = 1 );
+	ParamSetItem( const std::string& name, std::vector<T> val );
 	const std::string name;
-	const std::unique_ptr<T[]> values;
-	const int nValues;
+	std::vector<T> values;	// empty after ParamSet::Take*
+	int nValues;
 	mutable bool lookedUp = false;
 };
 
 // ParamSetItem Methods
 template <typename T>
-ParamSetItem<T>::ParamSetItem( const std::string& name, std::unique_ptr<T[]> v, int nValues )
-	: name( name ), values( std::move( v ) ), nValues( nValues )
+ParamSetItem<T>::ParamSetItem( const std::string& name, std::vector<T> v )
+	: name( name ), values( std::move( v ) ), nValues( (int)values.size() )
 {
 }
 
@@ -377,16 +386,17 @@ void pbrtObjectBegin( const std::string& name );
 void pbrtObjectEnd();
 void pbrtObjectInstance( const std::string& name );
 void pbrtWorldEnd();
+void pbrtFlushDeferred();
 void pbrtParseFile( std::string filename );
 void pbrtParseString( std::string str );
 
-// Creating meshes
+// Creating meshes; with a target mesh, the shape is appended to it, transformed by o2w
 HostMesh* CreatePLYMesh( const Transform* o2w, const Transform* w2o, bool reverseOrientation,
 	const ParamSet& params, const int materialIdx, std::map<std::string, 
-	HostMaterial::ScalarValue*>* floatTextures = nullptr );
+	HostMaterial::ScalarValue*>* floatTextures = nullptr, HostMesh* target = nullptr );
 HostMesh* CreateTriangleMeshShape( const Transform* o2w, const Transform* w2o, bool reverseOrientation, 
-	const ParamSet& params, const int materialIdx, std::map<std::string, 
-	HostMaterial::ScalarValue*>* floatTextures = nullptr );
+	ParamSet& params, const int materialIdx, std::map<std::string, 
+	HostMaterial::ScalarValue*>* floatTextures = nullptr, HostMesh* target = nullptr );
 
 // Creating materials
 HostMaterial* CreateDisneyMaterial( const TextureParams& mp );
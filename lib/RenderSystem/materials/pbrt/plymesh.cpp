@@ -182,21 +182,201 @@ int rply_face_callback( p_ply_argument argument )
 	return 1;
 }
 
-HostMesh* CreatePLYMesh(
-	const Transform* o2w, const Transform* w2o, bool reverseOrientation, const ParamSet& params, 
-	const int materialIdx, map<string, HostMaterial::ScalarValue*>* floatTextures )
+/* Fast path for binary little-endian PLY files: the file is mapped into memory and the
+   vertex and face blocks are read directly into typed arrays, without the per-value
+   callbacks of RPly. Handles the common layout: a 'vertex' element with float coordinates,
+   normals and uvs, followed by a 'face' element that holds only a 'vertex_indices' list
+   with an 8-bit count and 32-bit indices. Returns false if the file does not have this
+   layout; 'failed' is set if it does, but the data is invalid. */
+struct PLYProperty
+{
+	string name;
+	int size = 0, offset = 0;		// scalar properties: size in bytes and offset in the element
+	bool isFloat = false;
+	bool isList = false;
+	int countSize = 0;				// list properties: sizes of the count and of the items
+	int itemSize = 0;
+};
+struct PLYElement
+{
+	string name;
+	long count = 0;
+	int stride = 0;					// size of one element, if it has no list properties
+	vector<PLYProperty> properties;
+	const PLYProperty* Find( const char* name ) const
+	{
+		for (const PLYProperty& p : properties) if (p.name == name) return &p;
+		return nullptr;
+	}
+};
+
+static int PLYTypeSize( const string& type )
+{
+	if (type == "char" || type == "uchar" || type == "int8" || type == "uint8") return 1;
+	if (type == "short" || type == "ushort" || type == "int16" || type == "uint16") return 2;
+	if (type == "int" || type == "uint" || type == "int32" || type == "uint32" || type == "float" || type == "float32") return 4;
+	if (type == "double" || type == "float64") return 8;
+	return 0;
+}
+
+static bool ReadBinaryPLY( const string& filename, vector<int>& indices, vector<Point3f>& vertices,
+	vector<Normal3f>& normals, vector<Point2f>& uvs, bool& failed )
+{
+	MappedFile file( filename.c_str() );
+	if (!file.IsOpen() || file.size < 4 || memcmp( file.data, "ply", 3 )) return false;
+	const char* text = (const char*)file.data, * end = text + file.size;
+	// parse the header
+	const char token[] = "end_header";
+	const char* headerEnd = search( text, end, token, token + sizeof( token ) - 1 );
+	if (headerEnd == end) return false;
+	const char* data = headerEnd + sizeof( token ) - 1;
+	if (data < end && *data == '\r') data++;
+	if (data >= end || *data++ != '\n') return false;
+	istringstream header( string( text, headerEnd ) );
+	string line, format;
+	vector<PLYElement> elements;
+	while (getline( header, line ))
+	{
+		istringstream words( line );
+		string keyword, type;
+		words >> keyword;
+		if (keyword == "format") words >> format;
+		else if (keyword == "element")
+		{
+			elements.push_back( PLYElement() );
+			words >> elements.back().name >> elements.back().count;
+		}
+		else if (keyword == "property")
+		{
+			if (elements.size() == 0) return false;
+			PLYElement& element = elements.back();
+			PLYProperty property;
+			words >> type;
+			if (type == "list")
+			{
+				string countType, itemType;
+				words >> countType >> itemType;
+				property.isList = true;
+				property.countSize = PLYTypeSize( countType );
+				property.itemSize = PLYTypeSize( itemType );
+			}
+			else
+			{
+				property.size = PLYTypeSize( type );
+				property.isFloat = type == "float" || type == "float32";
+				property.offset = element.stride;
+				element.stride += property.size;
+			}
+			words >> property.name;
+			if (property.size == 0 && property.countSize == 0) return false;
+			element.properties.push_back( property );
+		}
+	}
+	// check the layout
+	if (format != "binary_little_endian" || elements.size() < 2) return false;
+	const PLYElement& vertexElement = elements[0], & faceElement = elements[1];
+	if (vertexElement.name != "vertex" || faceElement.name != "face") return false;
+	for (const PLYProperty& p : vertexElement.properties) if (p.isList) return false;
+	if (faceElement.properties.size() != 1) return false;
+	const PLYProperty& faceIndices = faceElement.properties[0];
+	if (faceIndices.name != "vertex_indices" || faceIndices.countSize != 1 || faceIndices.itemSize != 4) return false;
+	// find the vertex attributes; there seem to be lots of different conventions regarding uv names
+	const PLYProperty* P[3] = { vertexElement.Find( "x" ), vertexElement.Find( "y" ), vertexElement.Find( "z" ) };
+	const PLYProperty* N[3] = { vertexElement.Find( "nx" ), vertexElement.Find( "ny" ), vertexElement.Find( "nz" ) };
+	const PLYProperty* UV[2] = { nullptr, nullptr };
+	const char* uvNames[4][2] = { { "u", "v" }, { "s", "t" }, { "texture_u", "texture_v" }, { "texture_s", "texture_t" } };
+	for (int i = 0; i < 4 && !UV[0]; i++)
+	{
+		UV[0] = vertexElement.Find( uvNames[i][0] ), UV[1] = vertexElement.Find( uvNames[i][1] );
+		if (!UV[0] || !UV[1]) UV[0] = UV[1] = nullptr;
+	}
+	const bool hasN = N[0] && N[1] && N[2], hasUV = UV[0] != nullptr;
+	for (int i = 0; i < 3; i++) if (!P[i] || !P[i]->isFloat || (hasN && !N[i]->isFloat)) return false;
+	if (hasUV && (!UV[0]->isFloat || !UV[1]->isFloat)) return false;
+	// from here on, the file is ours
+	failed = true;
+	const long vertexCount = vertexElement.count, faceCount = faceElement.count;
+	if (vertexCount <= 0 || faceCount <= 0)
+	{
+		Error( "%s: PLY file is invalid! No face/vertex elements found!", filename.c_str() );
+		return true;
+	}
+	const size_t stride = vertexElement.stride;
+	if ((size_t)(end - data) < vertexCount * stride)
+	{
+		Error( "%s: unable to read the contents of PLY file", filename.c_str() );
+		return true;
+	}
+	// vertex block: fixed stride, so it is converted in parallel
+	vertices.resize( vertexCount );
+	if (hasN) normals.resize( vertexCount );
+	if (hasUV) uvs.resize( vertexCount );
+	ParallelBatches( (int)vertexCount, 65536, [&]( const int first, const int last ) {
+		for (int i = first; i < last; i++)
+		{
+			const char* v = data + i * stride;
+			memcpy( &vertices[i].x, v + P[0]->offset, 4 );
+			memcpy( &vertices[i].y, v + P[1]->offset, 4 );
+			memcpy( &vertices[i].z, v + P[2]->offset, 4 );
+			if (hasN)
+			{
+				memcpy( &normals[i].x, v + N[0]->offset, 4 );
+				memcpy( &normals[i].y, v + N[1]->offset, 4 );
+				memcpy( &normals[i].z, v + N[2]->offset, 4 );
+			}
+			if (hasUV)
+			{
+				memcpy( &uvs[i].x, v + UV[0]->offset, 4 );
+				memcpy( &uvs[i].y, v + UV[1]->offset, 4 );
+			}
+		}
+	} );
+	// face block: variable size, read sequentially; quads are split in two triangles
+	const char* f = data + vertexCount * stride;
+	indices.reserve( faceCount * 3 );
+	int skipped = 0;
+	for (long i = 0; i < faceCount; i++)
+	{
+		const int length = f < end ? (uchar)*f : 0;
+		if (end - f < 1 + 4 * length)
+		{
+			Error( "%s: unable to read the contents of PLY file", filename.c_str() );
+			return true;
+		}
+		int face[4];
+		if (length == 3 || length == 4)
+		{
+			memcpy( face, f + 1, 4 * length );
+			for (int j = 0; j < length; j++) if (face[j] < 0 || face[j] >= vertexCount)
+			{
+				Error( "plymesh: Vertex reference %i is out of bounds! Valid range is [0..%i)", face[j], (int)vertexCount );
+				return true;
+			}
+			indices.insert( indices.end(), face, face + 3 );
+			if (length == 4) indices.insert( indices.end(), { face[3], face[0], face[2] } );
+		}
+		else skipped++;
+		f += 1 + 4 * length;
+	}
+	if (skipped > 0) Warning( "plymesh: Ignoring %i faces that are not triangles or quads", skipped );
+	failed = false;
+	return true;
+}
+
+/* Reads any PLY file, using the callbacks of RPly. */
+static bool ReadPLYWithRPly( const string& filename, vector<int>& indices, vector<Point3f>& vertices,
+	vector<Normal3f>& normals, vector<Point2f>& uvs )
 {
-	const string filename = params.FindOneFilename( "filename", "" );
 	p_ply ply = ply_open( filename.c_str(), rply_message_callback, 0, nullptr );
 	if (!ply)
 	{
 		Error( "Couldn't open PLY file \"%s\"", filename.c_str() );
-		return nullptr;
+		return false;
 	}
 	if (!ply_read_header( ply ))
 	{
 		Error( "Unable to read the header of PLY file \"%s\"", filename.c_str() );
-		return nullptr;
+		return false;
 	}
 
 	p_ply_element element = nullptr;
@@ -215,7 +395,7 @@ HostMesh* CreatePLYMesh(
 	if (vertexCount == 0 || faceCount == 0)
 	{
 		Error( "%s: PLY file is invalid! No face/vertex elements found!", filename.c_str() );
-		return nullptr;
+		return false;
 	}
 
 	CallbackContext context;
@@ -229,7 +409,7 @@ HostMesh* CreatePLYMesh(
 	else
 	{
 		Error( "%s: Vertex coordinate property not found!", filename.c_str() );
-		return nullptr;
+		return false;
 	}
 
 	if (ply_set_read_cb( ply, "vertex", "nx", rply_vertex_callback, &context, 0x130 ) &&
@@ -260,10 +440,55 @@ HostMesh* CreatePLYMesh(
 	{
 		Error( "%s: unable to read the contents of PLY file", filename.c_str() );
 		ply_close( ply );
-		return nullptr;
+		return false;
 	}
 	ply_close( ply );
-	if (context.error) return nullptr;
+	if (context.error) return false;
+	indices.assign( context.indices, context.indices + context.indexCtr );
+	vertices.assign( context.p, context.p + vertexCount );
+	if (context.n) normals.assign( context.n, context.n + vertexCount );
+	if (context.uv) uvs.assign( context.uv, context.uv + vertexCount );
+	return true;
+}
+
+// hands the arrays of a shape to the mesh builder. Without a target mesh, a new mesh is
+// made in object space. Shapes of an object definition are merged into one target mesh;
+// their vertices are then transformed to the space of the object first.
+static HostMesh* BuildShapeMesh( HostMesh* target, const Transform* o2w, vector<int>& indices,
+	vector<Point3f>& vertices, vector<Normal3f>& normals, vector<Point2f>& uvs, const int materialIdx )
+{
+	if (target && o2w)
+	{
+		const Transform N = o2w->Inverted().Transposed();
+		for (Point3f& v : vertices) v = o2w->TransformPoint( v );
+		for (Normal3f& n : normals) n = normalize( N.TransformVector( n ) );
+	}
+	HostMesh* mesh = target ? target : new HostMesh;
+	const vector<HostMesh::Pose> noPose;
+	const vector<uint4> noJoints;
+	const vector<float4> noWeights;
+	vector<Point2f> uv2s /* second layer uvs not used for this type of mesh */;
+	vector<float4> dummyT;
+	mesh->BuildFromIndexedData( indices, vertices, normals, uvs, uv2s, dummyT, noPose, noJoints, noWeights, materialIdx );
+	return mesh;
+}
+
+HostMesh* CreatePLYMesh(
+	const Transform* o2w, const Transform* w2o, bool reverseOrientation, const ParamSet& params, 
+	const int materialIdx, map<string, HostMaterial::ScalarValue*>* floatTextures, HostMesh* target )
+{
+	const string filename = params.FindOneFilename( "filename", "" );
+	vector<int> indices;
+	vector<Point3f> vertices;
+	vector<Normal3f> normals;
+	vector<Point2f> uvs;
+	bool failed = false;
+	if (!ReadBinaryPLY( filename, indices, vertices, normals, uvs, failed ))
+	{
+		// not a layout we can read directly
+		if (!ReadPLYWithRPly( filename, indices, vertices, normals, uvs )) return nullptr;
+	}
+	else if (failed) return nullptr;
 
 #if 0
 	// Look up an alpha texture, if applicable
@@ -289,81 +514,66 @@ HostMesh* CreatePLYMesh(
 		shadowAlphaTex = new ConstantTexture<Float>( 0.f );
 #endif
 
-	auto mesh = new HostMesh;
-	const vector<HostMesh::Pose> noPose;
-	const vector<uint4> noJoints;
-	const vector<float4> noWeights;
-
-	vector<int> indices( context.indices, context.indices + context.indexCtr );
-	vector<Point3f> vertices( context.p, context.p + vertexCount );
-	vector<Normal3f> normals;
-	if (context.n) normals = { context.n, context.n + vertexCount };
-	vector<Point2f> uvs, uv2s /* second layer uvs not used for this type of mesh */;
-	if (context.uv) uvs = { context.uv, context.uv + vertexCount };
-	vector<float4> dummyT;
-	mesh->BuildFromIndexedData( indices, vertices, normals, uvs, uv2s, dummyT, noPose, noJoints, noWeights, materialIdx );
-
-	return mesh;
+	return BuildShapeMesh( target, o2w, indices, vertices, normals, uvs, materialIdx );
 }
 
 HostMesh* CreateTriangleMeshShape(
 	const Transform* o2w, const Transform* w2o, bool reverseOrientation,
-	const ParamSet& params, const int materialIdx,
-	std::map<std::string, HostMaterial::ScalarValue*>* floatTextures )
-{
-	int nvi, npi, nuvi, nsi, nni;
-	const int* vi = params.FindInt( "indices", &nvi );
-	const Point3f* P = params.FindPoint3f( "P", &npi );
-	const Point2f* uvs = params.FindPoint2f( "uv", &nuvi );
-	if (!uvs) uvs = params.FindPoint2f( "st", &nuvi );
-	std::vector<Point2f> tempUVs;
-	if (!uvs)
-	{
-		const Float* fuv = params.FindFloat( "uv", &nuvi );
-		if (!fuv) fuv = params.FindFloat( "st", &nuvi );
-		if (fuv)
+	ParamSet& params, const int materialIdx,
+	std::map<std::string, HostMaterial::ScalarValue*>* floatTextures, HostMesh* target )
+{
+	// the arrays are moved out of the parameter set and passed to the mesh builder as they are
+	std::vector<int> indices;
+	std::vector<Point3f> vertices;
+	std::vector<Normal3f> normals;
+	std::vector<Point2f> uvs;
+	const bool hasIndices = params.TakeInt( "indices", indices );
+	const bool hasP = params.TakePoint3f( "P", vertices );
+	if (!params.TakePoint2f( "uv", uvs ) && !params.TakePoint2f( "st", uvs ))
+	{
+		std::vector<Float> fuv;
+		if (params.TakeFloat( "uv", fuv ) || params.TakeFloat( "st", fuv ))
 		{
-			nuvi /= 2;
-			tempUVs.reserve( nuvi );
-			for (int i = 0; i < nuvi; ++i) tempUVs.push_back( { fuv[2 * i], fuv[2 * i + 1] } );
-			uvs = tempUVs.data();
+			uvs.resize( fuv.size() / 2 );
+			for (size_t i = 0; i < uvs.size(); ++i) uvs[i] = { fuv[2 * i], fuv[2 * i + 1] };
 		}
 	}
-	if (uvs)
+	const int nvi = (int)indices.size(), npi = (int)vertices.size(), nuvi = (int)uvs.size();
+	if (nuvi > 0)
 	{
 		if (nuvi < npi)
 		{
 			Error( "Not enough of \"uv\"s for triangle mesh. Expected %d, found %d. Discarding.", npi, nuvi );
-			uvs = nullptr;
+			uvs.clear();
 		}
 		else if (nuvi > npi)
 			Warning( "More \"uv\"s provided than will be used for triangle mesh. (%d expcted, %d found)", npi, nuvi );
 	}
-	if (!vi)
+	if (!hasIndices)
 	{
 		Error( "Vertex indices \"indices\" not provided with triangle mesh shape" );
 		return nullptr;
 	}
-	if (!P)
+	if (!hasP)
 	{
 		Error( "Vertex positions \"P\" not provided with triangle mesh shape" );
 		return nullptr;
 	}
+	int nsi;
 	const Vector3f* S = params.FindVector3f( "S", &nsi );
 	if (S && nsi != npi)
 	{
 		Error( "Number of \"S\"s for triangle mesh must match \"P\"s" );
 		S = nullptr;
 	}
-	const Normal3f* N = params.FindNormal3f( "N", &nni );
-	if (N && nni != npi)
+	if (params.TakeNormal3f( "N", normals ) && normals.size() != vertices.size())
 	{
 		Error( "Number of \"N\"s for triangle mesh must match \"P\"s" );
-		N = nullptr;
+		normals.clear();
 	}
-	for (int i = 0; i < nvi; ++i) if (vi[i] >= npi)
+	for (int i = 0; i < nvi; ++i) if (indices[i] >= npi)
 	{
-		Error( "trianglemesh has out of-bounds vertex index %d (%d \"P\" values were given", vi[i], npi );
+		Error( "trianglemesh has out of-bounds vertex index %d (%d \"P\" values were given", indices[i], npi );
 		return nullptr;
 	}
 
@@ -403,21 +613,7 @@ HostMesh* CreateTriangleMeshShape(
 	if (faceIndices) Warning( "faceIndices specified, but not used!" );
 	if (S) Warning( "S specified, but not used!" );
 
-	auto mesh = new HostMesh;
-	const std::vector<HostMesh::Pose> noPose;
-	const std::vector<uint4> noJoints;
-	const std::vector<float4> noWeights;
-	const std::vector<int> indices( vi, vi + nvi );
-	const std::vector<Point3f> vertices( P, P + npi );
-
-	// Optional normals and uvs:
-	std::vector<Normal3f> normals;
-	if (N) normals = { N, N + nni };
-	std::vector<Point2f> uvs_vec, uv2s /* second layer uvs not used for this type of mesh */;
-	if (uvs) uvs_vec = { uvs, uvs + nuvi };
-	vector<float4> dummyT;
-	mesh->BuildFromIndexedData( indices, vertices, normals, uvs_vec, uv2s, dummyT, noPose, noJoints, noWeights, materialIdx );
-	return mesh;
+	return BuildShapeMesh( target, o2w, indices, vertices, normals, uvs, materialIdx );
 }
 
 } // namespace pbrt
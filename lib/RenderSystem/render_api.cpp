@@ -18,17 +18,12 @@
 
 #include "rendersystem.h"
 
-static RenderSystem* renderer = nullptr;
-static RenderAPI api;
-
 RenderAPI* RenderAPI::CreateRenderAPI( const char* dllName )
 {
-	if (!renderer)
-	{
-		renderer = new RenderSystem();
-		renderer->Init( dllName );
-	}
-	return &api;
+	RenderAPI* api = new RenderAPI();
+	api->renderer = new RenderSystem();
+	api->renderer->Init( dllName );
+	return api;
 }
 
 void RenderAPI::SerializeMaterials( const char* xmlFile )
@@ -41,9 +36,23 @@ void RenderAPI::DeserializeMaterials( const char* xmlFile )
 	renderer->scene->DeserializeMaterials( xmlFile );
 }
 
+bool RenderAPI::LoadSceneCache( const char* cacheFile )
+{
+	return renderer->scene->LoadCache( cacheFile );
+}
+
+void RenderAPI::SaveSceneCache( const char* cacheFile )
+{
+	renderer->scene->SaveCache( cacheFile );
+}
+
 void RenderAPI::Shutdown()
 {
 	renderer->Shutdown();
+	delete renderer;
+	renderer = nullptr;
+	// the interface was allocated by CreateRenderAPI
+	delete this;
 }
 
 void RenderAPI::DeserializeCamera( const char* xmlFile )
@@ -86,6 +95,21 @@ int RenderAPI::AddScene( const char* file, const mat4& transform )
 	return renderer->scene->AddScene( file, transform );
 }
 
+int RenderAPI::AddSceneAsync( const char* file, const mat4& transform )
+{
+	return renderer->scene->AddSceneAsync( file, transform );
+}
+
+int RenderAPI::GetSceneLoadResult( const int loadId )
+{
+	return renderer->scene->SceneLoadResult( loadId );
+}
+
+void RenderAPI::WaitForSceneLoads()
+{
+	renderer->scene->CommitSceneLoads( true );
+}
+
 int RenderAPI::AddQuad( const float3 N, const float3 pos, const float width, const float height, const int material, const int meshID )
 {
 	return renderer->scene->AddQuad( N, pos, width, height, material, meshID );
@@ -101,6 +125,21 @@ void RenderAPI::RemoveNode( const int nodeId )
 	return renderer->scene->RemoveNode( nodeId );
 }
 
+bool RenderAPI::RemoveNode( const NodeHandle& handle )
+{
+	return renderer->scene->RemoveNode( handle );
+}
+
+NodeHandle RenderAPI::GetNodeHandle( const int nodeId )
+{
+	return renderer->scene->GetNodeHandle( nodeId );
+}
+
+bool RenderAPI::IsValidNode( const NodeHandle& handle )
+{
+	return renderer->scene->GetNode( handle ) != 0;
+}
+
 void RenderAPI::SetNodeTransform( const int nodeId, const mat4& transform )
 {
 	renderer->scene->SetNodeTransform( nodeId, transform );
@@ -136,6 +175,11 @@ void RenderAPI::Render( Convergence converge, bool async )
 	renderer->Render( renderer->scene->camera->GetView(), converge, async );
 }
 
+void RenderAPI::RenderViews( const ViewPyramid* views, GLTexture* const* targets, const int viewCount, const uint spp, Convergence converge )
+{
+	renderer->RenderViews( views, targets, viewCount, spp, converge );
+}
+
 void RenderAPI::WaitForRender()
 {
 	renderer->WaitForRender();
@@ -25,14 +25,19 @@ namespace lighthouse2
 //  |  Interface between the RenderSystem and the application.              LH2'19|
 //  +-----------------------------------------------------------------------------+
 struct RenderSettings;
+class RenderSystem;
 class RenderAPI
 {
 public:
 	// CreateRenderAPI: instantiate and initialize a RenderSystem object and obtain an interface to it.
+	// Each call creates an independent RenderSystem, with its own scene and core. The object
+	// is owned by the application until Shutdown, which destroys it; don't use it afterwards.
 	static RenderAPI* CreateRenderAPI( const char* dllName );
 	// Methods
 	void SerializeMaterials( const char* xmlFile );
 	void DeserializeMaterials( const char* xmlFile );
+	bool LoadSceneCache( const char* cacheFile );
+	void SaveSceneCache( const char* cacheFile );
 	void Shutdown();
 	void DeserializeCamera( const char* camera );
 	void SerializeCamera( const char* camera );
@@ -40,11 +45,17 @@ public:
 	int AddMesh( const char* file, const float scale = 1.0f, const bool flatShaded = false );
 	int AddScene( const char* file, const char* dir, const mat4& transform = mat4::Identity() );
 	int AddScene( const char* file, const mat4& transform = mat4::Identity() );
+	int AddSceneAsync( const char* file, const mat4& transform = mat4::Identity() );
+	int GetSceneLoadResult( const int loadId );
+	void WaitForSceneLoads();
 	int AddMesh( const int triCount );
 	void AddTriToMesh( const int meshId, const float3& v0, const float3& v1, const float3& v2, const int matId );
 	int AddQuad( const float3 N, const float3 pos, const float width, const float height, const int material, const int meshID = -1 );
 	int AddInstance( const int meshId, const mat4& transform = mat4() );
 	void RemoveNode( const int nodeId );
+	bool RemoveNode( const NodeHandle& handle );
+	NodeHandle GetNodeHandle( const int nodeId );
+	bool IsValidNode( const NodeHandle& handle );
 	void SetNodeTransform( const int nodeId, const mat4& transform );
 	const mat4& GetNodeTransform( const int nodeId );
 	void ResetAnimation( const int animId );
@@ -52,6 +63,7 @@ public:
 	int AnimationCount();
 	void SynchronizeSceneData();
 	void Render( Convergence converge, bool async = false );
+	void RenderViews( const ViewPyramid* views, GLTexture* const* targets, const int viewCount, const uint spp, Convergence converge = Restart );
 	void WaitForRender();
 	Camera* GetCamera();
 	RenderSettings* GetSettings();
@@ -73,6 +85,10 @@ public:
 	void SetProbePos( const int2 pos );
 	CoreStats GetCoreStats() const;
 	SystemStats GetSystemStats();
+private:
+	RenderAPI() = default;				// use CreateRenderAPI
+	~RenderAPI() = default;				// use Shutdown
+	RenderSystem* renderer = nullptr;	// the RenderSystem behind this interface
 };
 
 } // namespace lighthouse2
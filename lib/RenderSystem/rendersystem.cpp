@@ -15,6 +15,17 @@
 
 #include "rendersystem.h"
 
+//  +-----------------------------------------------------------------------------+
+//  |  HostTaskExecutor                                                           |
+//  |  Worker pool shared by the host-side data processing code. Created on       |
+//  |  first use; one thread per hardware thread.                           LH2'21|
+//  +-----------------------------------------------------------------------------+
+tf::Executor& lighthouse2::HostTaskExecutor()
+{
+	static tf::Executor executor;
+	return executor;
+}
+
 //  +-----------------------------------------------------------------------------+
 //  |  RenderSystem::Init                                                         |
 //  |  Initialize the rendering system.                                     LH2'19|
@@ -23,6 +34,7 @@ void RenderSystem::Init( const char* dllName )
 {
 	// create core
 	core = CoreAPI_Base::CreateCoreAPI( dllName );
+	snapshot.Bind( core );
 	// create scene - load a scene using tinyobjloader
 	scene = new HostScene();
 	scene->Init();
@@ -35,6 +47,7 @@ void RenderSystem::Init( const char* dllName )
 void RenderSystem::SetTarget( GLTexture* target, const uint spp )
 {
 	// forward to core
+	if (renderInFlight) WaitForRender();
 	core->SetTarget( target, spp );
 	// update camera aspect ratio
 	scene->camera->aspectRatio = (float)target->width / (float)target->height;
@@ -53,14 +66,16 @@ void RenderSystem::SynchronizeSky()
 	{
 		// send sky data to core
 		HostSkyDome* sky = scene->sky;
-		core->SetSkyData( sky->pixels, sky->width, sky->height, sky->worldToLight );
+		Target()->SetSkyData( sky->pixels, sky->width, sky->height, sky->worldToLight );
 	}
 }
 
 //  +-----------------------------------------------------------------------------+
 //  |  RenderSystem::SynchronizeTextures                                          |
 //  |  Detect changes to the textures. TODO: currently, the system always sends   |
-//  |  all textures to the core whenever any of them changes.               LH2'19|
+//  |  all textures to the core whenever any of them changes. Released texels     |
+//  |  are therefore reloaded before the transfer, and released again after it.   |
+//  |                                                                       LH2'19|
 //  +-----------------------------------------------------------------------------+
 void RenderSystem::SynchronizeTextures()
 {
@@ -68,10 +83,16 @@ void RenderSystem::SynchronizeTextures()
 	for (auto texture : scene->textures) if (texture->Changed()) texturesDirty = true;
 	if (texturesDirty)
 	{
+		// texel data is not recorded; let an asynchronous render complete first
+		if (renderInFlight) WaitForRender();
 		// send texture data to core
-		vector<CoreTexDesc> gpuTex;
-		for (auto texture : scene->textures) gpuTex.push_back( texture->ConvertToCoreTexDesc() );
-		core->SetTextures( gpuTex.data(), (int)gpuTex.size() );
+		const int textureCount = (int)scene->textures.size();
+		CoreTexDesc* gpuTex = frameArena.Alloc<CoreTexDesc>( textureCount );
+		for (int i = 0; i < textureCount; i++) scene->textures[i]->RestoreTexels();
+		for (int i = 0; i < textureCount; i++) gpuTex[i] = scene->textures[i]->ConvertToCoreTexDesc();
+		core->SetTextures( gpuTex, textureCount );
+		// the core copied the texels; optionally drop the host copies
+		if (settings.releaseHostData) for (auto texture : scene->textures) texture->ReleaseTexels();
 	}
 }
 
@@ -86,14 +107,24 @@ void RenderSystem::SynchronizeMaterials()
 	for (auto material : scene->materials) if (material->Changed())
 	{
 		// send all material data to core
-		vector<CoreMaterial> gpuMaterial;
-		for (auto sceneMat : scene->materials)
+		const int materialCount = (int)scene->materials.size();
+		CoreMaterial* gpuMaterial = frameArena.Alloc<CoreMaterial>( materialCount );
+		for (int i = 0; i < materialCount; i++) memcpy( &gpuMaterial[i], scene->materials[i], sizeof( CoreMaterial ) );
+		Target()->SetMaterials( gpuMaterial, materialCount );
+		// let instances check if their light triangles are still valid, if the emission of a material changed
+		coreEmission.resize( materialCount, make_float3( 0 ) );
+		scene->emissionVersion.resize( materialCount, 0 );
+		bool emissionChanged = false;
+		for (int i = 0; i < materialCount; i++)
 		{
-			CoreMaterial m;
-			memcpy( &m, sceneMat, sizeof( CoreMaterial ) );
-			gpuMaterial.push_back( m );
+			HostMaterial* material = scene->materials[i];
+			const float3 emission = material->IsEmissive() ? material->color() : make_float3( 0 );
+			if (emission.x == coreEmission[i].x && emission.y == coreEmission[i].y && emission.z == coreEmission[i].z) continue;
+			coreEmission[i] = emission;
+			scene->emissionVersion[i] = scene->materialVersion + 1;
+			emissionChanged = true;
 		}
-		core->SetMaterials( gpuMaterial.data(), (int)gpuMaterial.size() );
+		if (emissionChanged) scene->materialVersion++;
 		// mark them all as 'clean' to prevent subsequent transfers
 		for (auto m : scene->materials) m->MarkAsNotDirty();
 		// halt further processing
@@ -116,7 +147,15 @@ void RenderSystem::SynchronizeMeshes()
 		if (mesh->Changed())
 		{
 			mesh->MarkAsNotDirty();
-			core->SetGeometry( modelIdx, mesh->vertices.data(), (int)mesh->vertices.size(), (int)mesh->triangles.size(), (CoreTri*)mesh->triangles.data() );
+			if (core->AcceptsIndexedGeometry() && mesh->HasIndexedGeometry())
+				Target()->SetGeometry( modelIdx, mesh->GetIndexedGeometry() );
+			else
+			{
+				mesh->RestoreHostData();
+				Target()->SetGeometry( modelIdx, mesh->vertices.data(), (int)mesh->vertices.size(), (int)mesh->triangles.size(), (CoreTri*)mesh->triangles.data() );
+			}
+			// the core copied the geometry; optionally drop the 'fat' host copy
+			if (settings.releaseHostData) mesh->ReleaseHostData();
 			meshesChanged = true; // trigger scene graph update
 		}
 	}
@@ -135,11 +174,23 @@ void RenderSystem::UpdateSceneGraph()
 	Timer timer;
 	int instanceCount = 0;
 	bool instancesChanged = false;
-	for (int nodeIdx : HostScene::rootNodes)
+	// prepare the animation LOD policy for this frame
+	AnimationLOD lod;
+	if (settings.animationLOD)
+	{
+		const Camera* camera = scene->camera;
+		lod.eye = camera->GetView().pos;
+		lod.pixelScale = camera->pixelCount.y / tanf( camera->FOV * 0.5f * PI / 180 );
+		lod.fullRateSize = settings.animationLODSize;
+		lod.maxInterval = max( 1, settings.animationLODMaxInterval );
+		lod.frame = frameCounter;
+	}
+	frameCounter++;
+	for (int nodeIdx : scene->rootNodes)
 	{
-		HostNode* node = HostScene::nodePool[nodeIdx];
+		HostNode* node = scene->nodePool[nodeIdx];
 		mat4 T;
-		instancesChanged |= node->Update( T /* start with an identity matrix */, instances, instanceCount );
+		instancesChanged |= node->Update( T /* start with an identity matrix */, instances, instanceCount, settings.animationLOD ? &lod : 0 );
 	}
 	stats.sceneUpdateTime = timer.elapsed();
 	// synchronize instances to device if anything changed
@@ -147,49 +198,82 @@ void RenderSystem::UpdateSceneGraph()
 	{
 		// resize vector (free if the size didn't change)
 		instances.resize( instanceCount );
-		// send instances to core
+		// send new, moved and modified instances to core
 		for (int instanceIdx = 0; instanceIdx < instanceCount; instanceIdx++)
 		{
-			HostNode* node = HostScene::nodePool[instances[instanceIdx]];
+			HostNode* node = scene->nodePool[instances[instanceIdx]];
+			const bool moved = node->instanceID != instanceIdx;
 			node->instanceID = instanceIdx;
-			int dummy = node->Changed(); // prevent superfluous update in the next frame
-			core->SetInstance( instanceIdx, node->meshID, node->combinedTransform );
+			const bool changed = node->Changed(); // also prevents superfluous update in the next frame
+			if (moved || changed || meshesChanged) Target()->SetInstance( instanceIdx, node->meshID, node->combinedTransform );
 		}
-		core->SetInstance( instanceCount, -1 );
+		Target()->SetInstance( instanceCount, -1 );
 		meshesChanged = false;
 	}
 	// allow the core to finalize after receiving all instances
-	core->FinalizeInstances();
+	Target()->FinalizeInstances();
 }
 
 //  +-----------------------------------------------------------------------------+
 //  |  RenderSystem::SynchronizeLights                                            |
-//  |  Detect changes to the lights. Note: light data is small, so we can safely  |
-//  |  send all data when something changes.                                LH2'19|
+//  |  Detect changes to the lights. If only some light triangles changed, e.g.   |
+//  |  because an emissive instance moved, just these are converted and sent to   |
+//  |  the core. Otherwise, all light data is sent.                         LH2'21|
 //  +-----------------------------------------------------------------------------+
 void RenderSystem::SynchronizeLights()
 {
 	bool lightsDirty = false;
-	for (auto light : scene->triLights) if (light->Changed()) lightsDirty = true;
 	for (auto light : scene->pointLights) if (light->Changed()) lightsDirty = true;
 	for (auto light : scene->spotLights) if (light->Changed()) lightsDirty = true;
 	for (auto light : scene->directionalLights) if (light->Changed()) lightsDirty = true;
+	// a partial update requires an unchanged light triangle list with unchanged enabled flags
+	const vector<HostTriLight*>& triLights = scene->triLights;
+	int* changedTriLights = frameArena.Alloc<int>( triLights.size() ), changedCount = 0;
+	if (triLights != sentTriLights) lightsDirty = true;
+	for (int s = (int)triLights.size(), i = 0; i < s; i++) if (triLights[i]->Changed())
+	{
+		changedTriLights[changedCount++] = i;
+		if (!lightsDirty && triLights[i]->enabled != (coreTriLightIdx[i] > -1)) lightsDirty = true;
+	}
 	if (lightsDirty)
 	{
 		// send lights to core
-		vector<CoreLightTri> gpuTriLights;
-		vector<CorePointLight> gpuPointLights;
-		vector<CoreSpotLight> gpuSpotLights;
-		vector<CoreDirectionalLight> gpuDirectionalLights;
-		for (auto light : scene->triLights) if (light->enabled) gpuTriLights.push_back( light->ConvertToCoreLightTri() );
-		for (auto light : scene->pointLights) if (light->enabled) gpuPointLights.push_back( light->ConvertToCorePointLight() );
-		for (auto light : scene->spotLights) if (light->enabled) gpuSpotLights.push_back( light->ConvertToCoreSpotLight() );
-		for (auto light : scene->directionalLights) if (light->enabled) gpuDirectionalLights.push_back( light->ConvertToCoreDirectionalLight() );
-		core->SetLights( gpuTriLights.data(), (int)gpuTriLights.size(),
-			gpuPointLights.data(), (int)gpuPointLights.size(),
-			gpuSpotLights.data(), (int)gpuSpotLights.size(),
-			gpuDirectionalLights.data(), (int)gpuDirectionalLights.size() );
+		coreTriLights.clear();
+		corePointLights.clear();
+		coreSpotLights.clear();
+		coreDirectionalLights.clear();
+		coreTriLightIdx.resize( triLights.size() );
+		for (int s = (int)triLights.size(), i = 0; i < s; i++)
+		{
+			coreTriLightIdx[i] = triLights[i]->enabled ? (int)coreTriLights.size() : -1;
+			if (triLights[i]->enabled) coreTriLights.push_back( triLights[i]->ConvertToCoreLightTri() );
+		}
+		for (auto light : scene->pointLights) if (light->enabled) corePointLights.push_back( light->ConvertToCorePointLight() );
+		for (auto light : scene->spotLights) if (light->enabled) coreSpotLights.push_back( light->ConvertToCoreSpotLight() );
+		for (auto light : scene->directionalLights) if (light->enabled) coreDirectionalLights.push_back( light->ConvertToCoreDirectionalLight() );
+		sentTriLights = triLights;
 	}
+	else if (changedCount > 0)
+	{
+		// convert the modified light triangles only
+		CoreLightTri* modified = frameArena.Alloc<CoreLightTri>( changedCount );
+		int* modifiedIdx = frameArena.Alloc<int>( changedCount );
+		int modifiedCount = 0;
+		for (int j = 0; j < changedCount; j++) if (coreTriLightIdx[changedTriLights[j]] > -1)
+		{
+			const int i = changedTriLights[j];
+			coreTriLights[coreTriLightIdx[i]] = triLights[i]->ConvertToCoreLightTri();
+			modified[modifiedCount] = coreTriLights[coreTriLightIdx[i]];
+			modifiedIdx[modifiedCount++] = coreTriLightIdx[i];
+		}
+		if (modifiedCount == 0) return;
+		if (Target()->UpdateTriLights( modified, modifiedIdx, modifiedCount )) return;
+	}
+	else return;
+	Target()->SetLights( coreTriLights.data(), (int)coreTriLights.size(),
+		corePointLights.data(), (int)corePointLights.size(),
+		coreSpotLights.data(), (int)coreSpotLights.size(),
+		coreDirectionalLights.data(), (int)coreDirectionalLights.size() );
 }
 
 //  +-----------------------------------------------------------------------------+
@@ -202,6 +286,8 @@ void RenderSystem::SynchronizeLights()
 //  +-----------------------------------------------------------------------------+
 void RenderSystem::SynchronizeSceneData()
 {
+	scene->CommitSceneLoads(); // scenes loaded by AddSceneAsync appear between frames
+	frameArena.Reset();
 	SynchronizeSky();
 	SynchronizeTextures();
 	SynchronizeMaterials();
@@ -216,23 +302,63 @@ void RenderSystem::SynchronizeSceneData()
 //  +-----------------------------------------------------------------------------+
 void RenderSystem::Render( const ViewPyramid& view, Convergence converge, bool async )
 {
-	// forward to core; core may ignore or accept a setting
+	// the previous frame must be complete; this also applies recorded scene updates
+	if (renderInFlight) WaitForRender();
+	ForwardSettings();
+	core->Render( view, converge, async );
+	renderInFlight = async;
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  RenderSystem::RenderViews                                                  |
+//  |  Produce one image for each of the supplied views, e.g. for stereo or for   |
+//  |  the six faces of a reflection probe. Scene data is synchronized once by    |
+//  |  the caller, so the host-side cost is paid once for all views.        LH2'21|
+//  +-----------------------------------------------------------------------------+
+void RenderSystem::RenderViews( const ViewPyramid* views, GLTexture* const* targets, const int viewCount, const uint spp, Convergence converge )
+{
+	if (viewCount < 1) return;
+	if (renderInFlight) WaitForRender();
+	ForwardSettings();
+	core->RenderViews( views, targets, viewCount, spp, converge );
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  RenderSystem::ForwardSettings                                              |
+//  |  Forward the render settings to the core; the core may ignore or accept a   |
+//  |  setting.                                                             LH2'21|
+//  +-----------------------------------------------------------------------------+
+void RenderSystem::ForwardSettings()
+{
 	core->Setting( "epsilon", settings.geometryEpsilon );
 	core->Setting( "clampValue", scene->camera->clampValue );
 	core->Setting( "clampDirect", settings.filterDirectClamp );
 	core->Setting( "clampIndirect", settings.filterIndirectClamp );
 	core->Setting( "filter", settings.filterEnabled );
 	core->Setting( "TAA", settings.TAAEnabled );
-	core->Render( view, converge, async );
 }
 
 //  +-----------------------------------------------------------------------------+
 //  |  RenderSystem::WaitForRender                                                |
-//  |  Wait for the asynchronous renderer to complete.                      LH2'20|
+//  |  Wait for the asynchronous renderer to complete. Scene updates that were    |
+//  |  recorded while it was rendering are sent to the core now.            LH2'20|
 //  +-----------------------------------------------------------------------------+
 void RenderSystem::WaitForRender()
 {
 	core->WaitForRender();
+	renderInFlight = false;
+	if (!snapshot.IsEmpty()) snapshot.Commit();
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  RenderSystem::Target                                                       |
+//  |  Receiver for scene updates: the core itself, or, while the core renders    |
+//  |  asynchronously, the snapshot that is applied once it is done. This lets    |
+//  |  the host prepare frame N+1 while frame N renders.                    LH2'21|
+//  +-----------------------------------------------------------------------------+
+CoreAPI_Base* RenderSystem::Target()
+{
+	return renderInFlight ? (CoreAPI_Base*)&snapshot : core;
 }
 
 //  +-----------------------------------------------------------------------------+
@@ -250,8 +376,9 @@ int RenderSystem::GetTriangleMaterial( const int coreInstId, const int coreTriId
 	if (nodeId > scene->nodePool.size()) return -1; // should not happen
 	int meshId = scene->nodePool[nodeId]->meshID; // get the id of the mesh referenced by the node
 	if (meshId == -1) return -1; // should not happen
-	if (coreTriId > scene->meshPool[meshId]->triangles.size()) return -1; // should not happen
-	return scene->meshPool[meshId]->triangles[coreTriId].material;
+	const HostMesh* mesh = scene->meshPool[meshId];
+	if (coreTriId > mesh->TriangleCount()) return -1; // should not happen
+	return mesh->MaterialOf( coreTriId );
 }
 
 //  +-----------------------------------------------------------------------------+
@@ -292,10 +419,146 @@ int RenderSystem::GetTriangleNode( const int coreInstId, const int coreTriId )
 //  +-----------------------------------------------------------------------------+
 void RenderSystem::Shutdown()
 {
+	if (renderInFlight) WaitForRender();
 	// delete scene
 	delete scene;
-	// shutdown core
-	core->Shutdown();
+	scene = nullptr;
+	// shutdown core; this allows the next RenderSystem to create a core of the same type
+	CoreAPI_Base::DestroyCoreAPI( core );
+	core = nullptr;
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  CoreSnapshot::Bind                                                         |
+//  |  Set the core that receives the recorded updates.                     LH2'21|
+//  +-----------------------------------------------------------------------------+
+void CoreSnapshot::Bind( CoreAPI_Base* target )
+{
+	core = target;
+	// a core that implements partial light updates accepts an empty one
+	partialLights = core->UpdateTriLights( 0, 0, 0 );
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  CoreSnapshot - recording                                                   |
+//  |  Later updates of the same data replace earlier ones; geometry is kept in   |
+//  |  the order in which meshes were first sent, which cores rely on for new     |
+//  |  meshes.                                                              LH2'21|
+//  +-----------------------------------------------------------------------------+
+void CoreSnapshot::SetSkyData( const float3* pixels, const uint width, const uint height, const mat4& worldToLight )
+{
+	skyPixels.assign( pixels, pixels + (size_t)width * height );
+	skyWidth = width, skyHeight = height, skyWorldToLight = worldToLight;
+	skyDirty = true, empty = false;
+}
+void CoreSnapshot::SetMaterials( CoreMaterial* mat, const int materialCount )
+{
+	materials.assign( mat, mat + materialCount );
+	materialsDirty = true, empty = false;
+}
+CoreSnapshot::Geometry& CoreSnapshot::GeometrySlot( const int meshIdx )
+{
+	int slot = 0;
+	while (slot < geometryCount && geometry[slot].meshIdx != meshIdx) slot++;
+	if (slot == geometryCount) if (geometryCount++ == (int)geometry.size()) geometry.push_back( Geometry() );
+	return geometry[slot];
+}
+void CoreSnapshot::SetGeometry( const int meshIdx, const float4* vertexData, const int vertexCount, const int triangleCount, const CoreTri* triangles )
+{
+	Geometry& g = GeometrySlot( meshIdx );
+	g.meshIdx = meshIdx, g.indexed = false;
+	g.vertices.assign( vertexData, vertexData + vertexCount );
+	g.triangles.assign( triangles, triangles + triangleCount );
+	empty = false;
+}
+void CoreSnapshot::SetGeometry( const int meshIdx, const CoreIndexedMesh& mesh )
+{
+	Geometry& g = GeometrySlot( meshIdx );
+	g.meshIdx = meshIdx, g.indexed = true;
+	g.vertexCount = mesh.vertexCount, g.triangleCount = mesh.triangleCount;
+	const size_t vertices = mesh.vertexCount, corners = (size_t)mesh.triangleCount * 3;
+	auto copy = []( auto& stream, const auto* data, const size_t count ) { if (data) stream.assign( data, data + count ); else stream.clear(); };
+	copy( g.positions, mesh.positions, vertices );
+	copy( g.normals, mesh.normals, vertices );
+	copy( g.uv0, mesh.uv0, vertices );
+	copy( g.uv1, mesh.uv1, vertices );
+	copy( g.alpha, mesh.alpha, vertices );
+	copy( g.indices, mesh.indices, corners );
+	copy( g.materials, mesh.materials, (size_t)mesh.triangleCount );
+	empty = false;
+}
+void CoreSnapshot::SetLights( const CoreLightTri* triLights, const int triLightCount,
+	const CorePointLight* pointLights, const int pointLightCount,
+	const CoreSpotLight* spotLights, const int spotLightCount,
+	const CoreDirectionalLight* directionalLights, const int directionalLightCount )
+{
+	triLightData.assign( triLights, triLights + triLightCount );
+	pointLightData.assign( pointLights, pointLights + pointLightCount );
+	spotLightData.assign( spotLights, spotLights + spotLightCount );
+	directionalLightData.assign( directionalLights, directionalLights + directionalLightCount );
+	// a full update supersedes earlier partial updates
+	modifiedTriLights.clear();
+	modifiedTriLightIdx.clear();
+	lightsDirty = true, empty = false;
+}
+bool CoreSnapshot::UpdateTriLights( const CoreLightTri* triLights, const int* triLightIdx, const int count )
+{
+	if (lightsDirty)
+	{
+		// patch the recorded full update
+		for (int i = 0; i < count; i++) triLightData[triLightIdx[i]] = triLights[i];
+		return true;
+	}
+	if (!partialLights) return false; // the RenderSystem will record a full update instead
+	modifiedTriLights.insert( modifiedTriLights.end(), triLights, triLights + count );
+	modifiedTriLightIdx.insert( modifiedTriLightIdx.end(), triLightIdx, triLightIdx + count );
+	empty = false;
+	return true;
+}
+void CoreSnapshot::SetInstance( const int instanceIdx, const int modelIdx, const mat4& transform )
+{
+	instances.push_back( { instanceIdx, modelIdx, transform } );
+	empty = false;
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  CoreSnapshot::Commit                                                       |
+//  |  Send the recorded updates to the core, in the order used by the            |
+//  |  RenderSystem, and clear the snapshot. Buffers are kept for reuse.    LH2'21|
+//  +-----------------------------------------------------------------------------+
+void CoreSnapshot::Commit()
+{
+	if (skyDirty) core->SetSkyData( skyPixels.data(), skyWidth, skyHeight, skyWorldToLight );
+	if (materialsDirty) core->SetMaterials( materials.data(), (int)materials.size() );
+	for (int i = 0; i < geometryCount; i++)
+	{
+		const Geometry& g = geometry[i];
+		if (g.indexed)
+		{
+			auto data = []( const auto& stream ) { return stream.size() > 0 ? stream.data() : nullptr; };
+			CoreIndexedMesh mesh;
+			mesh.positions = data( g.positions ), mesh.normals = data( g.normals );
+			mesh.uv0 = data( g.uv0 ), mesh.uv1 = data( g.uv1 ), mesh.alpha = data( g.alpha );
+			mesh.indices = data( g.indices ), mesh.materials = data( g.materials );
+			mesh.vertexCount = g.vertexCount, mesh.triangleCount = g.triangleCount;
+			core->SetGeometry( g.meshIdx, mesh );
+		}
+		else core->SetGeometry( g.meshIdx, g.vertices.data(), (int)g.vertices.size(), (int)g.triangles.size(), g.triangles.data() );
+	}
+	if (lightsDirty) core->SetLights( triLightData.data(), (int)triLightData.size(),
+		pointLightData.data(), (int)pointLightData.size(),
+		spotLightData.data(), (int)spotLightData.size(),
+		directionalLightData.data(), (int)directionalLightData.size() );
+	if (modifiedTriLights.size() > 0) core->UpdateTriLights( modifiedTriLights.data(), modifiedTriLightIdx.data(), (int)modifiedTriLights.size() );
+	for (const Instance& instance : instances) core->SetInstance( instance.instanceIdx, instance.modelIdx, instance.transform );
+	if (finalizeInstances) core->FinalizeInstances();
+	// clear for the next frame
+	skyDirty = materialsDirty = lightsDirty = finalizeInstances = false;
+	geometryCount = 0;
+	modifiedTriLights.clear();
+	modifiedTriLightIdx.clear();
+	instances.clear();
+	empty = true;
 }
 
-// EOF
\ No newline at end of file
+// EOF
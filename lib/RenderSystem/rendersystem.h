@@ -23,6 +23,7 @@
 #include "tiny_obj_loader.h"
 #include "tinyxml2.h"
 #include "FreeImage.h"
+#include "taskflow.hpp"
 typedef tinygltf::AnimationSampler tinygltfAnimationSampler;
 typedef tinygltf::AnimationChannel tinygltfAnimationChannel;
 typedef tinygltf::Animation tinygltfAnimation;
@@ -54,6 +55,9 @@ typedef int tinyobjMaterial;
 #include "host_node.h"
 #include "core_api_base.h"
 #include "render_api.h"
+#ifdef RENDERSYSTEMBUILD
+#include "host_objparser.h"
+#endif
 
 #ifdef RENDERSYSTEMBUILD
 using namespace tinyxml2;
@@ -62,6 +66,28 @@ using namespace tinyxml2;
 namespace lighthouse2
 {
 
+#ifdef RENDERSYSTEMBUILD
+// shared worker pool for parallel host-side work (skinning, morphing, ...)
+tf::Executor& HostTaskExecutor();
+// true on the threads of the worker pool; tasks set it. A task must not wait for other tasks,
+// as all workers could end up waiting, so nested parallel work runs on the worker itself.
+inline bool& InsideHostTask() { static thread_local bool inside = false; return inside; }
+// process [0,count) in batches on the worker pool; small workloads are processed on the calling thread
+template <class F> void ParallelBatches( const int count, const int batchSize, F func )
+{
+	if (count <= batchSize || InsideHostTask()) { func( 0, count ); return; }
+	tf::Taskflow taskflow;
+	for (int first = 0; first < count; first += batchSize)
+	{
+		const int last = min( first + batchSize, count );
+		taskflow.emplace( [&func, first, last]() { InsideHostTask() = true; func( first, last ); } );
+	}
+	HostTaskExecutor().run( taskflow ).wait();
+}
+// size and modification time of a file, combined into a single value; zero if unavailable
+uint64_t SourceStamp( const string& fileName );
+#endif
+
 struct RenderSettings
 {
 	float geometryEpsilon = 1.0e-3f;
@@ -69,6 +95,89 @@ struct RenderSettings
 	float filterIndirectClamp = 2.5f;
 	uint filterEnabled = 1;
 	uint TAAEnabled = 1;
+	uint animationLOD = 0;				// animate meshes that are small on screen at a reduced rate
+	float animationLODSize = 64.0f;		// meshes with a larger projected size (in pixels) animate every frame
+	int animationLODMaxInterval = 8;	// maximum number of frames between two animation updates
+	uint releaseHostData = 0;			// free host copies of static geometry and texels once the core has them
+};
+
+//  +-----------------------------------------------------------------------------+
+//  |  CoreSnapshot                                                               |
+//  |  Records the scene updates that the RenderSystem sends while the core is    |
+//  |  still rendering the previous frame asynchronously. The core keeps using    |
+//  |  its own copy of the scene (the front buffer) until the render completes;   |
+//  |  the snapshot (the back buffer) is then applied in one go. All data is      |
+//  |  copied, as the scene may reallocate its arrays before the commit.          |
+//  |  Textures are never recorded: the RenderSystem finishes the render before   |
+//  |  sending these.                                                       LH2'21|
+//  +-----------------------------------------------------------------------------+
+class CoreSnapshot : public CoreAPI_Base
+{
+public:
+	void Bind( CoreAPI_Base* target );
+	bool IsEmpty() const { return empty; }
+	void Commit();
+	// recorded calls
+	void SetSkyData( const float3* pixels, const uint width, const uint height, const mat4& worldToLight ) override;
+	void SetMaterials( CoreMaterial* mat, const int materialCount ) override;
+	void SetGeometry( const int meshIdx, const float4* vertexData, const int vertexCount, const int triangleCount, const CoreTri* triangles ) override;
+	void SetGeometry( const int meshIdx, const CoreIndexedMesh& mesh ) override;
+	bool AcceptsIndexedGeometry() const override { return core->AcceptsIndexedGeometry(); }
+	void SetLights( const CoreLightTri* triLights, const int triLightCount,
+		const CorePointLight* pointLights, const int pointLightCount,
+		const CoreSpotLight* spotLights, const int spotLightCount,
+		const CoreDirectionalLight* directionalLights, const int directionalLightCount ) override;
+	bool UpdateTriLights( const CoreLightTri* triLights, const int* triLightIdx, const int count ) override;
+	void SetInstance( const int instanceIdx, const int modelIdx, const mat4& transform = mat4::Identity() ) override;
+	void FinalizeInstances() override { finalizeInstances = true, empty = false; }
+	// not recorded; the RenderSystem calls these on the core directly
+	CoreStats GetCoreStats() const override { return core->GetCoreStats(); }
+	void Init() override {}
+	void SetProbePos( const int2 pos ) override {}
+	void SetTarget( GLTexture* target, const uint spp ) override {}
+	void Setting( const char* name, float value ) override {}
+	void Render( const ViewPyramid& view, const Convergence converge, bool async ) override {}
+	void WaitForRender() override {}
+	void Shutdown() override {}
+	void SetTextures( const CoreTexDesc* tex, const int textureCount ) override { FATALERROR( "Textures cannot be recorded" ); }
+private:
+	struct Geometry
+	{
+		int meshIdx;
+		bool indexed;
+		int vertexCount, triangleCount;			// indexed: counts of the mesh
+		vector<float4> positions;				// indexed: copies of the streams; empty if absent
+		vector<float3> normals;
+		vector<float2> uv0, uv1;
+		vector<float> alpha;
+		vector<uint> indices;
+		vector<int> materials;
+		vector<float4> vertices;				// 'fat' layout: copy of the vertices
+		vector<CoreTri> triangles;				// 'fat' layout: copy of the triangles
+	};
+	struct Instance { int instanceIdx, modelIdx; mat4 transform; };
+	Geometry& GeometrySlot( const int meshIdx );
+	CoreAPI_Base* core = nullptr;				// the core that receives the recorded data on commit
+	bool empty = true;							// nothing recorded since the last commit
+	bool partialLights = false;					// the core accepts UpdateTriLights
+	// recorded data; buffers are reused between frames
+	bool skyDirty = false;
+	vector<float3> skyPixels;
+	uint skyWidth = 0, skyHeight = 0;
+	mat4 skyWorldToLight;
+	bool materialsDirty = false;
+	vector<CoreMaterial> materials;
+	vector<Geometry> geometry;
+	int geometryCount = 0;
+	bool lightsDirty = false;
+	vector<CoreLightTri> triLightData;
+	vector<CorePointLight> pointLightData;
+	vector<CoreSpotLight> spotLightData;
+	vector<CoreDirectionalLight> directionalLightData;
+	vector<CoreLightTri> modifiedTriLights;		// partial light updates after the last full update
+	vector<int> modifiedTriLightIdx;
+	vector<Instance> instances;
+	bool finalizeInstances = false;
 };
 
 //  +-----------------------------------------------------------------------------+
@@ -82,6 +191,7 @@ public:
 	void Init( const char* dllName );
 	void SynchronizeSceneData();
 	void Render( const ViewPyramid& view, Convergence converge, bool async = false );
+	void RenderViews( const ViewPyramid* views, GLTexture* const* targets, const int viewCount, const uint spp, Convergence converge );
 	void WaitForRender();
 	void SetTarget( GLTexture* target, const uint spp );
 	void SetProbePos( int2 pos ) { if (core) core->SetProbePos( pos ); }
@@ -94,12 +204,14 @@ public:
 	SystemStats GetSystemStats() { return stats; }
 private:
 	// private methods
+	void ForwardSettings();
 	void SynchronizeSky();
 	void SynchronizeTextures();
 	void SynchronizeMaterials();
 	void SynchronizeMeshes();
 	void SynchronizeLights();
 	void UpdateSceneGraph();
+	CoreAPI_Base* Target();
 private:
 	// private data members
 	CoreAPI_Base* core = nullptr;			// low-level rendering functionality
@@ -107,6 +219,17 @@ private:
 	bool meshesChanged = false;				// rebuild scene graph if a mesh was rebuilt / refit
 	SystemStats stats;						// performance counters
 	vector<int> instances;					// node indices that have been sent to the core as instances
+	uint frameCounter = 0;					// frame counter for the animation LOD policy
+	vector<HostTriLight*> sentTriLights;	// light triangles as sent to the core in the last full light update
+	vector<int> coreTriLightIdx;			// index of each sent light in coreTriLights; -1 if disabled
+	vector<CoreLightTri> coreTriLights;		// light data as sent to the core, for partial updates
+	vector<float3> coreEmission;			// emission of each material as sent to the core
+	vector<CorePointLight> corePointLights;
+	vector<CoreSpotLight> coreSpotLights;
+	vector<CoreDirectionalLight> coreDirectionalLights;
+	FrameArena frameArena;					// temporary arrays for synchronization; reset every frame
+	CoreSnapshot snapshot;					// scene updates recorded while the core renders asynchronously
+	bool renderInFlight = false;			// an asynchronous render was started and not waited for yet
 public:
 	// public data members
 	HostScene* scene = nullptr;				// scene I/O and management module
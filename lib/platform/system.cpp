@@ -36,6 +36,8 @@ extern "C"
 #include <sys/stat.h>
 #ifndef WIN32
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #endif
 #include <ft2build.h>
 #include FT_FREETYPE_H
@@ -250,6 +252,47 @@ bool FileExists( const char* f )
 	return s.good();
 }
 
+MappedFile::MappedFile( const char* fileName )
+{
+#ifdef WIN32
+	HANDLE f = CreateFileA( fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if (f == INVALID_HANDLE_VALUE) return;
+	LARGE_INTEGER fileSize;
+	HANDLE m = NULL;
+	if (GetFileSizeEx( f, &fileSize ) && fileSize.QuadPart > 0) m = CreateFileMappingA( f, NULL, PAGE_READONLY, 0, 0, NULL );
+	const void* view = m ? MapViewOfFile( m, FILE_MAP_READ, 0, 0, 0 ) : NULL;
+	if (!view)
+	{
+		if (m) CloseHandle( m );
+		CloseHandle( f );
+		return;
+	}
+	data = (const uchar*)view, size = (size_t)fileSize.QuadPart;
+	file = f, mapping = m;
+#else
+	const int f = open( fileName, O_RDONLY );
+	if (f < 0) return;
+	struct stat s;
+	void* view = MAP_FAILED;
+	if (fstat( f, &s ) == 0 && s.st_size > 0) view = mmap( 0, (size_t)s.st_size, PROT_READ, MAP_SHARED, f, 0 );
+	close( f ); // the mapping keeps a reference to the file
+	if (view == MAP_FAILED) return;
+	data = (const uchar*)view, size = (size_t)s.st_size;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	if (!data) return;
+#ifdef WIN32
+	UnmapViewOfFile( data );
+	CloseHandle( (HANDLE)mapping );
+	CloseHandle( (HANDLE)file );
+#else
+	munmap( (void*)data, size );
+#endif
+}
+
 bool RemoveFile( const char* f )
 {
 	if (!FileExists( f )) return false;
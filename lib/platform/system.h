@@ -23,6 +23,7 @@
 #include <cassert>
 #include <chrono>
 #include <fstream>
+#include <future>
 #include <half.hpp>
 #ifdef _MSC_VER
 #include <ppl.h>
@@ -31,6 +32,8 @@
 #include <thread>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <mutex>
 
 using namespace std;
 using namespace half_float;
@@ -74,6 +77,106 @@ struct Timer
 	chrono::high_resolution_clock::time_point start;
 };
 
+// pool allocator: slots of sizeof( T ) bytes in 64-byte aligned chunks, with a free list. Used
+// through class-specific operator new / delete, so objects of one type end up close together in
+// memory; larger requests (e.g. a derived class) use the global heap. The chunks are released
+// when the pool is destroyed, unless objects are still alive: these may be deleted later in
+// static destruction.
+template <class T> class PoolAllocator
+{
+public:
+	~PoolAllocator() { if (live == 0) for (void* chunk : chunks) FREE64( chunk ); }
+	void* Alloc( const size_t size )
+	{
+		if (size > SlotSize()) return ::operator new( size ); // e.g. a derived class
+		lock_guard<mutex> lock( poolMutex );
+		if (!freeList)
+		{
+			// allocate a new chunk and thread its slots onto the free list
+			const size_t slotSize = SlotSize(), slotCount = max( (size_t)16, (size_t)65536 / slotSize );
+			char* chunk = (char*)MALLOC64( (slotSize * slotCount + 63) & ~(size_t)63 );
+			chunks.push_back( chunk );
+			for (size_t i = slotCount; i > 0; i--) *(void**)(chunk + (i - 1) * slotSize) = freeList, freeList = chunk + (i - 1) * slotSize;
+		}
+		void* slot = freeList;
+		freeList = *(void**)slot;
+		live++;
+		return slot;
+	}
+	void Free( void* p, const size_t size )
+	{
+		if (!p) return;
+		if (size > SlotSize()) { ::operator delete( p ); return; }
+		lock_guard<mutex> lock( poolMutex );
+		*(void**)p = freeList;
+		freeList = p;
+		live--;
+	}
+private:
+	static constexpr size_t SlotSize() { return (sizeof( T ) + 15) & ~(size_t)15; } // T is complete when this is used
+	vector<void*> chunks;
+	void* freeList = 0;
+	size_t live = 0;
+	mutex poolMutex;
+};
+#define POOLALLOCATED( T ) public: static void* operator new( size_t size ) { return objectPool.Alloc( size ); } \
+static void operator delete( void* p, size_t size ) { objectPool.Free( p, size ); } \
+private: static inline PoolAllocator<T> objectPool;
+
+// linear allocator for short-lived data, e.g. arrays that are passed to a core once per frame.
+// Reset makes all memory available again; the first block grows to fit the peak usage.
+class FrameArena
+{
+public:
+	~FrameArena() { for (auto& block : blocks) FREE64( block.data ); }
+	template <class T> T* Alloc( const size_t count )
+	{
+		static_assert(is_trivially_destructible<T>::value, "FrameArena does not call destructors");
+		const size_t size = (count * sizeof( T ) + 63) & ~(size_t)63;
+		if (blocks.size() == 0 || blocks.back().used + size > blocks.back().size)
+		{
+			const size_t blockSize = max( size, blocks.size() == 0 ? (size_t)65536 : blocks.back().size * 2 );
+			blocks.push_back( { (char*)MALLOC64( blockSize ), blockSize, 0 } );
+		}
+		T* p = (T*)(blocks.back().data + blocks.back().used);
+		blocks.back().used += size;
+		for (size_t i = 0; i < count; i++) new (p + i) T();
+		return p;
+	}
+	void Reset()
+	{
+		if (blocks.size() > 1)
+		{
+			// replace the blocks by a single block that fits all of them
+			size_t total = 0;
+			for (auto& block : blocks) total += block.size, FREE64( block.data );
+			blocks.clear();
+			blocks.push_back( { (char*)MALLOC64( total ), total, 0 } );
+		}
+		if (blocks.size() > 0) blocks[0].used = 0;
+	}
+private:
+	struct Block { char* data; size_t size, used; };
+	vector<Block> blocks;
+};
+
+// read-only memory mapping of a file. The operating system shares the pages between all
+// processes that map the same file. IsOpen returns false if the file is absent or empty.
+class MappedFile
+{
+public:
+	MappedFile( const char* fileName );
+	~MappedFile();
+	MappedFile( const MappedFile& ) = delete;
+	MappedFile& operator=( const MappedFile& ) = delete;
+	bool IsOpen() const { return data != nullptr; }
+	const uchar* data = nullptr;
+	size_t size = 0;
+private:
+	void* file = nullptr;			// Windows: file handle
+	void* mapping = nullptr;		// Windows: file mapping handle
+};
+
 // convenience functions
 #define wrap(x,a,b) (((x)>=(a))?((x)<=(b)?(x):((x)-((b)-(a)))):((x)+((b)-(a))))
 __inline float sqr( const float x ) { return x * x; }